@@ -0,0 +1,58 @@
+# 构建时检查一个 shader 阶段, 由 validate_shaders target 以 cmake -P 调用
+#   TOOL         main_shader_tool
+#   GLSLANG      glslangValidator
+#   SPIRV_OPT    spirv-opt, 找不到时跳过优化
+#   SPIRV_CROSS  spirv-cross, 找不到时跳过优化
+#   SOURCE       shaders/ 下的文件
+#   STAGE        vert, frag 或 geom
+#   NAME         报告中的名字
+#   DEFINES      注入的 define, 以 + 分隔的 NAME[=VALUE]
+#   OUTPUT       运行时使用的 GLSL 330 (优化失败时为展开后的原文)
+# 另写出 OUTPUT.stats: "NAME,STAGE,优化前指令数,优化后指令数", 无 SPIR-V 时为 "-"
+
+string(REPLACE "+" ";" DEFINES "${DEFINES}")
+set(EXPANDED ${OUTPUT}.expanded.glsl)
+set(MODULE ${OUTPUT}.spv)
+set(OPTIMIZED ${OUTPUT}.opt.spv)
+
+# 1. 展开 #include 并注入 define, 与运行时 Shader 编译的源码相同
+execute_process(COMMAND ${TOOL} expand ${SOURCE} ${EXPANDED} ${DEFINES}
+    RESULT_VARIABLE RESULT ERROR_VARIABLE LOG)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${NAME}: ${LOG}")
+endif()
+
+# 2. 按 OpenGL GLSL 规则检查, 有错误则构建失败
+execute_process(COMMAND ${GLSLANG} -S ${STAGE} ${EXPANDED}
+    RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${NAME} (${SOURCE}):\n${LOG}")
+endif()
+
+# 3. GLSL -> SPIR-V -> spirv-opt -> GLSL 330, 任何一步失败都退回展开后的原文
+set(BEFORE -)
+set(AFTER -)
+set(OPTIMIZED_OK FALSE)
+if(SPIRV_OPT AND SPIRV_CROSS)
+    execute_process(COMMAND ${GLSLANG} -G -S ${STAGE} --auto-map-locations --auto-map-bindings -o ${MODULE} ${EXPANDED}
+        RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+    if(RESULT EQUAL 0)
+        execute_process(COMMAND ${SPIRV_OPT} -O ${MODULE} -o ${OPTIMIZED}
+            RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+    endif()
+    if(RESULT EQUAL 0)
+        execute_process(COMMAND ${SPIRV_CROSS} --version 330 --no-es --no-420pack-extension ${OPTIMIZED} --output ${OUTPUT}
+            RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+    endif()
+    if(RESULT EQUAL 0)
+        set(OPTIMIZED_OK TRUE)
+        execute_process(COMMAND ${TOOL} count ${MODULE} OUTPUT_VARIABLE BEFORE)
+        execute_process(COMMAND ${TOOL} count ${OPTIMIZED} OUTPUT_VARIABLE AFTER)
+    else()
+        message(WARNING "${NAME}: not optimized, the expanded source is used\n${LOG}")
+    endif()
+endif()
+if(NOT OPTIMIZED_OK)
+    configure_file(${EXPANDED} ${OUTPUT} COPYONLY)
+endif()
+file(WRITE ${OUTPUT}.stats "${NAME},${STAGE},${BEFORE},${AFTER}\n")
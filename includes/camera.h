@@ -66,6 +66,33 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // returns the perspective projection for Zoom, shifted by jitter pixels of a viewport of viewportSize (temporal anti-aliasing)
+    glm::mat4 GetProjectionMatrix(float aspect, float zNear, float zFar, glm::vec2 jitter = glm::vec2(0.0f), glm::vec2 viewportSize = glm::vec2(1.0f))
+    {
+        glm::mat4 projection = glm::perspective(glm::radians(Zoom), aspect, zNear, zFar);
+        // the third column is multiplied by z and divided by w = -z: a constant offset after the divide
+        projection[2][0] -= 2.0f * jitter.x / viewportSize.x;
+        projection[2][1] -= 2.0f * jitter.y / viewportSize.y;
+        return projection;
+    }
+
+    // returns the sub-pixel offset of frame index, the Halton (2, 3) sequence repeated every length frames, in [-0.5, 0.5) pixels
+    static glm::vec2 TemporalJitter(unsigned int index, unsigned int length = 8)
+    {
+        auto halton = [](unsigned int i, unsigned int base) {
+            float f = 1.0f, result = 0.0f;
+            for (; i > 0; i /= base)
+            {
+                f /= base;
+                result += f * (i % base);
+            }
+            return result;
+        };
+        // sample 0 of the sequence is (0, 0), start at 1
+        unsigned int i = index % length + 1;
+        return glm::vec2(halton(i, 2), halton(i, 3)) - 0.5f;
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
@@ -0,0 +1,250 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "frame_stats.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+// Camera keyframes over time, played back through a Catmull-Rom spline so the camera moves
+// smoothly through every keyframe. Stored as text, one keyframe per line:
+//   # time x y z yaw pitch zoom
+//   0 0 2 3 -90 0 45
+class CameraPath
+{
+public:
+    struct Keyframe
+    {
+        float time;
+        glm::vec3 position;
+        float yaw, pitch, zoom;
+    };
+    // in time order
+    std::vector<Keyframe> keyframes;
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+    float duration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+    // clamped to the first and last keyframe
+    Keyframe sample(float time) const;
+    void apply(Camera &camera, float time) const;
+private:
+    template <typename T>
+    static T catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float u);
+};
+
+bool CameraPath::load(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "ERROR::CAMERA_PATH:: Could not read " << path << std::endl;
+        return false;
+    }
+    keyframes.clear();
+    std::string line;
+    for (unsigned int number = 1; std::getline(file, line); ++number)
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+        std::stringstream fields(line);
+        Keyframe keyframe;
+        if (!(fields >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch >> keyframe.zoom) ||
+            (!keyframes.empty() && keyframe.time <= keyframes.back().time))
+        {
+            std::cerr << "ERROR::CAMERA_PATH:: " << path << ":" << number << ": expected \"time x y z yaw pitch zoom\" after the previous time" << std::endl;
+            return false;
+        }
+        keyframes.push_back(keyframe);
+    }
+    if (keyframes.empty())
+    {
+        std::cerr << "ERROR::CAMERA_PATH:: " << path << " has no keyframes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::save(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "ERROR::CAMERA_PATH:: Could not write " << path << std::endl;
+        return false;
+    }
+    file << "# time x y z yaw pitch zoom\n";
+    for (const Keyframe &keyframe : keyframes)
+        file << keyframe.time << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " "
+             << keyframe.yaw << " " << keyframe.pitch << " " << keyframe.zoom << "\n";
+    return (bool)file;
+}
+
+template <typename T>
+T CameraPath::catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float u)
+{
+    float u2 = u * u, u3 = u2 * u;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+}
+
+CameraPath::Keyframe CameraPath::sample(float time) const
+{
+    if (keyframes.size() == 1 || time <= keyframes.front().time)
+        return keyframes.front();
+    if (time >= keyframes.back().time)
+        return keyframes.back();
+    // segment k1 -> k2 containing time, the keyframes around it shape the curve
+    size_t i2 = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](float t, const Keyframe &keyframe) { return t < keyframe.time; }) - keyframes.begin();
+    size_t i1 = i2 - 1;
+    const Keyframe &k0 = keyframes[i1 > 0 ? i1 - 1 : i1], &k1 = keyframes[i1], &k2 = keyframes[i2];
+    const Keyframe &k3 = keyframes[std::min(i2 + 1, keyframes.size() - 1)];
+    float u = (time - k1.time) / (k2.time - k1.time);
+    Keyframe result;
+    result.time = time;
+    result.position = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+    result.yaw = catmullRom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, u);
+    result.pitch = glm::clamp(catmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, u), -89.0f, 89.0f);
+    result.zoom = glm::clamp(catmullRom(k0.zoom, k1.zoom, k2.zoom, k3.zoom, u), 1.0f, 89.0f);
+    return result;
+}
+
+void CameraPath::apply(Camera &camera, float time) const
+{
+    Keyframe keyframe = sample(time);
+    camera.Position = keyframe.position;
+    camera.Yaw = keyframe.yaw;
+    camera.Pitch = keyframe.pitch;
+    camera.Zoom = keyframe.zoom;
+    camera.updateCameraVectors();
+}
+
+// What a main does with camera paths, from its command line:
+//   --camera-path NAME         plays NAME at a fixed timestep instead of moving the camera from
+//                              input (ESC and the UI still work), prints the frame time
+//                              statistics when it ends and closes the window
+//   --record-camera-path NAME  samples the camera every recordInterval seconds while it is
+//                              driven by input, written when the program exits
+// NAME is camera_paths/NAME.path, or a file when it has a '/' or ends in .path.
+//
+//   float currentTime = cameraPath.time(glfwGetTime());
+//   ...
+//   processInput(window, !cameraPath.apply(camera, currentTime));  // moves the camera only if true
+//   cameraPath.record(camera, currentTime);
+//   if (cameraPath.finished())
+//       glfwSetWindowShouldClose(window, true);
+class CameraPathRunner
+{
+public:
+    float timestep, recordInterval;
+    // time the frames of a playback, off where a main measures frames itself
+    bool measureFrames;
+    FrameStats stats;
+    CameraPathRunner(int argc, char **argv, const std::string &directory, float timestep = 1.0f / 60.0f);
+    ~CameraPathRunner();
+    bool play(const std::string &name);
+    bool playing() const { return isPlaying; }
+    bool recording() const { return !recordPath.empty(); }
+    // the playback has shown its last keyframe
+    bool finished() const { return isPlaying && frame > 0 && (frame - 1) * timestep >= path.duration(); }
+    // the time of this frame: frame * timestep while playing, wallTime otherwise. Once per frame
+    float time(float wallTime);
+    // false if no path is playing and the camera is left to input, other input is read either way
+    bool apply(Camera &camera, float time) const;
+    void record(const Camera &camera, float time);
+private:
+    std::string directory, name, recordPath;
+    CameraPath path, recorded;
+    bool isPlaying;
+    unsigned int frame;
+    float recordStart, nextSample;
+    // where the recording ends, between two samples
+    CameraPath::Keyframe recordEnd;
+    std::chrono::high_resolution_clock::time_point lastFrame;
+    std::string resolve(const std::string &name) const;
+};
+
+CameraPathRunner::CameraPathRunner(int argc, char **argv, const std::string &directory, float timestep)
+    : timestep(timestep), recordInterval(0.1f), measureFrames(true), stats(10), directory(directory), isPlaying(false), frame(0),
+      recordStart(-1.0f), nextSample(0.0f)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--camera-path")
+            play(argv[i + 1]);
+        else if (arg == "--record-camera-path")
+            recordPath = resolve(argv[i + 1]);
+    }
+}
+
+CameraPathRunner::~CameraPathRunner()
+{
+    if (isPlaying && measureFrames && stats.frames() > 0)
+    {
+        std::cout << "CAMERA_PATH:: " << name << ", " << path.duration() << " s at " << timestep * 1000.0f << " ms per frame" << std::endl;
+        stats.printSummary(std::cout);
+    }
+    if (recording() && !recorded.keyframes.empty() && recordEnd.time > recorded.duration())
+        recorded.keyframes.push_back(recordEnd);
+    if (recording() && recorded.save(recordPath))
+        std::cout << "CAMERA_PATH:: " << recorded.keyframes.size() << " keyframes, " << recorded.duration() << " s written to " << recordPath << std::endl;
+}
+
+std::string CameraPathRunner::resolve(const std::string &name) const
+{
+    bool isFile = name.find('/') != std::string::npos || (name.size() > 5 && name.compare(name.size() - 5, 5, ".path") == 0);
+    return isFile ? name : directory + "/" + name + ".path";
+}
+
+bool CameraPathRunner::play(const std::string &name)
+{
+    this->name = name;
+    isPlaying = path.load(resolve(name));
+    frame = 0;
+    return isPlaying;
+}
+
+float CameraPathRunner::time(float wallTime)
+{
+    if (!isPlaying)
+        return wallTime;
+    auto now = std::chrono::high_resolution_clock::now();
+    if (measureFrames && frame > 0)
+        stats.add(std::chrono::duration<float, std::milli>(now - lastFrame).count());
+    lastFrame = now;
+    return frame++ * timestep;
+}
+
+bool CameraPathRunner::apply(Camera &camera, float time) const
+{
+    if (!isPlaying)
+        return false;
+    path.apply(camera, time);
+    return true;
+}
+
+void CameraPathRunner::record(const Camera &camera, float time)
+{
+    if (!recording() || isPlaying)
+        return;
+    // the recording starts at 0 whenever the program started it
+    if (recordStart < 0.0f)
+        recordStart = time;
+    recordEnd = { time - recordStart, camera.Position, camera.Yaw, camera.Pitch, camera.Zoom };
+    if (recordEnd.time < nextSample)
+        return;
+    recorded.keyframes.push_back(recordEnd);
+    // on the interval grid, frames slower than the interval take a sample each
+    nextSample += recordInterval;
+    if (nextSample <= recordEnd.time)
+        nextSample = recordEnd.time + recordInterval;
+}
+#endif
@@ -0,0 +1,384 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+
+// the time stamp counter is read in a few cycles, steady_clock may take a call into the OS
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_RDTSC
+#endif
+
+// CPU time of named scopes on every thread. A scope costs two clock reads and one store into a
+// buffer owned by its thread, no lock and no allocation; readers (the flame view, the trace export)
+// copy the buffers without stopping the writers. Each thread buffer is a ring, the oldest events
+// are overwritten. Scope names have to outlive the profiler (string literals).
+//
+// On x86 scopes are timed with rdtsc, converted to nanoseconds against steady_clock when they are
+// read; this assumes an invariant TSC, which every x86 CPU of the last decade has.
+//
+// The macros compile to nothing unless CPU_PROFILER is defined (a CMake option), so instrumented
+// code costs nothing when profiling is compiled out. CpuProfiler::instance().enabled turns
+// recording off at run time.
+//
+//   void Model::loadModel(std::string path)
+//   {
+//       CPU_PROFILE_SCOPE("Model::loadModel");
+//       ...
+//   }
+//   CpuProfiler::instance().writeChromeTrace("trace.json");   // chrome://tracing, ui.perfetto.dev
+#ifdef CPU_PROFILER
+#define CPU_PROFILE_CONCAT_(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_(a, b)
+#define CPU_PROFILE_SCOPE(name) CpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_PUSH(name) CpuProfiler::instance().push(name)
+#define CPU_PROFILE_POP() CpuProfiler::instance().pop()
+#define CPU_PROFILE_FRAME() CpuProfiler::instance().frameMark()
+#define CPU_PROFILE_THREAD(name) CpuProfiler::instance().setThreadName(name)
+#else
+#define CPU_PROFILE_SCOPE(name)
+#define CPU_PROFILE_PUSH(name)
+#define CPU_PROFILE_POP()
+#define CPU_PROFILE_FRAME()
+#define CPU_PROFILE_THREAD(name)
+#endif
+
+struct CpuProfileEvent
+{
+    const char *name;
+    // nanoseconds since the profiler was created
+    uint64_t start, end;
+    // nesting depth on its thread, 0 for the outermost scopes
+    uint32_t depth;
+    // buffer (trace thread id) the event was recorded in
+    uint32_t thread;
+};
+
+class CpuProfiler
+{
+private:
+    struct ThreadBuffer;
+public:
+    // events kept per thread
+    static const size_t BUFFER_SIZE = 1 << 14;
+    std::atomic<bool> enabled;
+    // brackets a scope from construction to destruction
+    class Scope
+    {
+    public:
+        Scope(const char *name);
+        ~Scope();
+    private:
+        const char *name;
+        uint64_t start;
+        // nullptr while recording is off
+        ThreadBuffer *buffer;
+    };
+    static CpuProfiler &instance();
+    // nanoseconds since the profiler was created
+    uint64_t now() const;
+    // what Scope does, for scopes that do not end in the block they start in
+    void push(const char *name);
+    void pop();
+    // name of the calling thread in the trace
+    void setThreadName(const std::string &name);
+    // marks the start of a frame, called on the thread that renders
+    void frameMark();
+    // the last complete frame, between two frameMark() calls
+    uint64_t frameStart() const;
+    uint64_t frameEnd() const;
+    // events of every thread that ended in [from, to), each thread's in the order they ended
+    std::vector<CpuProfileEvent> events(uint64_t from = 0, uint64_t to = UINT64_MAX) const;
+    std::vector<std::string> threadNames() const;
+    // every buffered event as Chrome trace event JSON
+    bool writeChromeTrace(const std::string &path) const;
+private:
+    // written by its thread only, times in ticks. Event i of the thread is at i % BUFFER_SIZE and
+    // is complete once written > i; a reader drops events the writer may have overwritten while it
+    // was copying
+    struct ThreadBuffer
+    {
+        std::vector<CpuProfileEvent> events;
+        std::atomic<uint64_t> written;
+        uint32_t depth;
+        // push()ed scopes, innermost last
+        std::vector<std::pair<const char *, uint64_t>> open;
+        uint32_t id;
+        std::string name;
+    };
+    // gives the buffer back when its thread exits, threads started every frame reuse buffers
+    struct ThreadHandle
+    {
+        ThreadBuffer *buffer = nullptr;
+        ~ThreadHandle();
+    };
+    // the clock at creation, in ticks and as steady_clock to convert ticks with
+    uint64_t epochTicks;
+    std::chrono::steady_clock::time_point epoch;
+    uint64_t currentFrameStart, lastFrameStart, lastFrameEnd;
+    // guards the buffer lists, taken when a thread starts or ends and by readers, never by scopes
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer *> freeBuffers;
+    CpuProfiler();
+    static uint64_t ticks();
+    // measured over the time since creation, so it gets more precise the longer the program runs
+    double nsPerTick() const;
+    uint64_t toNs(uint64_t time, double scale) const { return time > epochTicks ? (uint64_t)((time - epochTicks) * scale) : 0; }
+    ThreadBuffer &threadBuffer();
+    static ThreadHandle &threadHandle();
+    // stores a scope that ended, one level up from depth
+    void record(ThreadBuffer &buffer, const char *name, uint64_t start, uint64_t end);
+    // a JSON string body: quotes, backslashes and control characters escaped
+    static std::string jsonEscape(const std::string &text);
+};
+
+CpuProfiler::CpuProfiler()
+    : enabled(true), epochTicks(ticks()), epoch(std::chrono::steady_clock::now()), currentFrameStart(0), lastFrameStart(0), lastFrameEnd(0)
+{
+}
+
+CpuProfiler &CpuProfiler::instance()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+uint64_t CpuProfiler::ticks()
+{
+#ifdef CPU_PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double CpuProfiler::nsPerTick() const
+{
+#ifdef CPU_PROFILER_RDTSC
+    uint64_t elapsedTicks = ticks() - epochTicks;
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - epoch).count();
+    return elapsedTicks > 0 ? elapsedNs / elapsedTicks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+uint64_t CpuProfiler::now() const
+{
+    return toNs(ticks(), nsPerTick());
+}
+
+CpuProfiler::ThreadHandle &CpuProfiler::threadHandle()
+{
+    thread_local ThreadHandle handle;
+    return handle;
+}
+
+CpuProfiler::ThreadHandle::~ThreadHandle()
+{
+    if (buffer == nullptr)
+        return;
+    CpuProfiler &profiler = CpuProfiler::instance();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    profiler.freeBuffers.push_back(buffer);
+}
+
+CpuProfiler::ThreadBuffer &CpuProfiler::threadBuffer()
+{
+    ThreadHandle &handle = threadHandle();
+    if (handle.buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeBuffers.empty())
+        {
+            handle.buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+            handle.buffer->depth = 0;
+            handle.buffer->open.clear();
+        }
+        else
+        {
+            std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+            buffer->events.resize(BUFFER_SIZE);
+            buffer->written = 0;
+            buffer->depth = 0;
+            buffer->open.reserve(16);
+            buffer->id = (uint32_t)buffers.size();
+            buffer->name = "thread " + std::to_string(buffer->id);
+            handle.buffer = buffer.get();
+            buffers.push_back(std::move(buffer));
+        }
+    }
+    return *handle.buffer;
+}
+
+CpuProfiler::Scope::Scope(const char *name) : name(name), start(0), buffer(nullptr)
+{
+    CpuProfiler &profiler = CpuProfiler::instance();
+    if (!profiler.enabled.load(std::memory_order_relaxed))
+        return;
+    buffer = &profiler.threadBuffer();
+    buffer->depth++;
+    start = ticks();
+}
+
+CpuProfiler::Scope::~Scope()
+{
+    if (buffer != nullptr)
+        CpuProfiler::instance().record(*buffer, name, start, ticks());
+}
+
+void CpuProfiler::record(ThreadBuffer &buffer, const char *name, uint64_t start, uint64_t end)
+{
+    buffer.depth--;
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % BUFFER_SIZE] = { name, start, end, buffer.depth, buffer.id };
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::push(const char *name)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+        return;
+    ThreadBuffer &buffer = threadBuffer();
+    buffer.depth++;
+    buffer.open.push_back({ name, ticks() });
+}
+
+void CpuProfiler::pop()
+{
+    uint64_t end = ticks();
+    ThreadBuffer &buffer = threadBuffer();
+    // nothing open if recording was off at the push()
+    if (buffer.open.empty())
+        return;
+    record(buffer, buffer.open.back().first, buffer.open.back().second, end);
+    buffer.open.pop_back();
+}
+
+void CpuProfiler::setThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer.name = name;
+}
+
+void CpuProfiler::frameMark()
+{
+    // while recording is off the last recorded frame stays the one shown
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        currentFrameStart = 0;
+        return;
+    }
+    uint64_t time = ticks();
+    if (currentFrameStart != 0)
+    {
+        lastFrameStart = currentFrameStart;
+        lastFrameEnd = time;
+    }
+    currentFrameStart = time;
+}
+
+uint64_t CpuProfiler::frameStart() const
+{
+    return toNs(lastFrameStart, nsPerTick());
+}
+
+uint64_t CpuProfiler::frameEnd() const
+{
+    return toNs(lastFrameEnd, nsPerTick());
+}
+
+std::vector<CpuProfileEvent> CpuProfiler::events(uint64_t from, uint64_t to) const
+{
+    std::vector<CpuProfileEvent> result, copy;
+    double scale = nsPerTick();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &buffer : buffers)
+    {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = written > BUFFER_SIZE ? written - BUFFER_SIZE : 0;
+        copy.resize(written - first);
+        for (uint64_t i = first; i < written; ++i)
+            copy[i - first] = buffer->events[i % BUFFER_SIZE];
+        // the slots the writer got round to again while they were copied may be torn, drop them.
+        // That includes the slot of event now, which may be half written before written = now + 1
+        uint64_t now = buffer->written.load(std::memory_order_acquire);
+        uint64_t valid = now + 1 > first + BUFFER_SIZE ? now + 1 - BUFFER_SIZE : first;
+        for (uint64_t i = valid; i < written; ++i)
+        {
+            CpuProfileEvent event = copy[i - first];
+            event.start = toNs(event.start, scale);
+            event.end = toNs(event.end, scale);
+            if (event.end >= from && event.end < to)
+                result.push_back(event);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> CpuProfiler::threadNames() const
+{
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &buffer : buffers)
+        names.push_back(buffer->name);
+    return names;
+}
+
+std::string CpuProfiler::jsonEscape(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char)c < 0x20)
+        {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        }
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    // complete events ("X"), times in microseconds
+    file << "{\"traceEvents\":[\n";
+    std::vector<std::string> names = threadNames();
+    for (size_t i = 0; i < names.size(); ++i)
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":\"" << jsonEscape(names[i]) << "\"}},\n";
+    char line[256];
+    for (const CpuProfileEvent &event : events())
+    {
+        std::snprintf(line, sizeof(line), "\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u},\n",
+                      event.start / 1e3, (event.end - event.start) / 1e3, event.thread);
+        file << "{\"name\":\"" << jsonEscape(event.name) << line;
+    }
+    // Chrome accepts a trailing comma in the array, but not every other viewer does
+    std::snprintf(line, sizeof(line), "{\"name\":\"end\",\"ph\":\"i\",\"ts\":%.3f,\"pid\":0,\"tid\":0,\"s\":\"g\"}\n]}\n", now() / 1e3);
+    file << line;
+    return (bool)file;
+}
+#endif
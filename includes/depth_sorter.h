@@ -0,0 +1,175 @@
+#ifndef DEPTH_SORTER_H
+#define DEPTH_SORTER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+// Back-to-front order for blended draws. Each item is reduced to a 32 bit key from its view space
+// depth (the float bits flipped so unsigned order is float order) and the (key, index) pairs are
+// sorted with an LSD radix sort: 3 passes of 11 bits, O(n) and branch free, with a pass skipped
+// when every key shares its digit.
+//
+// Between two frames with a similar camera the order barely changes, so sort() first re-keys the
+// previous order and repairs it in place with an insertion sort. Counting out of order neighbours
+// does not tell how much repair is needed (under any motion about half of them swap, whether each
+// item moves one place or a thousand), so the repair watches its own rate instead: once it has
+// moved more than maxShiftsPerItem elements per item seen so far, plus a little slack for a
+// locally bad start, it gives up and the radix sort runs. A camera cut gives up within the first
+// few hundred items, and a static camera costs only the re-keying.
+//
+//   sorter.sort(centers.data(), centers.size(), view);
+//   for (unsigned int i : sorter.order) ...   // farthest first
+class DepthSorter
+{
+public:
+    enum Method { RADIX, COHERENT };
+    // item indices, farthest from the camera first
+    std::vector<unsigned int> order;
+    // how the last sort() got its result
+    Method lastMethod;
+    // insertion sort work allowed per item before falling back to the radix sort, 0 disables reuse.
+    // Each shift costs about as much as the radix sort spends per item, so past 1 or 2 the repair
+    // is slower than sorting again
+    unsigned int maxShiftsPerItem;
+    DepthSorter(unsigned int maxShiftsPerItem = 1);
+    void sort(const glm::vec3 *centers, size_t count, const glm::mat4 &view);
+    // forgets the previous order, the next sort() is a full radix sort
+    void reset() { order.clear(); }
+    // monotonic float -> uint mapping: a < b <=> floatKey(a) < floatKey(b)
+    static uint32_t floatKey(float f);
+private:
+    std::vector<uint32_t> keys, keysTemp;
+    std::vector<unsigned int> orderTemp;
+    void buildKeys(const glm::vec3 *centers, const glm::mat4 &view);
+    void radixSort();
+    bool insertionFixup();
+};
+
+DepthSorter::DepthSorter(unsigned int maxShiftsPerItem) : lastMethod(RADIX), maxShiftsPerItem(maxShiftsPerItem)
+{
+}
+
+uint32_t DepthSorter::floatKey(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    // negative floats: flip everything so larger magnitudes sort first, positive: flip the sign bit
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+void DepthSorter::sort(const glm::vec3 *centers, size_t count, const glm::mat4 &view)
+{
+    keys.resize(count);
+    bool reuse = maxShiftsPerItem > 0 && order.size() == count;
+    if (!reuse)
+    {
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0u);
+    }
+    buildKeys(centers, view);
+    if (reuse)
+    {
+        if (insertionFixup())
+        {
+            lastMethod = COHERENT;
+            return;
+        }
+    }
+    radixSort();
+    lastMethod = RADIX;
+}
+
+void DepthSorter::buildKeys(const glm::vec3 *centers, const glm::mat4 &view)
+{
+    // only the z row of the view matrix is needed; in front of the camera z is negative, so
+    // ascending z is back to front
+    glm::vec4 row(view[0][2], view[1][2], view[2][2], view[3][2]);
+    size_t count = order.size();
+    // the centers are read in item order and only the 4 byte keys are gathered in the previous
+    // order: gathering the 12 byte centers instead misses the cache twice as often for large counts
+    keysTemp.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 &c = centers[i];
+        keysTemp[i] = floatKey(row.x * c.x + row.y * c.y + row.z * c.z + row.w);
+    }
+    for (size_t i = 0; i < count; ++i)
+        keys[i] = keysTemp[order[i]];
+}
+
+void DepthSorter::radixSort()
+{
+    const unsigned int BITS = 11, BUCKETS = 1u << BITS, MASK = BUCKETS - 1;
+    size_t count = keys.size();
+    if (count == 0)
+        return;
+    keysTemp.resize(count);
+    orderTemp.resize(count);
+    // all three histograms in one read of the keys
+    std::vector<uint32_t> histograms(3 * BUCKETS, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key = keys[i];
+        histograms[key & MASK]++;
+        histograms[BUCKETS + ((key >> BITS) & MASK)]++;
+        histograms[2 * BUCKETS + (key >> (2 * BITS))]++;
+    }
+    for (unsigned int pass = 0; pass < 3; ++pass)
+    {
+        uint32_t *histogram = &histograms[pass * BUCKETS];
+        unsigned int shift = pass * BITS;
+        // every key has the same digit, the pass would not move anything
+        if (histogram[(keys[0] >> shift) & MASK] == count)
+            continue;
+        uint32_t sum = 0;
+        for (unsigned int b = 0; b < BUCKETS; ++b)
+        {
+            uint32_t n = histogram[b];
+            histogram[b] = sum;
+            sum += n;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t destination = histogram[(keys[i] >> shift) & MASK]++;
+            keysTemp[destination] = keys[i];
+            orderTemp[destination] = order[i];
+        }
+        keys.swap(keysTemp);
+        order.swap(orderTemp);
+    }
+}
+
+bool DepthSorter::insertionFixup()
+{
+    const size_t SLACK_ITEMS = 256;
+    size_t shifts = 0;
+    for (size_t i = 1; i < keys.size(); ++i)
+    {
+        size_t budget = (i + SLACK_ITEMS) * maxShiftsPerItem;
+        uint32_t key = keys[i];
+        unsigned int index = order[i];
+        size_t j = i;
+        while (j > 0 && keys[j - 1] > key)
+        {
+            keys[j] = keys[j - 1];
+            order[j] = order[j - 1];
+            --j;
+            if (++shifts > budget)
+            {
+                // leave a permutation behind for the radix sort
+                keys[j] = key;
+                order[j] = index;
+                return false;
+            }
+        }
+        keys[j] = key;
+        order[j] = index;
+    }
+    return true;
+}
+
+#endif
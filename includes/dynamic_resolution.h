@@ -0,0 +1,152 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// Picks the internal render scale from the measured GPU frame time. The scale moves through fixed
+// steps (minScale .. maxScale) so the render targets only take a handful of sizes, which the
+// render target pool keeps around. Hysteresis against oscillation:
+//   - down after downFrames consecutive frames above the budget, up only after upFrames frames
+//     below upThreshold * budget, and only if the next step, whose cost is predicted from its
+//     pixel count, would still fit the budget;
+//   - no decision for cooldownFrames after a change, the timer queries lag a few frames and the
+//     smoothed time needs a while to reflect the new size.
+// Every change is printed; openLog() additionally writes one CSV line per frame
+// (frame,gpuMs,scale) and printSummary() totals the run, so a headless run can be checked for
+// stability without looking at it.
+//
+//   if (resolution.update(frameTimer.elapsedMs))
+//       resize the scene targets to resolution.scale * screen size
+class DynamicResolution
+{
+public:
+    float targetMs;
+    // fractions of the budget: above 1.0 counts as over, below upThreshold as under
+    float upThreshold;
+    unsigned int downFrames, upFrames, cooldownFrames;
+    float scale;
+    unsigned int level;
+    std::vector<float> levels;
+    // statistics since construction
+    unsigned int frames, overBudgetFrames, changes;
+    DynamicResolution(float targetMs = 16.6f, float minScale = 0.5f, float maxScale = 1.0f, unsigned int steps = 6);
+    ~DynamicResolution();
+    // gpuMs: smoothed GPU frame time, returns true when scale changed
+    bool update(float gpuMs);
+    // back to the full scale, e.g. when the controller is switched off
+    void reset();
+    bool openLog(const std::string &path);
+    void printSummary(std::ostream &out) const;
+    unsigned int scaled(unsigned int size) const { return std::max(1u, (unsigned int)std::lround(size * scale)); }
+private:
+    unsigned int overCount, underCount, cooldown;
+    double scaleSum;
+    std::ofstream log;
+    void setLevel(unsigned int newLevel, float gpuMs);
+};
+
+DynamicResolution::DynamicResolution(float targetMs, float minScale, float maxScale, unsigned int steps)
+    : targetMs(targetMs), upThreshold(0.8f), downFrames(4), upFrames(60), cooldownFrames(20),
+      frames(0), overBudgetFrames(0), changes(0), overCount(0), underCount(0), cooldown(0), scaleSum(0.0)
+{
+    steps = std::max(2u, steps);
+    for (unsigned int i = 0; i < steps; ++i)
+        levels.push_back(minScale + (maxScale - minScale) * i / (steps - 1));
+    level = steps - 1;
+    scale = levels[level];
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    if (log.is_open())
+        log.close();
+}
+
+bool DynamicResolution::update(float gpuMs)
+{
+    frames++;
+    scaleSum += scale;
+    if (gpuMs > targetMs)
+        overBudgetFrames++;
+    if (log.is_open())
+        log << frames << "," << gpuMs << "," << scale << "\n";
+
+    if (cooldown > 0)
+    {
+        cooldown--;
+        return false;
+    }
+    if (gpuMs > targetMs)
+    {
+        overCount++;
+        underCount = 0;
+    }
+    else if (gpuMs < targetMs * upThreshold)
+    {
+        underCount++;
+        overCount = 0;
+    }
+    else
+        overCount = underCount = 0;
+
+    if (overCount >= downFrames && level > 0)
+    {
+        setLevel(level - 1, gpuMs);
+        return true;
+    }
+    if (underCount >= upFrames && level + 1 < levels.size())
+    {
+        float pixels = levels[level + 1] / levels[level];
+        if (gpuMs * pixels * pixels <= targetMs)
+        {
+            setLevel(level + 1, gpuMs);
+            return true;
+        }
+        underCount = 0;
+    }
+    return false;
+}
+
+void DynamicResolution::setLevel(unsigned int newLevel, float gpuMs)
+{
+    std::cout << "DYNAMIC_RESOLUTION:: frame " << frames << ", " << gpuMs << " ms (budget " << targetMs << " ms): scale "
+              << levels[level] << " -> " << levels[newLevel] << std::endl;
+    level = newLevel;
+    scale = levels[level];
+    changes++;
+    overCount = underCount = 0;
+    cooldown = cooldownFrames;
+}
+
+void DynamicResolution::reset()
+{
+    level = (unsigned int)levels.size() - 1;
+    scale = levels[level];
+    overCount = underCount = cooldown = 0;
+}
+
+bool DynamicResolution::openLog(const std::string &path)
+{
+    log.open(path);
+    if (!log.is_open())
+    {
+        std::cerr << "ERROR::DYNAMIC_RESOLUTION:: cannot write " << path << std::endl;
+        return false;
+    }
+    log << "frame,gpuMs,scale\n";
+    return true;
+}
+
+void DynamicResolution::printSummary(std::ostream &out) const
+{
+    out << "DYNAMIC_RESOLUTION:: " << frames << " frames, " << changes << " scale changes, "
+        << (frames ? 100.0f * overBudgetFrames / frames : 0.0f) << "% over the " << targetMs << " ms budget, mean scale "
+        << (frames ? scaleSum / frames : scale) << std::endl;
+}
+
+#endif
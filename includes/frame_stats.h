@@ -0,0 +1,88 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+// Frame times of a benchmark run and their distribution. The mean hides stutter, the high
+// percentiles show it: p99 is the time 1 frame in 100 takes longer than.
+//
+//   stats.add(frameMs);
+//   stats.printSummary(std::cout);   // FRAME_STATS:: 300 frames, mean ..., p50 ..., p95 ..., p99 ...
+class FrameStats
+{
+public:
+    // the first frames compile shaders and fill caches, they are counted but not in the statistics
+    unsigned int warmupFrames;
+    FrameStats(unsigned int warmupFrames = 10) : warmupFrames(warmupFrames) {}
+    void add(float ms) { times.push_back(ms); }
+    size_t frames() const { return times.size(); }
+    float mean() const;
+    // p in [0, 100], nearest rank
+    float percentile(float p) const;
+    float max() const;
+    void printSummary(std::ostream &out) const;
+    // "frame,ms" per frame, warmup included
+    bool writeCsv(const std::string &path) const;
+private:
+    std::vector<float> times;
+    std::vector<float> measured() const;
+};
+
+std::vector<float> FrameStats::measured() const
+{
+    if (times.size() <= warmupFrames)
+        return times;
+    return std::vector<float>(times.begin() + warmupFrames, times.end());
+}
+
+float FrameStats::mean() const
+{
+    std::vector<float> values = measured();
+    return values.empty() ? 0.0f : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+float FrameStats::percentile(float p) const
+{
+    std::vector<float> values = measured();
+    if (values.empty())
+        return 0.0f;
+    size_t rank = (size_t)std::ceil(p / 100.0f * values.size());
+    rank = std::min(std::max<size_t>(rank, 1), values.size()) - 1;
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+float FrameStats::max() const
+{
+    std::vector<float> values = measured();
+    return values.empty() ? 0.0f : *std::max_element(values.begin(), values.end());
+}
+
+void FrameStats::printSummary(std::ostream &out) const
+{
+    float meanMs = mean();
+    out << "FRAME_STATS:: " << frames() << " frames (" << std::min<size_t>(warmupFrames, frames()) << " warmup), mean "
+        << meanMs << " ms (" << (meanMs > 0.0f ? 1000.0f / meanMs : 0.0f) << " FPS), p50 " << percentile(50.0f) << " ms, p95 "
+        << percentile(95.0f) << " ms, p99 " << percentile(99.0f) << " ms, max " << max() << " ms" << std::endl;
+}
+
+bool FrameStats::writeCsv(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "ERROR::FRAME_STATS:: Could not write " << path << std::endl;
+        return false;
+    }
+    file << "frame,ms\n";
+    for (size_t i = 0; i < times.size(); ++i)
+        file << i << "," << times[i] << "\n";
+    return (bool)file;
+}
+#endif
@@ -0,0 +1,221 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+#include "render_target_pool.h"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Render targets for deferred shading. The layout is kept at 2 x 32 bits + depth/stencil:
+//   gNormalShininess  rgb10a2  octahedral normal (rg), shininess / 256 (b)
+//   gAlbedoSpec       rgba8    albedo (rgb), specular intensity (a)
+//   gDepth            d24s8    world position is reconstructed from it with the inverse view-projection
+// The lighting passes accumulate linear radiance into lightAccumulation (rgba16f). lightFBO has its
+// own depth/stencil (lightDepth), a copy of gDepth made by bindLighting(): the light volumes are
+// depth- and stencil-tested against the scene while the shaders sample gDepth, and attaching the
+// sampled texture would be a feedback loop.
+// The textures come from a RenderTargetPool; resize() swaps them for ones of the new size.
+class GBuffer
+{
+public:
+    unsigned int FBO, lightFBO;
+    unsigned int gNormalShininess, gAlbedoSpec, gDepth;
+    unsigned int lightAccumulation, lightDepth;
+    unsigned int width, height;
+    // targets must outlive the g-buffer
+    GBuffer(RenderTargetPool &targets, unsigned int width, unsigned int height);
+    ~GBuffer();
+    void resize(unsigned int width, unsigned int height);
+    // binds the geometry framebuffer, the caller clears it and draws the scene with shaders/deferred/gbuffer_*.glsl
+    void bindGeometry();
+    // binds the accumulation framebuffer and copies the g-buffer depth/stencil into it
+    void bindLighting();
+    // binds the three g-buffer textures to consecutive units starting at firstUnit
+    void bindTextures(unsigned int firstUnit);
+private:
+    RenderTargetPool &targets;
+    int normalTarget, albedoTarget, depthTarget, lightTarget, lightDepthTarget;
+    void acquireTargets();
+    void releaseTargets();
+};
+
+// Unit sphere used as the bounding volume of a point light, scaled to the light radius when drawn.
+class LightVolume
+{
+public:
+    unsigned int VAO;
+    unsigned int indexCount;
+    LightVolume(unsigned int segments = 16, unsigned int rings = 12);
+    ~LightVolume();
+    void Draw();
+private:
+    unsigned int VBO, EBO;
+};
+
+// distance at which the attenuated light drops below 5/256 of its brightest channel
+float pointLightRadius(float constant, float linear, float quadratic, float maxChannel);
+
+GBuffer::GBuffer(RenderTargetPool &targets, unsigned int width, unsigned int height)
+    : width(width), height(height), targets(targets)
+{
+    glGenFramebuffers(1, &FBO);
+    glGenFramebuffers(1, &lightFBO);
+    acquireTargets();
+}
+
+GBuffer::~GBuffer()
+{
+    releaseTargets();
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteFramebuffers(1, &lightFBO);
+}
+
+void GBuffer::resize(unsigned int width, unsigned int height)
+{
+    releaseTargets();
+    this->width = width;
+    this->height = height;
+    acquireTargets();
+}
+
+void GBuffer::acquireTargets()
+{
+    normalTarget = targets.acquire(RenderTargetDesc(GL_RGB10_A2, width, height), GL_NEAREST);
+    albedoTarget = targets.acquire(RenderTargetDesc(GL_RGBA8, width, height), GL_NEAREST);
+    depthTarget = targets.acquire(RenderTargetDesc(GL_DEPTH24_STENCIL8, width, height), GL_NEAREST);
+    lightTarget = targets.acquire(RenderTargetDesc(GL_RGBA16F, width, height), GL_LINEAR);
+    lightDepthTarget = targets.acquire(RenderTargetDesc(GL_DEPTH24_STENCIL8, width, height), GL_NEAREST);
+    gNormalShininess = targets.texture(normalTarget);
+    gAlbedoSpec = targets.texture(albedoTarget);
+    gDepth = targets.texture(depthTarget);
+    lightAccumulation = targets.texture(lightTarget);
+    lightDepth = targets.texture(lightDepthTarget);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormalShininess, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedoSpec, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lightAccumulation, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, lightDepth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: Light accumulation framebuffer is not complete!" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::releaseTargets()
+{
+    targets.release(normalTarget);
+    targets.release(albedoTarget);
+    targets.release(depthTarget);
+    targets.release(lightTarget);
+    targets.release(lightDepthTarget);
+}
+
+void GBuffer::bindGeometry()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+void GBuffer::bindLighting()
+{
+    // same size and format, so a plain copy
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+    glViewport(0, 0, width, height);
+}
+
+void GBuffer::bindTextures(unsigned int firstUnit)
+{
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_2D, gNormalShininess);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+}
+
+LightVolume::LightVolume(unsigned int segments, unsigned int rings)
+{
+    const float PI = 3.14159265359f;
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    // the polygon is inscribed in the sphere, push the vertices out so the faces still cover the unit radius
+    float inflate = 1.0f / std::cos(PI / std::min(segments, rings));
+    for (unsigned int y = 0; y <= rings; ++y)
+    {
+        float theta = PI * y / rings;
+        for (unsigned int x = 0; x <= segments; ++x)
+        {
+            float phi = 2.0f * PI * x / segments;
+            vertices.push_back(inflate * std::sin(theta) * std::cos(phi));
+            vertices.push_back(inflate * std::cos(theta));
+            vertices.push_back(inflate * std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (unsigned int y = 0; y < rings; ++y)
+    {
+        for (unsigned int x = 0; x < segments; ++x)
+        {
+            unsigned int i0 = y * (segments + 1) + x;
+            unsigned int i1 = i0 + segments + 1;
+            indices.push_back(i0);
+            indices.push_back(i0 + 1);
+            indices.push_back(i1);
+            indices.push_back(i0 + 1);
+            indices.push_back(i1 + 1);
+            indices.push_back(i1);
+        }
+    }
+    indexCount = static_cast<unsigned int>(indices.size());
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+}
+
+LightVolume::~LightVolume()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+}
+
+void LightVolume::Draw()
+{
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+float pointLightRadius(float constant, float linear, float quadratic, float maxChannel)
+{
+    float threshold = maxChannel * 256.0f / 5.0f;
+    if (quadratic <= 0.0f)
+        return linear > 0.0f ? std::max(threshold - constant, 0.0f) / linear : 1e4f;
+    float discriminant = std::max(linear * linear - 4.0f * quadratic * (constant - threshold), 0.0f);
+    return std::max((-linear + std::sqrt(discriminant)) / (2.0f * quadratic), 0.0f);
+}
+
+#endif
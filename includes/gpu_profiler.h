@@ -0,0 +1,282 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+
+// GPU time of every pass of a frame. A scope brackets a pass with two GL_TIMESTAMP queries, which
+// unlike GL_TIME_ELAPSED may nest, and with a KHR_debug group of the same name so frame captures
+// (RenderDoc, Nsight) show the same passes. A frame's queries are kept in a ring of latency frames
+// and read once the driver has them: reading never stalls, a frame whose slot comes round again
+// before its results arrived is dropped.
+//
+//   profiler.beginFrame();
+//   {
+//       GpuProfiler::Scope scope(profiler, "shadows");
+//       ...
+//   }
+//   profiler.endFrame();
+//   for (const GpuProfiler::Pass &pass : profiler.passes()) ... pass.averageMs, pass.history
+class GpuProfiler
+{
+public:
+    struct Pass
+    {
+        // path is "parent/name", so equal names under different parents are different passes
+        std::string name, path;
+        // nesting depth, 0 for scopes directly in the frame
+        unsigned int depth;
+        // the newest finished frame, the average and maximum over history
+        float lastMs, averageMs, maxMs;
+        // times of the last finished frames in milliseconds, 0 for frames the pass did not run in.
+        // A ring, historyOffset is the oldest entry (as ImGui::PlotHistogram takes it)
+        std::vector<float> history;
+        unsigned int historyOffset;
+        // ran in the newest finished frame
+        bool active;
+    };
+    // brackets a pass from construction to destruction
+    class Scope
+    {
+    public:
+        Scope(GpuProfiler &profiler, const std::string &name) : profiler(profiler) { profiler.push(name); }
+        ~Scope() { profiler.pop(); }
+    private:
+        GpuProfiler &profiler;
+    };
+    // frames read back, frames dropped because their results came too late
+    unsigned int frames, dropped;
+    GpuProfiler(unsigned int latency = 4, unsigned int historySize = 120);
+    ~GpuProfiler();
+    void beginFrame();
+    void endFrame();
+    // what Scope does, for passes that do not end in the scope they start in
+    void push(const std::string &name);
+    void pop();
+    // beginFrame() to endFrame()
+    const Pass &frame() const { return framePass; }
+    // every pass seen so far, in the order they first ran, a pass before the ones nested in it
+    const std::vector<Pass> &passes() const { return passList; }
+    static bool debugGroupsSupported();
+private:
+    struct Marker
+    {
+        unsigned int pass, start, end;
+    };
+    struct Frame
+    {
+        // query objects, reused from frame to frame, the first used are in use
+        std::vector<unsigned int> queries;
+        unsigned int used;
+        unsigned int start, end;
+        std::vector<Marker> markers;
+        bool pending;
+    };
+    std::vector<Frame> ring;
+    unsigned int current;
+    unsigned int historySize;
+    bool debugGroups;
+    Pass framePass;
+    std::vector<Pass> passList;
+    // index of every pass by path
+    std::map<std::string, unsigned int> passIndices;
+    // markers of the open scopes, innermost last
+    std::vector<unsigned int> open;
+    unsigned int nextQuery(Frame &frame);
+    unsigned int passIndex(const std::string &name);
+    void collect();
+    void addSample(Pass &pass, float ms, bool active);
+};
+
+bool GpuProfiler::debugGroupsSupported()
+{
+    bool supported = false;
+#ifdef GL_VERSION_4_3
+    supported = supported || GLAD_GL_VERSION_4_3;
+#endif
+#ifdef GL_KHR_debug
+    supported = supported || GLAD_GL_KHR_debug;
+#endif
+    return supported;
+}
+
+GpuProfiler::GpuProfiler(unsigned int latency, unsigned int historySize)
+    : frames(0), dropped(0), ring(latency), current(0), historySize(historySize), debugGroups(debugGroupsSupported())
+{
+    for (Frame &frame : ring)
+    {
+        frame.used = 0;
+        frame.pending = false;
+    }
+    framePass = { "frame", "frame", 0, 0.0f, 0.0f, 0.0f, std::vector<float>(historySize, 0.0f), 0, false };
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (Frame &frame : ring)
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+}
+
+unsigned int GpuProfiler::nextQuery(Frame &frame)
+{
+    if (frame.used == frame.queries.size())
+    {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    unsigned int query = frame.queries[frame.used++];
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+unsigned int GpuProfiler::passIndex(const std::string &name)
+{
+    unsigned int parent = open.empty() ? 0 : ring[current].markers[open.back()].pass;
+    std::string path = open.empty() ? name : passList[parent].path + "/" + name;
+    auto found = passIndices.find(path);
+    if (found != passIndices.end())
+        return found->second;
+    // after the parent and the passes nested in it so far, so the list reads as a tree
+    unsigned int depth = (unsigned int)open.size();
+    size_t position = passList.size();
+    if (!open.empty())
+    {
+        position = parent + 1;
+        while (position < passList.size() && passList[position].depth >= depth)
+            ++position;
+    }
+    passList.insert(passList.begin() + position, { name, path, depth, 0.0f, 0.0f, 0.0f, std::vector<float>(historySize, 0.0f), 0, false });
+    // the passes after it moved one down
+    for (auto &index : passIndices)
+        if (index.second >= position)
+            ++index.second;
+    for (Frame &frame : ring)
+        for (Marker &marker : frame.markers)
+            if (marker.pass >= position)
+                ++marker.pass;
+    passIndices[path] = (unsigned int)position;
+    return (unsigned int)position;
+}
+
+void GpuProfiler::push(const std::string &name)
+{
+    Frame &frame = ring[current];
+    Marker marker;
+    marker.pass = passIndex(name);
+    marker.start = nextQuery(frame);
+    marker.end = 0;
+    open.push_back((unsigned int)frame.markers.size());
+    frame.markers.push_back(marker);
+#ifdef GL_KHR_debug
+    if (debugGroups)
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name.c_str());
+#endif
+}
+
+void GpuProfiler::pop()
+{
+    if (open.empty())
+    {
+        std::cerr << "ERROR::GPU_PROFILER:: pop() without push()" << std::endl;
+        return;
+    }
+#ifdef GL_KHR_debug
+    if (debugGroups)
+        glPopDebugGroup();
+#endif
+    Frame &frame = ring[current];
+    frame.markers[open.back()].end = nextQuery(frame);
+    open.pop_back();
+}
+
+void GpuProfiler::addSample(Pass &pass, float ms, bool active)
+{
+    pass.history[pass.historyOffset] = ms;
+    pass.historyOffset = (pass.historyOffset + 1) % pass.history.size();
+    pass.lastMs = ms;
+    pass.active = active;
+    // until the history has been filled once it holds fewer frames than its size
+    unsigned int count = std::min<unsigned int>(frames + 1, (unsigned int)pass.history.size());
+    float sum = 0.0f;
+    pass.maxMs = 0.0f;
+    for (float value : pass.history)
+    {
+        sum += value;
+        pass.maxMs = std::max(pass.maxMs, value);
+    }
+    pass.averageMs = sum / count;
+}
+
+void GpuProfiler::collect()
+{
+    std::vector<float> passMs;
+    std::vector<bool> ran;
+    // oldest first, so samples arrive in frame order
+    for (size_t n = 0; n < ring.size(); ++n)
+    {
+        Frame &frame = ring[(current + n) % ring.size()];
+        if (!frame.pending)
+            continue;
+        // timestamps complete in order, the last one of the frame being there means all are
+        int available = 0;
+        glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        passMs.assign(passList.size(), 0.0f);
+        ran.assign(passList.size(), false);
+        for (const Marker &marker : frame.markers)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(marker.start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(marker.end, GL_QUERY_RESULT, &end);
+            // a pass that runs several times a frame adds up
+            passMs[marker.pass] += (end - start) / 1e6f;
+            ran[marker.pass] = true;
+        }
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(frame.start, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end);
+        frame.pending = false;
+        for (size_t i = 0; i < passList.size(); ++i)
+            addSample(passList[i], passMs[i], ran[i]);
+        addSample(framePass, (end - start) / 1e6f, true);
+        frames++;
+    }
+}
+
+void GpuProfiler::beginFrame()
+{
+    collect();
+    Frame &frame = ring[current];
+    if (frame.pending)
+    {
+        // still in flight after latency frames: dropped instead of waited for
+        frame.pending = false;
+        dropped++;
+    }
+    frame.used = 0;
+    frame.markers.clear();
+    open.clear();
+    frame.start = nextQuery(frame);
+}
+
+void GpuProfiler::endFrame()
+{
+    while (!open.empty())
+    {
+        std::cerr << "ERROR::GPU_PROFILER:: "
+                  << passList[ring[current].markers[open.back()].pass].name << " still open at the end of the frame" << std::endl;
+        pop();
+    }
+    Frame &frame = ring[current];
+    frame.end = nextQuery(frame);
+    frame.pending = true;
+    current = (current + 1) % ring.size();
+}
+#endif
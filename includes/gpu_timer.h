@@ -0,0 +1,146 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Measures the GPU time between begin() and end() with GL_TIME_ELAPSED queries.
+// The queries are kept in a ring and a result is only read once the driver reports it
+// available, so timing never stalls the pipeline; the reported value lags a few frames.
+// Only one GpuTimer may be between begin() and end() at a time (time elapsed queries do not nest).
+class GpuTimer
+{
+public:
+    // exponential moving average of the finished queries, in milliseconds
+    float elapsedMs;
+    GpuTimer(unsigned int latency = 4);
+    ~GpuTimer();
+    void begin();
+    void end();
+private:
+    std::vector<unsigned int> queries;
+    std::vector<bool> pending;
+    unsigned int current;
+    bool hasSample;
+    void collect();
+};
+
+GpuTimer::GpuTimer(unsigned int latency) : elapsedMs(0.0f), current(0), hasSample(false)
+{
+    queries.resize(latency);
+    pending.resize(latency, false);
+    glGenQueries(latency, queries.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(queries.size(), queries.data());
+}
+
+void GpuTimer::collect()
+{
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        if (!pending[i])
+            continue;
+        int available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        pending[i] = false;
+        float ms = ns / 1e6f;
+        elapsedMs = hasSample ? elapsedMs * 0.9f + ms * 0.1f : ms;
+        hasSample = true;
+    }
+}
+
+void GpuTimer::begin()
+{
+    collect();
+    // if the slot is still in flight its result is dropped instead of waited for
+    pending[current] = false;
+    glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[current] = true;
+    current = (current + 1) % queries.size();
+}
+
+// GPU time of a whole frame from two GL_TIMESTAMP queries per frame. Unlike GpuTimer it does not
+// occupy the time elapsed target, so GpuTimers can still run inside the frame.
+class GpuFrameTimer
+{
+public:
+    // lastMs: the newest finished frame, elapsedMs: its exponential moving average
+    float lastMs, elapsedMs;
+    // finished frames so far
+    unsigned int samples;
+    GpuFrameTimer(unsigned int latency = 4);
+    ~GpuFrameTimer();
+    void begin();
+    void end();
+private:
+    std::vector<unsigned int> starts, ends;
+    std::vector<bool> pending;
+    unsigned int current;
+    void collect();
+};
+
+GpuFrameTimer::GpuFrameTimer(unsigned int latency) : lastMs(0.0f), elapsedMs(0.0f), samples(0), current(0)
+{
+    starts.resize(latency);
+    ends.resize(latency);
+    pending.resize(latency, false);
+    glGenQueries(latency, starts.data());
+    glGenQueries(latency, ends.data());
+}
+
+GpuFrameTimer::~GpuFrameTimer()
+{
+    glDeleteQueries(starts.size(), starts.data());
+    glDeleteQueries(ends.size(), ends.data());
+}
+
+void GpuFrameTimer::collect()
+{
+    // oldest first, so samples arrive in frame order
+    for (size_t n = 0; n < starts.size(); ++n)
+    {
+        size_t i = (current + n) % starts.size();
+        if (!pending[i])
+            continue;
+        int available = 0;
+        glGetQueryObjectiv(ends[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(starts[i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(ends[i], GL_QUERY_RESULT, &end);
+        pending[i] = false;
+        lastMs = (end - start) / 1e6f;
+        elapsedMs = samples > 0 ? elapsedMs * 0.9f + lastMs * 0.1f : lastMs;
+        samples++;
+    }
+}
+
+void GpuFrameTimer::begin()
+{
+    collect();
+    pending[current] = false;
+    glQueryCounter(starts[current], GL_TIMESTAMP);
+}
+
+void GpuFrameTimer::end()
+{
+    glQueryCounter(ends[current], GL_TIMESTAMP);
+    pending[current] = true;
+    current = (current + 1) % starts.size();
+}
+
+#endif
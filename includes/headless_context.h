@@ -0,0 +1,143 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <string>
+#include <iostream>
+
+// OpenGL 3.3 core context without a window or display server, for benchmarks on CI machines.
+// The context renders into a pbuffer of the given size, which takes the place of the window's
+// default framebuffer, so code drawing to framebuffer 0 and glReadPixels work unchanged.
+// Built on EGL (HEADLESS_EGL, set by CMake when libEGL is found): the Mesa surfaceless platform
+// when the driver offers it, so no X or Wayland server is needed, otherwise the default display.
+// With Mesa and no GPU, llvmpipe renders on the CPU (LIBGL_ALWAYS_SOFTWARE=1 forces it).
+//
+//   HeadlessContext context;
+//   if (!context.create(1000, 750) || !gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+//       return -1;
+class HeadlessContext
+{
+public:
+    int width, height;
+    HeadlessContext() : width(0), height(0) {}
+    ~HeadlessContext();
+    // makes the context current on the calling thread
+    bool create(int width, int height);
+    // glad loader
+    static void *getProcAddress(const char *name);
+    static bool supported();
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+};
+
+bool HeadlessContext::supported()
+{
+#ifdef HEADLESS_EGL
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef HEADLESS_EGL
+bool HeadlessContext::create(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (extensions != nullptr && std::string(extensions).find("EGL_MESA_platform_surfaceless") != std::string::npos)
+    {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != nullptr)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        std::cerr << "ERROR::HEADLESS:: No EGL display (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+    {
+        std::cerr << "ERROR::HEADLESS:: No EGL config with desktop OpenGL and pbuffers" << std::endl;
+        return false;
+    }
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (surface == EGL_NO_SURFACE)
+    {
+        std::cerr << "ERROR::HEADLESS:: Could not create a " << width << "x" << height << " pbuffer" << std::endl;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    // the same context the windowed mains ask GLFW for
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cerr << "ERROR::HEADLESS:: No OpenGL 3.3 core context (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
+    std::cout << "HEADLESS:: EGL " << major << "." << minor << ", " << eglQueryString(display, EGL_VENDOR) << std::endl;
+    return true;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglTerminate(display);
+}
+
+void *HeadlessContext::getProcAddress(const char *name)
+{
+    return (void *)eglGetProcAddress(name);
+}
+#else
+bool HeadlessContext::create(int, int)
+{
+    std::cerr << "ERROR::HEADLESS:: Built without EGL, headless rendering is not available" << std::endl;
+    return false;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+}
+
+void *HeadlessContext::getProcAddress(const char *)
+{
+    return nullptr;
+}
+#endif
+#endif
@@ -0,0 +1,190 @@
+#ifndef INSTANCE_BATCHER_H
+#define INSTANCE_BATCHER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "mesh.h"
+#include "model.h"
+#include "instance_stream.h"
+#include "instance_builder.h"
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+// Per-instance data written by InstanceBatcher and read by the *_instanced_vert.glsl shaders:
+//   layout (location = 5) in mat4 instanceModel;
+//   layout (location = 9) in mat3 instanceNormalMatrix;
+// The attributes are set on the drawn VAOs themselves, so they start after the ones a Mesh uses
+// (0-4, tangent and bitangent at 3 and 4) and a batched Mesh still draws normally afterwards.
+struct BatchInstance {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // mat3 columns padded to vec4
+};
+
+// Automatic instancing. Draws are submitted once per frame with their model matrix; upload()
+// groups identical (geometry, texture) pairs, writes their transforms contiguously into one
+// streamed buffer and draw() issues one instanced draw per group. The same upload serves every
+// pass of the frame (shadow maps, moment maps, lighting), so a scene with N copies of a cube
+// costs one draw call per pass instead of N, and no per-draw model/normalMatrix uniforms.
+//
+//   batcher.begin();
+//   batcher.submit(cubeVAO, GL_TRIANGLES, 0, 36, texture, model);
+//   batcher.submit(model, transform);     // every mesh of a Model
+//   batcher.upload();
+//   batcher.draw(depthShader, false);     // per pass
+//   batcher.draw(lightingShader, true);
+//   batcher.endFrame();                   // after the last draw of the frame
+class InstanceBatcher
+{
+public:
+    // draws submitted in the current frame, and the instanced draws each draw() issues for them
+    unsigned int submittedDraws, batchCount;
+    InstanceBatcher(unsigned int capacity = 4096);
+    void begin();
+    // non-indexed geometry from a VAO, texture is bound to unit 0 by draw(shader, true) (0: none)
+    void submit(unsigned int VAO, GLenum mode, GLint first, GLsizei count, unsigned int texture, const glm::mat4 &model);
+    // a mesh binds its own textures through Mesh::DrawInstanced
+    void submit(Mesh &mesh, const glm::mat4 &model);
+    void submit(Model &model, const glm::mat4 &transform);
+    void upload();
+    void draw(Shader &shader, bool bindTextures);
+    void endFrame();
+private:
+    struct DrawKey {
+        Mesh *mesh;
+        unsigned int VAO;
+        GLenum mode;
+        GLint first;
+        GLsizei count;
+        unsigned int texture;
+        bool operator<(const DrawKey &o) const
+        {
+            return std::tie(VAO, mesh, texture, mode, first, count) < std::tie(o.VAO, o.mesh, o.texture, o.mode, o.first, o.count);
+        }
+        bool operator==(const DrawKey &o) const
+        {
+            return VAO == o.VAO && mesh == o.mesh && texture == o.texture && mode == o.mode && first == o.first && count == o.count;
+        }
+    };
+    struct Batch {
+        DrawKey key;
+        unsigned int firstInstance, instanceCount;
+    };
+    InstanceStream stream;
+    std::vector<DrawKey> keys;
+    std::vector<glm::mat4> models;
+    std::vector<unsigned int> order;
+    std::vector<Batch> batches;
+    // this frame's upload reached the stream, so endFrame() has a region to fence
+    bool mapped;
+    // the capacity error is printed once, not every frame the overflow lasts
+    bool reportedOverflow;
+};
+
+InstanceBatcher::InstanceBatcher(unsigned int capacity)
+    : submittedDraws(0), batchCount(0), stream(sizeof(BatchInstance), capacity), mapped(false), reportedOverflow(false)
+{
+    stream.addMat4(5, offsetof(BatchInstance, model));
+    for (unsigned int i = 0; i < 3; ++i)
+        stream.addAttribute(9 + i, 3, GL_FLOAT, offsetof(BatchInstance, normalMatrix) + i * sizeof(glm::vec4));
+}
+
+void InstanceBatcher::begin()
+{
+    keys.clear();
+    models.clear();
+    batches.clear();
+}
+
+void InstanceBatcher::submit(unsigned int VAO, GLenum mode, GLint first, GLsizei count, unsigned int texture, const glm::mat4 &model)
+{
+    keys.push_back({ nullptr, VAO, mode, first, count, texture });
+    models.push_back(model);
+}
+
+void InstanceBatcher::submit(Mesh &mesh, const glm::mat4 &model)
+{
+    keys.push_back({ &mesh, mesh.getVAO(), GL_TRIANGLES, 0, (GLsizei)mesh.indices.size(), 0 });
+    models.push_back(model);
+}
+
+void InstanceBatcher::submit(Model &model, const glm::mat4 &transform)
+{
+    for (Mesh &mesh : model.meshes)
+        submit(mesh, transform);
+}
+
+void InstanceBatcher::upload()
+{
+    submittedDraws = static_cast<unsigned int>(keys.size());
+    // group identical draws, stable so instances keep their submission order inside a batch
+    order.resize(keys.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+    BatchInstance *instances = (BatchInstance *)stream.map((unsigned int)order.size());
+    mapped = instances != nullptr;
+    if (!mapped)
+    {
+        // nothing to unmap, and no batches so draw() has nothing to bind
+        batchCount = 0;
+        return;
+    }
+    unsigned int written = stream.count;
+    if (written < order.size() && !reportedOverflow)
+    {
+        std::cerr << "ERROR::INSTANCE_BATCHER:: " << order.size() << " draws exceed the capacity of " << stream.capacity
+                  << ", the rest are not drawn" << std::endl;
+        reportedOverflow = true;
+    }
+    for (unsigned int i = 0; i < written; ++i)
+    {
+        const DrawKey &key = keys[order[i]];
+        const glm::mat4 &model = models[order[i]];
+        glm::mat3 normalMatrix = affineNormalMatrix(model);
+        instances[i].model = model;
+        instances[i].normalMatrix[0] = glm::vec4(normalMatrix[0], 0.0f);
+        instances[i].normalMatrix[1] = glm::vec4(normalMatrix[1], 0.0f);
+        instances[i].normalMatrix[2] = glm::vec4(normalMatrix[2], 0.0f);
+        if (batches.empty() || !(batches.back().key == key))
+            batches.push_back({ key, i, 0 });
+        batches.back().instanceCount++;
+    }
+    stream.unmap();
+    batchCount = static_cast<unsigned int>(batches.size());
+}
+
+void InstanceBatcher::draw(Shader &shader, bool bindTextures)
+{
+    for (const Batch &batch : batches)
+    {
+        stream.bind(batch.key.VAO, batch.firstInstance);
+        if (batch.key.mesh)
+        {
+            batch.key.mesh->DrawInstanced(shader, batch.instanceCount);
+            continue;
+        }
+        if (bindTextures && batch.key.texture)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, batch.key.texture);
+        }
+        glBindVertexArray(batch.key.VAO);
+        glDrawArraysInstanced(batch.key.mode, batch.key.first, batch.key.count, batch.instanceCount);
+    }
+    glBindVertexArray(0);
+}
+
+void InstanceBatcher::endFrame()
+{
+    if (mapped)
+        stream.fence();
+    mapped = false;
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef INSTANCE_BUILDER_H
+#define INSTANCE_BUILDER_H
+
+#include <glm/glm.hpp>
+
+#include "instance_transform.h"
+#include "thread_pool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Small, fast, seedable generator (xorshift64* seeded through splitmix64). Each chunk of a
+// parallel loop owns one, seeded from (seed, chunk index), so the output does not depend on the
+// thread count or on which thread ran the chunk.
+class InstanceRng
+{
+public:
+    InstanceRng(uint64_t seed, uint64_t stream);
+    uint32_t next();
+    // uniform in [lo, hi)
+    float uniform(float lo, float hi) { return lo + (hi - lo) * (next() >> 8) * (1.0f / 16777216.0f); }
+private:
+    uint64_t state;
+};
+
+// Shape of the asteroid belt
+struct BeltParams {
+    float radius = 20.0f;
+    float offset = 2.5f;        // positions are displaced by [-offset, offset]
+    float heightScale = 0.4f;   // the belt is flatter than it is wide
+    float minScale = 0.05f, maxScale = 0.25f;
+    glm::vec3 spinAxis = glm::vec3(0.4f, 0.6f, 0.8f);
+};
+
+// Orbit parameters of every rock, stored as structure of arrays so build() can run 4 rocks per
+// SSE2 iteration. generate() fills them in parallel; build() turns them into InstanceTransforms
+// for a point in time and is cheap enough to run every frame for 10^5 - 10^6 rocks.
+class AsteroidField
+{
+public:
+    static const size_t CHUNK_SIZE = 4096;
+    BeltParams params;
+    std::vector<float> orbitRadius, orbitAngle, orbitRate, orbitHeight, scale, spinAngle;
+    size_t size() const { return orbitRadius.size(); }
+    void generate(size_t count, const BeltParams &params, uint64_t seed, ThreadPool &pool);
+    // writes rocks [first, first + count) at the given time
+    void build(InstanceTransform *out, size_t first, size_t count, float time, float orbitSpeed, float spinSpeed) const;
+    // writes rocks [0, count) into out (InstanceTransform or, if quantized, QuantizedInstanceTransform)
+    void buildParallel(void *out, size_t count, bool quantized, const InstanceBounds &bounds, float time, float orbitSpeed, float spinSpeed, ThreadPool &pool) const;
+    // dequantization range covering every rock of the belt
+    InstanceBounds bounds() const;
+};
+
+// Inverse transpose of the upper 3x3 of an affine transform through its cofactor matrix: three
+// cross products and a determinant instead of a general 4x4 inverse. affineNormalMatrices() does
+// 4 matrices per SSE2 iteration, transposed to structure of arrays like build().
+glm::mat3 affineNormalMatrix(const glm::mat4 &model);
+void affineNormalMatrices(const glm::mat4 *models, glm::mat3 *normals, size_t count);
+
+#ifdef INSTANCE_TRANSFORM_SSE2
+// sin and cos of 4 floats: Cody-Waite reduction to [-pi/4, pi/4] and Taylor polynomials, ~1e-7 absolute error
+inline void sincos_ps(__m128 x, __m128 &s, __m128 &c)
+{
+    const __m128 twoOverPi = _mm_set1_ps(0.636619772f);
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, twoOverPi));
+    __m128 j = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5703125f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(4.83751297e-4f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(7.54978995e-8f)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 ps = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.75573192e-6f)), _mm_set1_ps(-1.98412698e-4f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(8.33333333e-3f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(-1.66666667e-1f));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, r2), r), r);
+    __m128 pc = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.48015873e-5f)), _mm_set1_ps(-1.38888889e-3f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(4.16666667e-2f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(-0.5f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(1.0f));
+
+    // odd quadrants swap sin and cos, quadrants 2, 3 negate sin and 1, 2 negate cos
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign);
+    c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign);
+}
+#endif
+
+InstanceRng::InstanceRng(uint64_t seed, uint64_t stream)
+{
+    uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    state = (z ^ (z >> 31)) | 1;
+}
+
+uint32_t InstanceRng::next()
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return static_cast<uint32_t>((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+void AsteroidField::generate(size_t count, const BeltParams &params, uint64_t seed, ThreadPool &pool)
+{
+    this->params = params;
+    this->params.spinAxis = glm::normalize(params.spinAxis);
+    orbitRadius.resize(count);
+    orbitAngle.resize(count);
+    orbitRate.resize(count);
+    orbitHeight.resize(count);
+    scale.resize(count);
+    spinAngle.resize(count);
+    const float TWO_PI = 6.28318530718f;
+    pool.parallelFor(count, CHUNK_SIZE, [&](size_t begin, size_t end, size_t chunk) {
+        InstanceRng rng(seed, chunk);
+        for (size_t i = begin; i < end; ++i)
+        {
+            // random phase rather than i / count, so any prefix of the field covers the whole ring
+            orbitAngle[i] = rng.uniform(0.0f, TWO_PI);
+            orbitRadius[i] = params.radius + rng.uniform(-params.offset, params.offset);
+            // inner rocks orbit faster, like a keplerian disc
+            orbitRate[i] = params.radius / orbitRadius[i];
+            orbitHeight[i] = rng.uniform(-params.offset, params.offset) * params.heightScale;
+            scale[i] = rng.uniform(params.minScale, params.maxScale);
+            spinAngle[i] = rng.uniform(0.0f, TWO_PI);
+        }
+    });
+}
+
+void AsteroidField::build(InstanceTransform *out, size_t first, size_t count, float time, float orbitSpeed, float spinSpeed) const
+{
+    size_t i = first, last = first + count;
+#ifdef INSTANCE_TRANSFORM_SSE2
+    const __m128 orbitTime = _mm_set1_ps(time * orbitSpeed);
+    const __m128 spinTime = _mm_set1_ps(time * spinSpeed);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 ax = _mm_set1_ps(params.spinAxis.x), ay = _mm_set1_ps(params.spinAxis.y), az = _mm_set1_ps(params.spinAxis.z);
+    for (; i + 4 <= last; i += 4)
+    {
+        __m128 angle = _mm_add_ps(_mm_loadu_ps(&orbitAngle[i]), _mm_mul_ps(orbitTime, _mm_loadu_ps(&orbitRate[i])));
+        __m128 sa, ca;
+        sincos_ps(angle, sa, ca);
+        __m128 r = _mm_loadu_ps(&orbitRadius[i]);
+        __m128 px = _mm_mul_ps(sa, r);
+        __m128 py = _mm_loadu_ps(&orbitHeight[i]);
+        __m128 pz = _mm_mul_ps(ca, r);
+        __m128 pw = _mm_loadu_ps(&scale[i]);
+        __m128 sh, ch;
+        sincos_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&spinAngle[i]), spinTime), half), sh, ch);
+        __m128 qx = _mm_mul_ps(ax, sh), qy = _mm_mul_ps(ay, sh), qz = _mm_mul_ps(az, sh), qw = ch;
+        // structure of arrays -> 4 instances
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+        InstanceTransform *o = out + (i - first);
+        _mm_storeu_ps(&o[0].positionScale.x, px);
+        _mm_storeu_ps(&o[0].rotation.x, qx);
+        _mm_storeu_ps(&o[1].positionScale.x, py);
+        _mm_storeu_ps(&o[1].rotation.x, qy);
+        _mm_storeu_ps(&o[2].positionScale.x, pz);
+        _mm_storeu_ps(&o[2].rotation.x, qz);
+        _mm_storeu_ps(&o[3].positionScale.x, pw);
+        _mm_storeu_ps(&o[3].rotation.x, qw);
+    }
+#endif
+    for (; i < last; ++i)
+    {
+        float angle = orbitAngle[i] + time * orbitSpeed * orbitRate[i];
+        InstanceTransform &o = out[i - first];
+        o.positionScale = glm::vec4(std::sin(angle) * orbitRadius[i], orbitHeight[i], std::cos(angle) * orbitRadius[i], scale[i]);
+        o.rotation = axisAngleQuaternion(params.spinAxis, spinAngle[i] + time * spinSpeed);
+    }
+}
+
+void AsteroidField::buildParallel(void *out, size_t count, bool quantized, const InstanceBounds &bounds, float time, float orbitSpeed, float spinSpeed, ThreadPool &pool) const
+{
+    count = std::min(count, size());
+    pool.parallelFor(count, CHUNK_SIZE, [&](size_t begin, size_t end, size_t) {
+        if (!quantized)
+        {
+            build((InstanceTransform *)out + begin, begin, end - begin, time, orbitSpeed, spinSpeed);
+            return;
+        }
+        // build into a cache-resident batch, then quantize into the destination
+        const size_t BATCH = 256;
+        InstanceTransform batch[BATCH];
+        for (size_t first = begin; first < end; first += BATCH)
+        {
+            size_t n = std::min(BATCH, end - first);
+            build(batch, first, n, time, orbitSpeed, spinSpeed);
+            quantizeInstances(batch, (QuantizedInstanceTransform *)out + first, n, bounds);
+        }
+    });
+}
+
+InstanceBounds AsteroidField::bounds() const
+{
+    return { glm::vec3(0.0f),
+             glm::vec3(params.radius + params.offset, params.offset * params.heightScale, params.radius + params.offset),
+             params.maxScale };
+}
+
+glm::mat3 affineNormalMatrix(const glm::mat4 &model)
+{
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 x = glm::cross(c1, c2), y = glm::cross(c2, c0), z = glm::cross(c0, c1);
+    float invDet = 1.0f / glm::dot(c0, x);
+    return glm::mat3(x * invDet, y * invDet, z * invDet);
+}
+
+void affineNormalMatrices(const glm::mat4 *models, glm::mat3 *normals, size_t count)
+{
+    size_t i = 0;
+#ifdef INSTANCE_TRANSFORM_SSE2
+    static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "glm::mat3 must be 9 packed floats");
+    for (; i + 4 <= count; i += 4)
+    {
+        // column c of 4 matrices -> c.x, c.y, c.z of the 4 (w is dropped)
+        __m128 c0x = _mm_loadu_ps(&models[i][0].x), c0y = _mm_loadu_ps(&models[i + 1][0].x);
+        __m128 c0z = _mm_loadu_ps(&models[i + 2][0].x), c0w = _mm_loadu_ps(&models[i + 3][0].x);
+        _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+        __m128 c1x = _mm_loadu_ps(&models[i][1].x), c1y = _mm_loadu_ps(&models[i + 1][1].x);
+        __m128 c1z = _mm_loadu_ps(&models[i + 2][1].x), c1w = _mm_loadu_ps(&models[i + 3][1].x);
+        _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+        __m128 c2x = _mm_loadu_ps(&models[i][2].x), c2y = _mm_loadu_ps(&models[i + 1][2].x);
+        __m128 c2z = _mm_loadu_ps(&models[i + 2][2].x), c2w = _mm_loadu_ps(&models[i + 3][2].x);
+        _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+
+        // x = c1 x c2, y = c2 x c0, z = c0 x c1
+        __m128 xx = _mm_sub_ps(_mm_mul_ps(c1y, c2z), _mm_mul_ps(c1z, c2y));
+        __m128 xy = _mm_sub_ps(_mm_mul_ps(c1z, c2x), _mm_mul_ps(c1x, c2z));
+        __m128 xz = _mm_sub_ps(_mm_mul_ps(c1x, c2y), _mm_mul_ps(c1y, c2x));
+        __m128 yx = _mm_sub_ps(_mm_mul_ps(c2y, c0z), _mm_mul_ps(c2z, c0y));
+        __m128 yy = _mm_sub_ps(_mm_mul_ps(c2z, c0x), _mm_mul_ps(c2x, c0z));
+        __m128 yz = _mm_sub_ps(_mm_mul_ps(c2x, c0y), _mm_mul_ps(c2y, c0x));
+        __m128 zx = _mm_sub_ps(_mm_mul_ps(c0y, c1z), _mm_mul_ps(c0z, c1y));
+        __m128 zy = _mm_sub_ps(_mm_mul_ps(c0z, c1x), _mm_mul_ps(c0x, c1z));
+        __m128 zz = _mm_sub_ps(_mm_mul_ps(c0x, c1y), _mm_mul_ps(c0y, c1x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0x, xx), _mm_mul_ps(c0y, xy)), _mm_mul_ps(c0z, xz));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        xx = _mm_mul_ps(xx, invDet); xy = _mm_mul_ps(xy, invDet); xz = _mm_mul_ps(xz, invDet);
+        yx = _mm_mul_ps(yx, invDet); yy = _mm_mul_ps(yy, invDet); yz = _mm_mul_ps(yz, invDet);
+        zx = _mm_mul_ps(zx, invDet); zy = _mm_mul_ps(zy, invDet); zz = _mm_mul_ps(zz, invDet);
+
+        // structure of arrays -> the first 8 floats of each mat3, the 9th separately
+        _MM_TRANSPOSE4_PS(xx, xy, xz, yx);
+        _MM_TRANSPOSE4_PS(yy, yz, zx, zy);
+        float last[4];
+        _mm_storeu_ps(last, zz);
+        float *out = &normals[i][0].x;
+        _mm_storeu_ps(out, xx);
+        _mm_storeu_ps(out + 4, yy);
+        _mm_storeu_ps(out + 9, xy);
+        _mm_storeu_ps(out + 13, yz);
+        _mm_storeu_ps(out + 18, xz);
+        _mm_storeu_ps(out + 22, zx);
+        _mm_storeu_ps(out + 27, yx);
+        _mm_storeu_ps(out + 31, zy);
+        out[8] = last[0];
+        out[17] = last[1];
+        out[26] = last[2];
+        out[35] = last[3];
+    }
+#endif
+    for (; i < count; ++i)
+        normals[i] = affineNormalMatrix(models[i]);
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef INSTANCE_STREAM_H
+#define INSTANCE_STREAM_H
+
+#include <glad/glad.h>
+
+#include "stream_buffer.h"
+
+#include <vector>
+#include <chrono>
+
+// Per-instance vertex attribute read from an InstanceStream, offset is relative to the instance start.
+struct InstanceAttribute {
+    unsigned int location;
+    int components;
+    GLenum type;
+    GLboolean normalized;
+    // read with glVertexAttribIPointer into an int/uint attribute
+    bool integer;
+    size_t offset;
+};
+
+// Instance data rewritten every frame. The simulation writes straight into the mapped region
+// returned by map(), so there is no staging copy and no glBufferData reallocation:
+//
+//   Instance *data = (Instance *)instances.map(count);
+//   ... fill data[0, count) ...
+//   instances.unmap();
+//   instances.bind(mesh.getVAO());  // for every VAO drawn with this data
+//   ... glDrawElementsInstanced(..., count) ...
+//   instances.fence();
+//
+// GL 3.3 has no base instance, so bind() re-points the attributes at the region written this frame.
+class InstanceStream
+{
+public:
+    size_t stride;
+    unsigned int capacity;
+    // instances written by the last map()
+    unsigned int count;
+    // CPU time the last map() spent waiting for the GPU to release the region
+    float waitTimeMs;
+    // smoothed upload rate, bytes written per second of wall time between unmap() calls
+    float uploadMBps;
+    InstanceStream(size_t stride, unsigned int capacity, unsigned int regions = 3);
+    void addAttribute(unsigned int location, int components, GLenum type, size_t offset, GLboolean normalized = GL_FALSE);
+    void addIntAttribute(unsigned int location, int components, GLenum type, size_t offset);
+    // mat4 attribute: four vec4 columns at consecutive locations
+    void addMat4(unsigned int location, size_t offset);
+    void *map(unsigned int count);
+    void unmap();
+    // firstInstance selects a sub-range of this frame's data, e.g. one batch of a larger upload
+    void bind(unsigned int VAO, unsigned int firstInstance = 0);
+    void fence();
+    bool persistent() const { return stream.persistent; }
+private:
+    StreamBuffer stream;
+    std::vector<InstanceAttribute> attributes;
+    size_t offset;
+    std::chrono::high_resolution_clock::time_point lastUnmap;
+    bool firstUnmap;
+};
+
+InstanceStream::InstanceStream(size_t stride, unsigned int capacity, unsigned int regions)
+    : stride(stride), capacity(capacity), count(0), waitTimeMs(0.0f), uploadMBps(0.0f),
+      stream(GL_ARRAY_BUFFER, stride * capacity, regions), offset(0), firstUnmap(true)
+{
+}
+
+void InstanceStream::addAttribute(unsigned int location, int components, GLenum type, size_t offset, GLboolean normalized)
+{
+    attributes.push_back({ location, components, type, normalized, false, offset });
+}
+
+void InstanceStream::addIntAttribute(unsigned int location, int components, GLenum type, size_t offset)
+{
+    attributes.push_back({ location, components, type, GL_FALSE, true, offset });
+}
+
+void InstanceStream::addMat4(unsigned int location, size_t offset)
+{
+    for (unsigned int i = 0; i < 4; ++i)
+        addAttribute(location + i, 4, GL_FLOAT, offset + i * 4 * sizeof(float));
+}
+
+void *InstanceStream::map(unsigned int count)
+{
+    this->count = count < capacity ? count : capacity;
+    // a zero-sized map is an error on the orphaning path
+    void *ptr = stream.map((this->count > 0 ? this->count : 1) * stride);
+    waitTimeMs = stream.waitTimeMs;
+    return ptr;
+}
+
+void InstanceStream::unmap()
+{
+    offset = stream.unmap();
+    auto now = std::chrono::high_resolution_clock::now();
+    if (!firstUnmap)
+    {
+        float seconds = std::chrono::duration<float>(now - lastUnmap).count();
+        if (seconds > 0.0f)
+            uploadMBps = 0.9f * uploadMBps + 0.1f * (count * stride / seconds / (1024.0f * 1024.0f));
+    }
+    lastUnmap = now;
+    firstUnmap = false;
+}
+
+void InstanceStream::bind(unsigned int VAO, unsigned int firstInstance)
+{
+    size_t base = offset + firstInstance * stride;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    for (const InstanceAttribute &attribute : attributes)
+    {
+        glEnableVertexAttribArray(attribute.location);
+        if (attribute.integer)
+            glVertexAttribIPointer(attribute.location, attribute.components, attribute.type,
+                                   (GLsizei)stride, (void *)(base + attribute.offset));
+        else
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                                  (GLsizei)stride, (void *)(base + attribute.offset));
+        glVertexAttribDivisor(attribute.location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void InstanceStream::fence()
+{
+    stream.fence();
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef INSTANCE_TRANSFORM_H
+#define INSTANCE_TRANSFORM_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+#include "instance_stream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INSTANCE_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+// Compact per-instance transform for uniformly scaled, rigidly rotated instances. The vertex
+// shader (shaders/instancing/instancing_vert.glsl) rebuilds the transform from it:
+//   world  = positionScale.xyz + positionScale.w * rotate(rotation, aPos)
+//   normal = rotate(rotation, aNormal)
+// With a uniform scale the inverse transpose is the rotation itself, so no normal matrix is stored.
+struct InstanceTransform {
+    glm::vec4 positionScale; // xyz position, w uniform scale
+    glm::vec4 rotation;      // unit quaternion, xyz vector part, w scalar part
+};
+
+// The same transform in 16 bytes: position and scale as snorm16 relative to the bounds of the
+// instance field, rotation as a snorm16 quaternion (renormalized in the shader).
+struct QuantizedInstanceTransform {
+    int16_t positionScale[4];
+    int16_t rotation[4];
+};
+
+static_assert(sizeof(InstanceTransform) == 32, "InstanceTransform must stay 32 bytes");
+static_assert(sizeof(QuantizedInstanceTransform) == 16, "QuantizedInstanceTransform must stay 16 bytes");
+
+// Dequantization range of QuantizedInstanceTransform, set as uniforms with setInstanceBounds().
+struct InstanceBounds {
+    glm::vec3 center;
+    glm::vec3 extent;   // half size, positions must lie in center +- extent
+    float maxScale;
+};
+
+// quaternion rotating by angle (radians) around a unit axis
+inline glm::vec4 axisAngleQuaternion(const glm::vec3 &axis, float angle)
+{
+    float s = std::sin(angle * 0.5f);
+    return glm::vec4(axis * s, std::cos(angle * 0.5f));
+}
+
+// Packs count transforms into the quantized format. The SSE2 path converts one instance (two
+// 4-wide float vectors) per iteration, the scalar loop is the reference and handles other targets.
+void quantizeInstances(const InstanceTransform *in, QuantizedInstanceTransform *out, size_t count, const InstanceBounds &bounds);
+
+// Adds the attributes read by instancing_vert.glsl (locations 3 and 4) to a stream of
+// InstanceTransform or QuantizedInstanceTransform.
+void addInstanceTransformAttributes(InstanceStream &stream, bool quantized);
+
+// Sets the uniforms instancing_vert.glsl uses to decode the instance format.
+void setInstanceBounds(Shader &shader, bool quantized, const InstanceBounds &bounds);
+
+void quantizeInstances(const InstanceTransform *in, QuantizedInstanceTransform *out, size_t count, const InstanceBounds &bounds)
+{
+    // map position to [-1, 1] and scale to [0, 1], then to the snorm16 range
+    glm::vec4 invRange(1.0f / bounds.extent.x, 1.0f / bounds.extent.y, 1.0f / bounds.extent.z, 1.0f / bounds.maxScale);
+    glm::vec4 center(bounds.center, 0.0f);
+#ifdef INSTANCE_TRANSFORM_SSE2
+    const __m128 scale = _mm_mul_ps(_mm_loadu_ps(&invRange.x), _mm_set1_ps(32767.0f));
+    const __m128 offset = _mm_loadu_ps(&center.x);
+    const __m128 unit = _mm_set1_ps(32767.0f);
+    const __m128 lo = _mm_set1_ps(-32767.0f), hi = _mm_set1_ps(32767.0f);
+    for (size_t i = 0; i < count; ++i)
+    {
+        __m128 p = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&in[i].positionScale.x), offset), scale);
+        __m128 q = _mm_mul_ps(_mm_loadu_ps(&in[i].rotation.x), unit);
+        p = _mm_min_ps(_mm_max_ps(p, lo), hi);
+        q = _mm_min_ps(_mm_max_ps(q, lo), hi);
+        // round to nearest, saturate-pack both vectors into eight int16
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(p), _mm_cvtps_epi32(q));
+        _mm_storeu_si128((__m128i *)&out[i], packed);
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec4 p = (in[i].positionScale - center) * invRange * 32767.0f;
+        glm::vec4 q = in[i].rotation * 32767.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            out[i].positionScale[c] = (int16_t)std::lround(std::min(std::max(p[c], -32767.0f), 32767.0f));
+            out[i].rotation[c] = (int16_t)std::lround(std::min(std::max(q[c], -32767.0f), 32767.0f));
+        }
+    }
+#endif
+}
+
+void addInstanceTransformAttributes(InstanceStream &stream, bool quantized)
+{
+    if (quantized)
+    {
+        stream.addAttribute(3, 4, GL_SHORT, offsetof(QuantizedInstanceTransform, positionScale), GL_TRUE);
+        stream.addAttribute(4, 4, GL_SHORT, offsetof(QuantizedInstanceTransform, rotation), GL_TRUE);
+    }
+    else
+    {
+        stream.addAttribute(3, 4, GL_FLOAT, offsetof(InstanceTransform, positionScale));
+        stream.addAttribute(4, 4, GL_FLOAT, offsetof(InstanceTransform, rotation));
+    }
+}
+
+void setInstanceBounds(Shader &shader, bool quantized, const InstanceBounds &bounds)
+{
+    shader.setBool("quantizedInstances", quantized);
+    shader.setVec3("instanceCenter", bounds.center.x, bounds.center.y, bounds.center.z);
+    glm::vec4 extent(bounds.extent, bounds.maxScale);
+    shader.setVec4("instanceExtent", glm::value_ptr(extent));
+}
+
+#endif
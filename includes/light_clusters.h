@@ -0,0 +1,327 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Point light as it is stored in the light texture buffer: two rgba32f texels per light.
+struct ClusterLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float padding;
+};
+
+// View-space light spheres as structure of arrays. The arrays are padded to a multiple of 4 past
+// count with spheres that overlap no froxel, so the SSE loops have no scalar tail.
+struct LightSpheres {
+    std::vector<float> x, y, depth, radius;
+    // index into the light list
+    std::vector<unsigned int> light;
+    unsigned int count = 0;
+    static unsigned int padded(unsigned int count) { return (count + 3) & ~3u; }
+    // sets count and pads, the first count spheres are left to the caller
+    void resize(unsigned int count);
+    // spheres[hits[0..hitCount)] of from
+    void gather(const LightSpheres &from, const unsigned int *hits, unsigned int hitCount);
+};
+
+// View-space box around a froxel (or a row or slice of froxels, with infinite x / y extents)
+struct FroxelBounds {
+    float xMin, xMax, yMin, yMax, depthMin, depthMax;
+};
+
+// Clustered light culling. The view frustum is split into tilesX * tilesY screen tiles and
+// slices exponential depth slices (froxels). Every frame update() assigns each light sphere to
+// the froxels it overlaps on the CPU, one depth slice per ThreadPool chunk. A slice narrows the
+// lights down to the ones overlapping its depth range, then to each tile row, and tests those
+// against every froxel's box 4 lights per SSE2 iteration, writing into its own flat index array.
+// The result is uploaded as three texture buffers:
+//   clusterGrid          rg32ui   (offset, count) into the index list, one texel per cluster
+//   clusterLightIndices  r32ui    light indices, grouped by cluster
+//   clusterLightData     rgba32f  the ClusterLight array
+// and the forward shader only loops over the lights of the cluster its fragment falls into.
+class LightClusters
+{
+public:
+    unsigned int tilesX, tilesY, slices;
+    // total number of light indices written by the last update
+    unsigned int indexCount;
+    // CPU time spent in the last update (assignment + upload)
+    float updateTimeMs;
+    // pool must outlive the clusters
+    LightClusters(ThreadPool &pool, unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+    ~LightClusters();
+    void update(const std::vector<ClusterLight> &lights, const glm::mat4 &view, float fovY, float aspect, float near, float far);
+    // binds the three buffers to consecutive texture units and sets the cluster uniforms
+    void bind(Shader &shader, unsigned int firstUnit, unsigned int screenWidth, unsigned int screenHeight);
+    // writes the positions in spheres of the ones overlapping bounds to hits (room for padded(spheres.count)), returns their number
+    static unsigned int overlapping(const LightSpheres &spheres, const FroxelBounds &bounds, unsigned int *hits);
+private:
+    // what one slice works on, reused across frames
+    struct SliceWork {
+        LightSpheres sliceLights, rowLights;
+        std::vector<unsigned int> hits;
+        // light indices of the slice's clusters, grid offsets are relative to it until update() adds them up
+        std::vector<unsigned int> indices;
+        unsigned int indexCount = 0;
+    };
+    ThreadPool &pool;
+    unsigned int gridBuffer, gridTexture;
+    unsigned int indexBuffer, indexTexture;
+    unsigned int lightBuffer, lightTexture;
+    unsigned int lightCount;
+    float near, far;
+    LightSpheres spheres;
+    std::vector<SliceWork> sliceWork;
+    std::vector<unsigned int> grid;
+    void assignSlice(unsigned int slice, float xScale, float yScale);
+    float sliceDepth(unsigned int slice) const;
+    static void createBuffer(unsigned int &buffer, unsigned int &texture, GLenum format);
+};
+
+void LightSpheres::resize(unsigned int count)
+{
+    this->count = count;
+    size_t size = padded(count);
+    if (x.size() < size)
+    {
+        x.resize(size);
+        y.resize(size);
+        depth.resize(size);
+        radius.resize(size);
+        light.resize(size);
+    }
+    // behind the camera and far from every box, overlapping nothing
+    for (size_t i = count; i < size; ++i)
+    {
+        x[i] = y[i] = 0.0f;
+        depth[i] = -1e30f;
+        radius[i] = 0.0f;
+        light[i] = 0;
+    }
+}
+
+void LightSpheres::gather(const LightSpheres &from, const unsigned int *hits, unsigned int hitCount)
+{
+    resize(hitCount);
+    for (unsigned int k = 0; k < hitCount; ++k)
+    {
+        unsigned int i = hits[k];
+        x[k] = from.x[i];
+        y[k] = from.y[i];
+        depth[k] = from.depth[i];
+        radius[k] = from.radius[i];
+        light[k] = from.light[i];
+    }
+}
+
+LightClusters::LightClusters(ThreadPool &pool, unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+    : tilesX(tilesX), tilesY(tilesY), slices(slices), indexCount(0), updateTimeMs(0.0f), pool(pool), lightCount(0), near(0.1f), far(100.0f)
+{
+    sliceWork.resize(slices);
+    grid.resize(2 * tilesX * tilesY * slices);
+    createBuffer(gridBuffer, gridTexture, GL_RG32UI);
+    createBuffer(indexBuffer, indexTexture, GL_R32UI);
+    createBuffer(lightBuffer, lightTexture, GL_RGBA32F);
+}
+
+LightClusters::~LightClusters()
+{
+    glDeleteTextures(1, &gridTexture);
+    glDeleteTextures(1, &indexTexture);
+    glDeleteTextures(1, &lightTexture);
+    glDeleteBuffers(1, &gridBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &lightBuffer);
+}
+
+void LightClusters::createBuffer(unsigned int &buffer, unsigned int &texture, GLenum format)
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // a texture buffer must not be empty when it is sampled
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+float LightClusters::sliceDepth(unsigned int slice) const
+{
+    return near * std::pow(far / near, (float)slice / slices);
+}
+
+void LightClusters::update(const std::vector<ClusterLight> &lights, const glm::mat4 &view, float fovY, float aspect, float near, float far)
+{
+    CPU_PROFILE_SCOPE("LightClusters::update");
+    auto start = std::chrono::high_resolution_clock::now();
+    this->near = near;
+    this->far = far;
+    lightCount = static_cast<unsigned int>(lights.size());
+
+    spheres.resize(lightCount);
+    for (unsigned int i = 0; i < lightCount; ++i)
+    {
+        glm::vec4 p = view * glm::vec4(lights[i].position, 1.0f);
+        spheres.x[i] = p.x;
+        spheres.y[i] = p.y;
+        spheres.depth[i] = -p.z;
+        spheres.radius[i] = lights[i].radius;
+        spheres.light[i] = i;
+    }
+
+    // ndc = view-space xy * scale / depth
+    float yScale = 1.0f / std::tan(fovY * 0.5f);
+    float xScale = yScale / aspect;
+    pool.parallelFor(slices, 1, [&](size_t slice, size_t, size_t) {
+        assignSlice(static_cast<unsigned int>(slice), xScale, yScale);
+    });
+
+    // the slices' index arrays follow each other in the index buffer
+    unsigned int tiles = tilesX * tilesY;
+    indexCount = 0;
+    for (unsigned int s = 0; s < slices; ++s)
+    {
+        for (unsigned int c = s * tiles; c < (s + 1) * tiles; ++c)
+            grid[2 * c] += indexCount;
+        indexCount += sliceWork[s].indexCount;
+    }
+
+    // orphan and refill, the driver hands out fresh storage while the last frame may still read the old one
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(unsigned int), grid.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indexCount, 1) * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+    for (unsigned int s = 0, offset = 0; s < slices; offset += sliceWork[s].indexCount, ++s)
+    {
+        if (sliceWork[s].indexCount > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, offset * sizeof(unsigned int), sliceWork[s].indexCount * sizeof(unsigned int), sliceWork[s].indices.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(lights.size(), 1) * sizeof(ClusterLight), lights.empty() ? NULL : lights.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    updateTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned int LightClusters::overlapping(const LightSpheres &spheres, const FroxelBounds &bounds, unsigned int *hits)
+{
+    // squared distance from the sphere center to the box against the squared radius
+    unsigned int hitCount = 0, count = LightSpheres::padded(spheres.count);
+#ifdef LIGHT_CLUSTERS_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 xMin = _mm_set1_ps(bounds.xMin), xMax = _mm_set1_ps(bounds.xMax);
+    const __m128 yMin = _mm_set1_ps(bounds.yMin), yMax = _mm_set1_ps(bounds.yMax);
+    const __m128 depthMin = _mm_set1_ps(bounds.depthMin), depthMax = _mm_set1_ps(bounds.depthMax);
+    for (unsigned int i = 0; i < count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&spheres.x[i]), y = _mm_loadu_ps(&spheres.y[i]), depth = _mm_loadu_ps(&spheres.depth[i]);
+        __m128 radius = _mm_loadu_ps(&spheres.radius[i]);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(xMin, x), _mm_sub_ps(x, xMax)), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(yMin, y), _mm_sub_ps(y, yMax)), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(depthMin, depth), _mm_sub_ps(depth, depthMax)), zero);
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_mul_ps(radius, radius)));
+        // every lane is written, only the hits advance
+        hits[hitCount] = i;
+        hitCount += mask & 1;
+        hits[hitCount] = i + 1;
+        hitCount += (mask >> 1) & 1;
+        hits[hitCount] = i + 2;
+        hitCount += (mask >> 2) & 1;
+        hits[hitCount] = i + 3;
+        hitCount += (mask >> 3) & 1;
+    }
+#else
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        float dx = std::max(std::max(bounds.xMin - spheres.x[i], spheres.x[i] - bounds.xMax), 0.0f);
+        float dy = std::max(std::max(bounds.yMin - spheres.y[i], spheres.y[i] - bounds.yMax), 0.0f);
+        float dz = std::max(std::max(bounds.depthMin - spheres.depth[i], spheres.depth[i] - bounds.depthMax), 0.0f);
+        hits[hitCount] = i;
+        hitCount += dx * dx + dy * dy + dz * dz <= spheres.radius[i] * spheres.radius[i];
+    }
+#endif
+    return hitCount;
+}
+
+void LightClusters::assignSlice(unsigned int slice, float xScale, float yScale)
+{
+    CPU_PROFILE_SCOPE("LightClusters::assignSlice");
+    SliceWork &work = sliceWork[slice];
+    const float INF = std::numeric_limits<float>::infinity();
+    float depth0 = sliceDepth(slice), depth1 = sliceDepth(slice + 1);
+    FroxelBounds bounds = { -INF, INF, -INF, INF, depth0, depth1 };
+    work.hits.resize(std::max<size_t>(work.hits.size(), LightSpheres::padded(lightCount)));
+    work.sliceLights.gather(spheres, work.hits.data(), overlapping(spheres, bounds, work.hits.data()));
+    work.indexCount = 0;
+
+    unsigned int firstCluster = slice * tilesX * tilesY;
+    for (unsigned int ty = 0; ty < tilesY; ++ty)
+    {
+        // view-space y = ndc * depth / yScale, extremal at the slice's near or far depth
+        float ndcY0 = -1.0f + 2.0f * ty / tilesY, ndcY1 = -1.0f + 2.0f * (ty + 1) / tilesY;
+        bounds.xMin = -INF;
+        bounds.xMax = INF;
+        bounds.yMin = std::min(ndcY0 * depth0, ndcY0 * depth1) / yScale;
+        bounds.yMax = std::max(ndcY1 * depth0, ndcY1 * depth1) / yScale;
+        work.rowLights.gather(work.sliceLights, work.hits.data(), overlapping(work.sliceLights, bounds, work.hits.data()));
+        for (unsigned int tx = 0; tx < tilesX; ++tx)
+        {
+            float ndcX0 = -1.0f + 2.0f * tx / tilesX, ndcX1 = -1.0f + 2.0f * (tx + 1) / tilesX;
+            bounds.xMin = std::min(ndcX0 * depth0, ndcX0 * depth1) / xScale;
+            bounds.xMax = std::max(ndcX1 * depth0, ndcX1 * depth1) / xScale;
+            // room for every light of the row
+            size_t needed = work.indexCount + LightSpheres::padded(work.rowLights.count);
+            if (work.indices.size() < needed)
+                work.indices.resize(std::max(needed, 2 * work.indices.size()));
+            unsigned int *out = work.indices.data() + work.indexCount;
+            unsigned int count = overlapping(work.rowLights, bounds, out);
+            for (unsigned int k = 0; k < count; ++k)
+                out[k] = work.rowLights.light[out[k]];
+            unsigned int c = firstCluster + ty * tilesX + tx;
+            grid[2 * c] = work.indexCount;
+            grid[2 * c + 1] = count;
+            work.indexCount += count;
+        }
+    }
+}
+
+void LightClusters::bind(Shader &shader, unsigned int firstUnit, unsigned int screenWidth, unsigned int screenHeight)
+{
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+    glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+    shader.setInt("clusterGrid", firstUnit);
+    shader.setInt("clusterLightIndices", firstUnit + 1);
+    shader.setInt("clusterLightData", firstUnit + 2);
+    shader.setInt("numClusterLights", lightCount);
+    shader.setIVec3("clusterDims", tilesX, tilesY, slices);
+    shader.setVec2("clusterTileSize", (float)screenWidth / tilesX, (float)screenHeight / tilesY);
+    shader.setFloat("clusterNear", near);
+    shader.setFloat("clusterFar", far);
+}
+
+#endif
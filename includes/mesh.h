@@ -11,6 +11,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <iostream>
 
 #define MAX_BONE_INFLUENCE 4
@@ -40,9 +41,16 @@ public:
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
     void Draw(Shader &shader);
     void DrawInstanced(Shader &shader, int amount);
+    // position-only draw for depth prepasses and shadow maps, binds no textures
+    void DrawDepth();
+    // HAS_<TYPE>_MAP for every texture type the mesh has, the permutation of shaders that include
+    // common/material.glsl which samples only those
+    ShaderDefines variantDefines() const;
     unsigned int getVAO() const { return VAO; }
 private:
     unsigned int VAO, VBO, EBO;
+    // tightly packed positions sharing the EBO, 12 bytes per vertex instead of 56
+    unsigned int depthVAO, depthVBO;
     void setupMesh();
 };
 
@@ -81,6 +89,20 @@ void Mesh::setupMesh()
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent)); // B
 
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        positions[i] = vertices[i].Position;
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &depthVBO);
+
+    glBindVertexArray(depthVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0); // pos
+
     glBindVertexArray(0);
 }
 
@@ -154,6 +176,32 @@ void Mesh::Draw(Shader &shader)
     glBindVertexArray(0);
 }
 
+ShaderDefines Mesh::variantDefines() const
+{
+    static const std::map<std::string, std::string> defineNames = {
+        { "texture_diffuse", "HAS_DIFFUSE_MAP" },
+        { "texture_specular", "HAS_SPECULAR_MAP" },
+        { "texture_reflect", "HAS_REFLECT_MAP" },
+        { "texture_normal", "HAS_NORMAL_MAP" },
+        { "texture_height", "HAS_HEIGHT_MAP" },
+    };
+    ShaderDefines defines;
+    for (const Texture &texture : textures)
+    {
+        auto name = defineNames.find(texture.type);
+        if (name != defineNames.end())
+            defines[name->second] = "";
+    }
+    return defines;
+}
+
+void Mesh::DrawDepth()
+{
+    glBindVertexArray(depthVAO);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
 void Mesh::DrawInstanced(Shader &shader, int amount)
 {
     using namespace std;
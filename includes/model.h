@@ -14,23 +14,38 @@
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma);
 
 #include "shader.h"
+#include "cpu_profiler.h"
+#include "shader_variants.h"
 #include "mesh.h"
 
+#include <functional>
+#include <algorithm>
+
 class Model 
 {
 public:
     /*  函数   */
-    Model(const char *path)
+    Model(const char *path) : drawShaders(nullptr)
     {
         loadModel(path);
     }
     void Draw(Shader &shader);
+    // draws every mesh with the variant of shaders for its material (Mesh::variantDefines) plus
+    // defines. Meshes are grouped by variant, setup(shader) runs once per variant after use()
+    void Draw(ShaderVariants &shaders, const ShaderDefines &defines, const std::function<void(Shader &)> &setup);
     void DrawInstanced(Shader &shader, int amount);
+    void DrawDepth();
+    // the distinct material define sets of the meshes, to build their variants ahead of drawing
+    std::vector<ShaderDefines> variantDefines() const;
     std::vector<Mesh> meshes;
 private:
     /*  模型数据  */
     std::vector<Texture> textures_loaded;
     std::string directory;
+    // meshes sorted by their variant, for the shaders and defines last drawn with
+    const ShaderVariants *drawShaders;
+    std::string drawDefines;
+    std::vector<std::pair<Shader *, Mesh *>> drawOrder;
     /*  函数   */
     void loadModel(std::string path);
     void processNode(aiNode *node, const aiScene *scene);
@@ -41,6 +56,7 @@ private:
 
 void Model::loadModel(std::string path)
 {
+    CPU_PROFILE_SCOPE("Model::loadModel");
     Assimp::Importer import;
     // const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);    
     const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);    
@@ -72,6 +88,7 @@ void Model::processNode(aiNode *node, const aiScene *scene)
 
 Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
 {
+    CPU_PROFILE_SCOPE("Model::processMesh");
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures; 
@@ -188,18 +205,71 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
 
 void Model::Draw(Shader &shader)
 {
+    CPU_PROFILE_SCOPE("Model::Draw");
     for(unsigned int i = 0; i < meshes.size(); i++)
         meshes[i].Draw(shader);
 }
 
+void Model::Draw(ShaderVariants &shaders, const ShaderDefines &defines, const std::function<void(Shader &)> &setup)
+{
+    CPU_PROFILE_SCOPE("Model::Draw");
+    std::string key = ShaderPreprocessor::permutationKey(defines);
+    if (drawShaders != &shaders || drawDefines != key || drawOrder.size() != meshes.size())
+    {
+        drawOrder.clear();
+        for (Mesh &mesh : meshes)
+        {
+            ShaderDefines meshDefines = mesh.variantDefines();
+            meshDefines.insert(defines.begin(), defines.end());
+            drawOrder.push_back({ &shaders.get(meshDefines), &mesh });
+        }
+        std::stable_sort(drawOrder.begin(), drawOrder.end(), [](const std::pair<Shader *, Mesh *> &a, const std::pair<Shader *, Mesh *> &b) {
+            return a.first < b.first;
+        });
+        drawShaders = &shaders;
+        drawDefines = key;
+    }
+    Shader *current = nullptr;
+    for (auto &draw : drawOrder)
+    {
+        if (draw.first != current)
+        {
+            current = draw.first;
+            current->use();
+            setup(*current);
+        }
+        draw.second->Draw(*current);
+    }
+}
+
+std::vector<ShaderDefines> Model::variantDefines() const
+{
+    std::vector<ShaderDefines> sets;
+    for (const Mesh &mesh : meshes)
+    {
+        ShaderDefines defines = mesh.variantDefines();
+        if (std::find(sets.begin(), sets.end(), defines) == sets.end())
+            sets.push_back(defines);
+    }
+    return sets;
+}
+
 void Model::DrawInstanced(Shader &shader, int amount)
 {
     for(unsigned int i = 0; i < meshes.size(); i++)
         meshes[i].DrawInstanced(shader, amount);
 }
 
+void Model::DrawDepth()
+{
+    CPU_PROFILE_SCOPE("Model::DrawDepth");
+    for(unsigned int i = 0; i < meshes.size(); i++)
+        meshes[i].DrawDepth();
+}
+
 unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
 {
+    CPU_PROFILE_SCOPE("TextureFromFile");
     stbi_set_flip_vertically_on_load(false);
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
@@ -208,7 +278,11 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data;
+    {
+        CPU_PROFILE_SCOPE("stbi_load");
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    }
     if (data)
     {
         GLenum format;
@@ -0,0 +1,236 @@
+#ifndef MOMENT_SHADOW_H
+#define MOMENT_SHADOW_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <iostream>
+
+// Filterable shadow maps that store depth moments instead of raw depth (VSM uses
+// rg = (d, d^2), EVSM uses all four channels for the warped positive/negative moments).
+// After the scene is rendered into them, blur() runs a separable gaussian and rebuilds
+// the mip chain, so the lighting shader can resolve the shadow with one trilinear fetch.
+class MomentShadowMap
+{
+public:
+    unsigned int FBO;
+    unsigned int moments;
+    unsigned int width, height;
+    MomentShadowMap(unsigned int width, unsigned int height);
+    ~MomentShadowMap();
+    // binds the moment framebuffer and sets the viewport to the map size
+    void bind();
+    // blurShader: post_processing/screen_vert.glsl + shadow_mapping/moments_blur_frag.glsl.
+    // Depth test and blending are restored to what the caller had; the framebuffer is left at
+    // 0 and the viewport at the map size, as after bind()
+    void blur(Shader &blurShader, unsigned int quadVAO, int radius);
+private:
+    unsigned int depthRBO;
+    unsigned int pingFBO, pingTexture;
+};
+
+// Same as MomentShadowMap for omnidirectional lights. All six faces are rendered and
+// blurred in a single layered pass; the blur walks along the face tangents so it does
+// not leak across faces.
+class MomentShadowCubeMap
+{
+public:
+    unsigned int FBO;
+    unsigned int moments;
+    unsigned int size;
+    MomentShadowCubeMap(unsigned int size);
+    ~MomentShadowCubeMap();
+    void bind();
+    // cubeBlurShader: shadow_mapping/moments_blur_cube_{vert,geo,frag}.glsl, state as MomentShadowMap::blur
+    void blur(Shader &cubeBlurShader, unsigned int quadVAO, int radius);
+private:
+    unsigned int depthCubeMap;
+    unsigned int pingFBO, pingTexture;
+};
+
+MomentShadowMap::MomentShadowMap(unsigned int width, unsigned int height) : width(width), height(height)
+{
+    glGenTextures(1, &moments);
+    glBindTexture(GL_TEXTURE_2D, moments);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glGenTextures(1, &pingTexture);
+    glBindTexture(GL_TEXTURE_2D, pingTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, moments, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: Moment shadow framebuffer is not complete!" << std::endl;
+
+    glGenFramebuffers(1, &pingFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pingFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: Moment blur framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+MomentShadowMap::~MomentShadowMap()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteFramebuffers(1, &pingFBO);
+    glDeleteRenderbuffers(1, &depthRBO);
+    glDeleteTextures(1, &moments);
+    glDeleteTextures(1, &pingTexture);
+}
+
+void MomentShadowMap::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+void MomentShadowMap::blur(Shader &blurShader, unsigned int quadVAO, int radius)
+{
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glViewport(0, 0, width, height);
+    blurShader.use();
+    blurShader.setInt("moments", 0);
+    blurShader.setInt("radius", radius);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
+    if (radius > 0)
+    {
+        // horizontal: moments -> ping
+        glBindFramebuffer(GL_FRAMEBUFFER, pingFBO);
+        blurShader.setVec2("direction", 1.0f / width, 0.0f);
+        glBindTexture(GL_TEXTURE_2D, moments);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // vertical: ping -> moments
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        blurShader.setVec2("direction", 0.0f, 1.0f / height);
+        glBindTexture(GL_TEXTURE_2D, pingTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glBindTexture(GL_TEXTURE_2D, moments);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (blend)
+        glEnable(GL_BLEND);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+MomentShadowCubeMap::MomentShadowCubeMap(unsigned int size) : size(size)
+{
+    glGenTextures(1, &moments);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, moments);
+    for (unsigned int i = 0; i < 6; ++i)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    glGenTextures(1, &pingTexture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, pingTexture);
+    for (unsigned int i = 0; i < 6; ++i)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // layered rendering needs a layered depth attachment as well
+    glGenTextures(1, &depthCubeMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+    for (unsigned int i = 0; i < 6; ++i)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, moments, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubeMap, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: Moment shadow cube framebuffer is not complete!" << std::endl;
+
+    glGenFramebuffers(1, &pingFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pingFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, pingTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::FRAMEBUFFER:: Moment cube blur framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+MomentShadowCubeMap::~MomentShadowCubeMap()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteFramebuffers(1, &pingFBO);
+    glDeleteTextures(1, &moments);
+    glDeleteTextures(1, &pingTexture);
+    glDeleteTextures(1, &depthCubeMap);
+}
+
+void MomentShadowCubeMap::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, size, size);
+}
+
+void MomentShadowCubeMap::blur(Shader &cubeBlurShader, unsigned int quadVAO, int radius)
+{
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glViewport(0, 0, size, size);
+    cubeBlurShader.use();
+    cubeBlurShader.setInt("moments", 0);
+    cubeBlurShader.setInt("radius", radius);
+    cubeBlurShader.setFloat("texelSize", 2.0f / size);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
+    if (radius > 0)
+    {
+        // along the face s axis: moments -> ping
+        glBindFramebuffer(GL_FRAMEBUFFER, pingFBO);
+        cubeBlurShader.setInt("axis", 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, moments);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // along the face t axis: ping -> moments
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        cubeBlurShader.setInt("axis", 1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, pingTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, moments);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (blend)
+        glEnable(GL_BLEND);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+#endif // MOMENT_SHADOW_H
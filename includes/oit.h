@@ -0,0 +1,108 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013). Transparent surfaces
+// are drawn in any order into two targets and resolved by a full screen composite:
+//   accumTexture   rgba16f  rgb: sum of C * a * w, a: revealage, the product of (1 - a)
+//   weightTexture  r16f     sum of a * w
+// GL 3.3 has one blend function for all draw buffers (glBlendFunci is 4.0), so revealage lives in
+// the alpha of the accumulation target instead of a third buffer: with
+// glBlendFuncSeparate(ONE, ONE, ZERO, ONE_MINUS_SRC_ALPHA) the rgb channels of both targets add up
+// and the alpha channel multiplies. The opaque pass's depth buffer is attached so transparent
+// fragments are still occluded by opaque geometry, but never write depth themselves.
+//
+//   oit.begin();      // draw transparent geometry with shaders/oit/wboit_frag.glsl
+//   oit.end();
+//   // bind the opaque target, then draw a full screen quad with shaders/oit/wboit_composite_frag.glsl
+//   oit.bindTextures(0);
+class WeightedBlendedOIT
+{
+public:
+    unsigned int FBO;
+    unsigned int accumTexture, weightTexture;
+    unsigned int width, height;
+    // depthRenderbuffer: depth(-stencil) renderbuffer of the opaque pass, same size
+    WeightedBlendedOIT(unsigned int width, unsigned int height, unsigned int depthRenderbuffer);
+    ~WeightedBlendedOIT();
+    // binds and clears the targets and sets up depth and blend state for the transparent pass
+    void begin();
+    // restores depth writes and the default blend function
+    void end();
+    // binds accumTexture and weightTexture to firstUnit and firstUnit + 1
+    void bindTextures(unsigned int firstUnit);
+};
+
+WeightedBlendedOIT::WeightedBlendedOIT(unsigned int width, unsigned int height, unsigned int depthRenderbuffer)
+    : width(width), height(height)
+{
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenTextures(1, &accumTexture);
+    glBindTexture(GL_TEXTURE_2D, accumTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+
+    glGenTextures(1, &weightTexture);
+    glBindTexture(GL_TEXTURE_2D, weightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture, 0);
+
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "ERROR::OIT:: Framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+WeightedBlendedOIT::~WeightedBlendedOIT()
+{
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &accumTexture);
+    glDeleteTextures(1, &weightTexture);
+}
+
+void WeightedBlendedOIT::begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    // revealage starts at 1 (nothing covers the pixel), the sums at 0
+    const float accumClear[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const float weightClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, accumClear);
+    glClearBufferfv(GL_COLOR, 1, weightClear);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedBlendedOIT::end()
+{
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedBlendedOIT::bindTextures(unsigned int firstUnit)
+{
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_2D, accumTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_2D, weightTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+#endif
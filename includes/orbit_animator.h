@@ -0,0 +1,127 @@
+#ifndef ORBIT_ANIMATOR_H
+#define ORBIT_ANIMATOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gpu_timer.h"
+#include "instance_builder.h"
+
+#include <vector>
+#include <cmath>
+
+// GPU counterpart of AsteroidField::buildParallel. The orbit parameters are uploaded once into a
+// static buffer; every frame animate() runs shaders/instancing/orbit_animate_vert.glsl over them as
+// points with rasterization disabled and captures InstanceTransforms with transform feedback into
+// instanceBuffer. The buffer never leaves the GPU: bind() points the instance attributes of a mesh
+// VAO at it, so Mesh::DrawInstanced reads the animated rocks with no CPU work or upload.
+// Transform feedback is core in GL 3.3, which is what every main in this repo creates.
+class OrbitAnimator
+{
+public:
+    unsigned int instanceBuffer;
+    unsigned int capacity;
+    // rocks written by the last animate()
+    unsigned int count;
+    GpuTimer timer;
+    // program: Shader(orbit_animate_vert.glsl, { "positionScale", "rotation" })
+    OrbitAnimator(Shader &program, const AsteroidField &field);
+    ~OrbitAnimator();
+    // re-uploads the orbit parameters, e.g. after the field was regenerated
+    void upload(const AsteroidField &field);
+    void animate(unsigned int count, float time, float orbitSpeed, float spinSpeed);
+    void bind(unsigned int VAO);
+private:
+    Shader &program;
+    unsigned int paramVAO, paramBuffer;
+    glm::vec3 spinAxis;
+};
+
+OrbitAnimator::OrbitAnimator(Shader &program, const AsteroidField &field)
+    : capacity(0), count(0), program(program)
+{
+    glGenVertexArrays(1, &paramVAO);
+    glGenBuffers(1, &paramBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    glBindVertexArray(paramVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, paramBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(4 * sizeof(float)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    upload(field);
+}
+
+OrbitAnimator::~OrbitAnimator()
+{
+    glDeleteVertexArrays(1, &paramVAO);
+    glDeleteBuffers(1, &paramBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+}
+
+void OrbitAnimator::upload(const AsteroidField &field)
+{
+    capacity = static_cast<unsigned int>(field.size());
+    spinAxis = field.params.spinAxis;
+    // interleave the structure of arrays into one vertex per rock
+    std::vector<float> params(6 * capacity);
+    for (unsigned int i = 0; i < capacity; ++i)
+    {
+        float *p = &params[6 * i];
+        p[0] = field.orbitAngle[i];
+        p[1] = field.orbitRadius[i];
+        p[2] = field.orbitRate[i];
+        p[3] = field.orbitHeight[i];
+        p[4] = field.scale[i];
+        p[5] = field.spinAngle[i];
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, paramBuffer);
+    glBufferData(GL_ARRAY_BUFFER, params.size() * sizeof(float), params.data(), GL_STATIC_DRAW);
+    // written and read only by the GPU
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceTransform), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OrbitAnimator::animate(unsigned int count, float time, float orbitSpeed, float spinSpeed)
+{
+    this->count = count < capacity ? count : capacity;
+    if (this->count == 0)
+        return;
+    const float FOUR_PI = 12.5663706144f;
+    timer.begin();
+    program.use();
+    program.setFloat("orbitTime", time * orbitSpeed);
+    program.setFloat("spinTime", std::fmod(time * spinSpeed, FOUR_PI));
+    program.setVec3("spinAxis", spinAxis.x, spinAxis.y, spinAxis.z);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, instanceBuffer);
+    glBindVertexArray(paramVAO);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, this->count);
+    glEndTransformFeedback();
+    glBindVertexArray(0);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    timer.end();
+}
+
+void OrbitAnimator::bind(unsigned int VAO)
+{
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)offsetof(InstanceTransform, positionScale));
+    glVertexAttribDivisor(3, 1);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)offsetof(InstanceTransform, rotation));
+    glVertexAttribDivisor(4, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+#endif
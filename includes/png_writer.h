@@ -0,0 +1,134 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <algorithm>
+
+// Writes 8 bit RGB/RGBA images as PNG, for frame captures of the headless benchmark. The image
+// data goes into uncompressed deflate blocks: larger files than a real encoder writes, but no
+// zlib to link and no time spent compressing between frames.
+//
+//   PngWriter::captureFramebuffer(path, width, height);   // what framebuffer 0 shows
+class PngWriter
+{
+public:
+    // rows bottom to top when flipVertically, as glReadPixels returns them
+    static bool write(const std::string &path, int width, int height, int channels, const unsigned char *pixels, bool flipVertically = false);
+    // reads back the bound read framebuffer's color
+    static bool captureFramebuffer(const std::string &path, int width, int height);
+private:
+    static uint32_t crc(const unsigned char *data, size_t size, uint32_t crc = 0xFFFFFFFFu);
+    static void putU32(std::vector<unsigned char> &out, uint32_t value);
+    static void writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data);
+};
+
+uint32_t PngWriter::crc(const unsigned char *data, size_t size, uint32_t crc)
+{
+    static uint32_t table[256] = {};
+    if (table[1] == 0)
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+void PngWriter::putU32(std::vector<unsigned char> &out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16 & 0xFF);
+    out.push_back(value >> 8 & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+void PngWriter::writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> chunk;
+    putU32(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    // over the type and the data, not the length
+    putU32(chunk, crc(chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFu);
+    file.write((const char *)chunk.data(), chunk.size());
+}
+
+bool PngWriter::write(const std::string &path, int width, int height, int channels, const unsigned char *pixels, bool flipVertically)
+{
+    if (channels != 3 && channels != 4)
+    {
+        std::cerr << "ERROR::PNG:: " << channels << " channels, only RGB and RGBA are written" << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "ERROR::PNG:: Could not write " << path << std::endl;
+        return false;
+    }
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write((const char *)signature, sizeof(signature));
+
+    std::vector<unsigned char> header;
+    putU32(header, width);
+    putU32(header, height);
+    // bit depth 8, color type 2 (RGB) or 6 (RGBA), deflate, no filter, no interlace
+    header.insert(header.end(), { 8, (unsigned char)(channels == 4 ? 6 : 2), 0, 0, 0 });
+    writeChunk(file, "IHDR", header);
+
+    // every row starts with its filter type, 0 (none)
+    size_t rowSize = (size_t)width * channels;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *row = pixels + rowSize * (flipVertically ? height - 1 - y : y);
+        raw.push_back(0);
+        raw.insert(raw.end(), row, row + rowSize);
+    }
+    // zlib stream of stored deflate blocks, at most 65535 bytes each
+    std::vector<unsigned char> data = { 0x78, 0x01 };
+    data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t offset = 0;
+    do
+    {
+        uint16_t size = (uint16_t)std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + size == raw.size();
+        data.insert(data.end(), { (unsigned char)last, (unsigned char)(size & 0xFF), (unsigned char)(size >> 8),
+                                  (unsigned char)(~size & 0xFF), (unsigned char)(~size >> 8 & 0xFF) });
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putU32(data, b << 16 | a);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", {});
+    return (bool)file;
+}
+
+bool PngWriter::captureFramebuffer(const std::string &path, int width, int height)
+{
+    std::vector<unsigned char> pixels((size_t)width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return write(path, width, height, 3, pixels.data(), true);
+}
+#endif
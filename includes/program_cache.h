@@ -0,0 +1,198 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+
+// On-disk cache of linked program binaries (GL 4.1 / ARB_get_program_binary), so a warm start
+// skips compiling and linking. Every Shader constructed while a cache is current() looks its
+// program up first. A program's key hashes the driver's vendor, renderer and version strings
+// with the preprocessed sources (defines included, they are part of the source), so an edited
+// shader or an updated driver simply misses. Binaries the driver still rejects are deleted and
+// recompiled. The files are <directory>/<key>.bin, the directory has to exist.
+//
+//   ProgramCache cache(CMAKE_BINARY_DIR"/shader_cache");
+//   ProgramCache::current() = &cache;
+//   Shader shader(...);               // linked from the binary if there is one
+class ProgramCache
+{
+public:
+    // programs linked from a binary, compiled from source, binaries the driver refused
+    unsigned int hits, misses, rejected;
+    // false without driver support (or binary formats), every lookup then misses
+    bool enabled;
+    ProgramCache(const std::string &directory);
+    // key of a program built from parts (its sources and anything else that changes the binary)
+    uint64_t key(const std::vector<std::string> &parts) const;
+    // links program from the cached binary, false if there is none or it was rejected
+    bool load(unsigned int program, uint64_t key);
+    // to be called before linking a program that will be stored
+    void prepare(unsigned int program);
+    // writes the binary of a linked program, programs that failed to link are skipped
+    void store(unsigned int program, uint64_t key);
+    static bool supported();
+    // cache used by Shader, nullptr compiles every program from source
+    static ProgramCache *&current();
+private:
+    std::string directory;
+    uint64_t driverHash;
+    std::string path(uint64_t key) const;
+    static uint64_t hash(const std::string &data, uint64_t seed);
+};
+
+// file layout: magic, binary format, key (guards against truncated or misnamed files), binary
+struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+};
+const uint32_t PROGRAM_CACHE_MAGIC = 0x42504C47; // "GLPB"
+
+ProgramCache *&ProgramCache::current()
+{
+    static ProgramCache *cache = nullptr;
+    return cache;
+}
+
+bool ProgramCache::supported()
+{
+    bool supported = false;
+#ifdef GL_VERSION_4_1
+    supported = supported || GLAD_GL_VERSION_4_1;
+#endif
+#ifdef GL_ARB_get_program_binary
+    supported = supported || GLAD_GL_ARB_get_program_binary;
+#endif
+    return supported;
+}
+
+ProgramCache::ProgramCache(const std::string &directory)
+    : hits(0), misses(0), rejected(0), enabled(false), directory(directory), driverHash(0)
+{
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    if (supported())
+    {
+        // some drivers expose the entry points but no format to save in
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        enabled = formats > 0;
+    }
+#endif
+    std::string driver;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const GLubyte *value = glGetString(name);
+        driver += value != nullptr ? (const char *)value : "";
+        driver += '\n';
+    }
+    driverHash = hash(driver, 14695981039346656037ull);
+}
+
+// 64-bit FNV-1a
+uint64_t ProgramCache::hash(const std::string &data, uint64_t seed)
+{
+    uint64_t h = seed;
+    for (unsigned char c : data)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t ProgramCache::key(const std::vector<std::string> &parts) const
+{
+    uint64_t h = driverHash;
+    for (const std::string &part : parts)
+    {
+        h = hash(part, h);
+        // separator, so moving text from one part to the next changes the key
+        h = hash(std::string(1, '\0'), h);
+    }
+    return h;
+}
+
+std::string ProgramCache::path(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return directory + name;
+}
+
+bool ProgramCache::load(unsigned int program, uint64_t key)
+{
+    if (!enabled)
+    {
+        ++misses;
+        return false;
+    }
+    std::ifstream file(path(key), std::ios::binary);
+    ProgramCacheHeader header;
+    if (!file || !file.read((char *)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC || header.key != key)
+    {
+        ++misses;
+        return false;
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    int linked = 0;
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+#endif
+    if (!linked)
+    {
+        // e.g. a driver update that kept its version string: drop the file, the caller recompiles
+        std::remove(path(key).c_str());
+        ++rejected;
+        ++misses;
+        return false;
+    }
+    ++hits;
+    return true;
+}
+
+void ProgramCache::prepare(unsigned int program)
+{
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    if (enabled)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+}
+
+void ProgramCache::store(unsigned int program, uint64_t key)
+{
+    if (!enabled)
+        return;
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+    int linked = 0, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!linked || length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    ProgramCacheHeader header = { PROGRAM_CACHE_MAGIC, format, key };
+    // write next to the final name and rename, a crash never leaves a half written binary behind
+    std::string target = path(key), temporary = target + ".tmp";
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file.write((const char *)&header, sizeof(header)) || !file.write(binary.data(), length))
+    {
+        std::cerr << "ERROR::PROGRAM_CACHE:: Could not write " << temporary << std::endl;
+        return;
+    }
+    file.close();
+    std::remove(target.c_str());
+    if (std::rename(temporary.c_str(), target.c_str()) != 0)
+        std::cerr << "ERROR::PROGRAM_CACHE:: Could not rename " << temporary << std::endl;
+#endif
+}
+#endif
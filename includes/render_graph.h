@@ -0,0 +1,538 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "render_target_pool.h"
+#include "gpu_profiler.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <functional>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// Texture created and owned by the graph, sized relative to the graph's width and height.
+struct RenderGraphTextureDesc {
+    GLenum internalFormat;
+    float scale;
+    GLenum filter;
+    RenderGraphTextureDesc(GLenum internalFormat = GL_RGBA16F, float scale = 1.0f, GLenum filter = GL_LINEAR)
+        : internalFormat(internalFormat), scale(scale), filter(filter) {}
+};
+
+// Full screen post-processing passes scheduled as a graph. Every pass declares the textures it
+// reads and the one it writes; compile() then
+//   1. fuses chains of pointwise passes (each pixel only depends on the same pixel of the
+//      previous pass) into the pass that produces their input, generating one shader for the
+//      chain, so the intermediate textures are neither allocated nor written and read back;
+//   2. gives every remaining transient texture a lifetime (first write, last read) and assigns
+//      physical textures, so textures whose lifetimes do not overlap share memory. The physical
+//      textures come from a RenderTargetPool and are held until the next compile().
+//
+// A pass is a GLSL stage file (shaders/post_processing/stages/) that defines either
+//   vec4 <function>(vec2 uv)               sampling pass, reads its inputs itself
+//   vec4 <function>(vec4 color, vec2 uv)   pointwise pass, color is its input at this pixel
+// and declares its own uniforms and samplers. Stages fused into one shader share a namespace,
+// so their uniform names must not collide. For every sampler X the graph also sets
+// `uniform vec2 XTexelSize` if the stage declares it.
+//
+//   graph.reset();
+//   RenderGraph::Resource scene = graph.createTexture("scene", RenderGraphTextureDesc(GL_RGBA16F));
+//   graph.addResolvePass("resolve", msaaFBO, scene);
+//   graph.addPointwisePass("tonemap", path, "tonemap", scene, {}, RenderGraph::BACKBUFFER, setExposure);
+//   graph.compile();
+//   ... every frame: graph.execute();
+class RenderGraph
+{
+public:
+    typedef int Resource;
+    typedef std::vector<std::pair<std::string, Resource>> Inputs;
+    // the default framebuffer, only valid as an output
+    static const Resource BACKBUFFER = 0;
+    struct Stats {
+        unsigned int declaredPasses, executedPasses;
+        unsigned int declaredTextures, physicalTextures;
+        size_t declaredBytes, physicalBytes;
+    };
+    Stats stats;
+    unsigned int width, height;
+    // screenVertexPath: shaders/post_processing/screen_vert.glsl, shared by every generated program.
+    // targets must outlive the graph.
+    RenderGraph(RenderTargetPool &targets, unsigned int width, unsigned int height, const char *screenVertexPath);
+    ~RenderGraph();
+    // forgets the passes and resources; held textures and generated programs are kept for reuse
+    void reset();
+    // new output size, forgets the passes like reset(): declare them again and compile()
+    void resize(unsigned int width, unsigned int height);
+    // texture owned outside the graph. Passes can only write it if framebuffer (with the texture
+    // attached) is given, e.g. a history target kept across frames.
+    Resource importTexture(const std::string &name, unsigned int texture, unsigned int width, unsigned int height,
+                           unsigned int framebuffer = 0);
+    // points an imported resource at another texture of the same size without recompiling (ping-pong targets)
+    void rebindImport(Resource resource, unsigned int texture, unsigned int framebuffer = 0);
+    Resource createTexture(const std::string &name, const RenderGraphTextureDesc &desc);
+    // blits (and resolves, if multisampled) the color of framebuffer into output, which has the framebuffer's size
+    void addResolvePass(const std::string &name, unsigned int framebuffer, Resource output);
+    void addPass(const std::string &name, const std::string &stagePath, const std::string &function,
+                 const Inputs &inputs, Resource output, std::function<void(Shader &)> setUniforms = nullptr);
+    void addPointwisePass(const std::string &name, const std::string &stagePath, const std::string &function, Resource color,
+                          const Inputs &inputs, Resource output, std::function<void(Shader &)> setUniforms = nullptr);
+    // fuse: merge pointwise chains, off to compare against one pass per declared pass
+    void compile(bool fuse = true);
+    // with a profiler every program runs in a scope named after its passes
+    void execute(GpuProfiler *profiler = nullptr);
+    // names of the declared passes executed by each program, in execution order, e.g. "bloom + tonemap"
+    std::vector<std::string> schedule() const;
+    // texture holding a resource after compile(), 0 for the backbuffer and for fused intermediates.
+    // Textures are shared by resources with disjoint lifetimes, read it before a later pass reuses it.
+    unsigned int texture(Resource resource) const;
+private:
+    struct Pass {
+        std::string name, stagePath, function;
+        bool pointwise, resolve;
+        Resource color;
+        Inputs inputs;
+        Resource output;
+        unsigned int sourceFramebuffer;
+        std::function<void(Shader &)> setUniforms;
+    };
+    struct ResourceInfo {
+        std::string name;
+        bool imported;
+        unsigned int texture, width, height;
+        unsigned int framebuffer;
+        RenderGraphTextureDesc desc;
+        int physical;
+        int lastRead;
+        unsigned int readers;
+    };
+    // a pool target held by the graph, inUse while a resource assigned to it is alive during compile()
+    struct Physical {
+        int target;
+        GLenum filter;
+        bool inUse;
+    };
+    struct Group {
+        std::vector<int> passes;
+        Inputs samplers;
+        Resource output;
+        Shader *program;
+    };
+    std::vector<Pass> passes;
+    std::vector<ResourceInfo> resources;
+    RenderTargetPool &targets;
+    std::vector<Physical> physicals;
+    std::vector<Group> groups;
+    std::map<std::string, std::unique_ptr<Shader>> programs;
+    std::string vertexCode;
+    unsigned int quadVAO, quadVBO;
+    int acquire(const ResourceInfo &resource);
+    std::string generateFragment(const Group &group) const;
+    void releaseTargets();
+};
+
+RenderGraph::RenderGraph(RenderTargetPool &targets, unsigned int width, unsigned int height, const char *screenVertexPath)
+    : width(width), height(height), targets(targets)
+{
+    stats = Stats();
+    try
+    {
+        std::set<std::string> included;
+        vertexCode = ShaderPreprocessor::readSource(screenVertexPath, included);
+    }
+    catch (std::ifstream::failure &e)
+    {
+        std::cerr << "ERROR::RENDER_GRAPH:: cannot read " << screenVertexPath << std::endl;
+    }
+    float quadVertices[] = {
+        // positions   // texCoords
+        -1.0f,  1.0f,  0.0f, 1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glBindVertexArray(0);
+    reset();
+}
+
+RenderGraph::~RenderGraph()
+{
+    releaseTargets();
+    glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+}
+
+void RenderGraph::reset()
+{
+    passes.clear();
+    groups.clear();
+    resources.clear();
+    ResourceInfo backbuffer = {};
+    backbuffer.name = "backbuffer";
+    backbuffer.imported = true;
+    backbuffer.width = width;
+    backbuffer.height = height;
+    backbuffer.physical = -1;
+    resources.push_back(backbuffer);
+}
+
+void RenderGraph::resize(unsigned int width, unsigned int height)
+{
+    this->width = width;
+    this->height = height;
+    reset();
+}
+
+void RenderGraph::releaseTargets()
+{
+    for (const Physical &physical : physicals)
+        targets.release(physical.target);
+    physicals.clear();
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const std::string &name, unsigned int texture, unsigned int width, unsigned int height,
+                                                unsigned int framebuffer)
+{
+    ResourceInfo resource = {};
+    resource.name = name;
+    resource.imported = true;
+    resource.texture = texture;
+    resource.framebuffer = framebuffer;
+    resource.width = width;
+    resource.height = height;
+    resource.physical = -1;
+    resources.push_back(resource);
+    return (Resource)resources.size() - 1;
+}
+
+void RenderGraph::rebindImport(Resource resource, unsigned int texture, unsigned int framebuffer)
+{
+    if (resource == BACKBUFFER || !resources[resource].imported)
+    {
+        std::cerr << "ERROR::RENDER_GRAPH:: " << resources[resource].name << " is not an imported texture" << std::endl;
+        return;
+    }
+    resources[resource].texture = texture;
+    resources[resource].framebuffer = framebuffer;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const std::string &name, const RenderGraphTextureDesc &desc)
+{
+    ResourceInfo resource = {};
+    resource.name = name;
+    resource.imported = false;
+    resource.desc = desc;
+    resource.width = std::max(1u, (unsigned int)std::lround(width * desc.scale));
+    resource.height = std::max(1u, (unsigned int)std::lround(height * desc.scale));
+    resource.physical = -1;
+    resources.push_back(resource);
+    return (Resource)resources.size() - 1;
+}
+
+void RenderGraph::addResolvePass(const std::string &name, unsigned int framebuffer, Resource output)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.resolve = true;
+    pass.color = -1;
+    pass.output = output;
+    pass.sourceFramebuffer = framebuffer;
+    passes.push_back(pass);
+}
+
+void RenderGraph::addPass(const std::string &name, const std::string &stagePath, const std::string &function,
+                          const Inputs &inputs, Resource output, std::function<void(Shader &)> setUniforms)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.stagePath = stagePath;
+    pass.function = function;
+    pass.color = -1;
+    pass.inputs = inputs;
+    pass.output = output;
+    pass.setUniforms = setUniforms;
+    passes.push_back(pass);
+}
+
+void RenderGraph::addPointwisePass(const std::string &name, const std::string &stagePath, const std::string &function, Resource color,
+                                   const Inputs &inputs, Resource output, std::function<void(Shader &)> setUniforms)
+{
+    addPass(name, stagePath, function, inputs, output, setUniforms);
+    passes.back().pointwise = true;
+    passes.back().color = color;
+}
+
+void RenderGraph::compile(bool fuse)
+{
+    groups.clear();
+    // back to the pool, acquire() below gets the same textures again unless the sizes changed
+    releaseTargets();
+    for (ResourceInfo &resource : resources)
+    {
+        resource.physical = -1;
+        resource.lastRead = -1;
+        resource.readers = 0;
+    }
+
+    // validate the declaration order and count the readers of every resource
+    std::vector<bool> written(resources.size(), false);
+    for (size_t r = 1; r < resources.size(); ++r)
+        written[r] = resources[r].imported;
+    for (const Pass &pass : passes)
+    {
+        std::vector<Resource> reads;
+        if (pass.color >= 0)
+            reads.push_back(pass.color);
+        for (const auto &input : pass.inputs)
+            reads.push_back(input.second);
+        for (Resource r : reads)
+        {
+            if (r == BACKBUFFER || !written[r])
+                std::cerr << "ERROR::RENDER_GRAPH:: pass " << pass.name << " reads " << resources[r].name << " before it is written" << std::endl;
+            resources[r].readers++;
+        }
+        if (pass.output != BACKBUFFER && resources[pass.output].imported && !resources[pass.output].framebuffer)
+            std::cerr << "ERROR::RENDER_GRAPH:: pass " << pass.name << " writes " << resources[pass.output].name << ", imported without a framebuffer" << std::endl;
+        written[pass.output] = true;
+    }
+
+    // 1. fusion: a pointwise pass joins the group producing its input if nobody else reads that
+    //    input and both have the same resolution (sampling it at the same uv is then exact)
+    for (int p = 0; p < (int)passes.size(); ++p)
+    {
+        const Pass &pass = passes[p];
+        if (fuse && pass.pointwise && !groups.empty())
+        {
+            Group &last = groups.back();
+            const Pass &tail = passes[last.passes.back()];
+            const ResourceInfo &color = resources[pass.color];
+            const ResourceInfo &output = resources[pass.output];
+            bool sameStage = false;
+            for (int q : last.passes)
+                sameStage = sameStage || passes[q].stagePath == pass.stagePath;
+            if (!tail.resolve && last.output == pass.color && !color.imported && color.readers == 1 &&
+                color.width == output.width && color.height == output.height && !sameStage)
+            {
+                last.passes.push_back(p);
+                last.samplers.insert(last.samplers.end(), pass.inputs.begin(), pass.inputs.end());
+                last.output = pass.output;
+                continue;
+            }
+        }
+        Group group;
+        group.passes.push_back(p);
+        if (pass.pointwise)
+            group.samplers.push_back({ "graphInput", pass.color });
+        group.samplers.insert(group.samplers.end(), pass.inputs.begin(), pass.inputs.end());
+        if (pass.resolve)
+            group.samplers.clear();
+        group.output = pass.output;
+        group.program = nullptr;
+        groups.push_back(group);
+    }
+
+    // 2. lifetimes over the executed groups, then pooled textures assigned in execution order:
+    //    an output is acquired before the group's inputs are released, so it never aliases them
+    for (int g = 0; g < (int)groups.size(); ++g)
+        for (const auto &sampler : groups[g].samplers)
+            resources[sampler.second].lastRead = g;
+    for (int g = 0; g < (int)groups.size(); ++g)
+    {
+        Group &group = groups[g];
+        ResourceInfo &output = resources[group.output];
+        if (!output.imported)
+        {
+            output.physical = acquire(output);
+            output.texture = targets.texture(physicals[output.physical].target);
+            // written but never read: free right away
+            if (output.lastRead < g)
+                physicals[output.physical].inUse = false;
+        }
+        for (const auto &sampler : group.samplers)
+        {
+            const ResourceInfo &input = resources[sampler.second];
+            if (!input.imported && input.lastRead == g && input.physical >= 0)
+                physicals[input.physical].inUse = false;
+        }
+        if (!passes[group.passes[0]].resolve)
+        {
+            std::string fragmentCode = generateFragment(group);
+            std::unique_ptr<Shader> &program = programs[fragmentCode];
+            if (!program)
+                program.reset(new Shader(vertexCode, fragmentCode));
+            group.program = program.get();
+        }
+    }
+
+    stats = Stats();
+    stats.declaredPasses = (unsigned int)passes.size();
+    stats.executedPasses = (unsigned int)groups.size();
+    std::set<int> physical;
+    for (const ResourceInfo &resource : resources)
+    {
+        if (resource.imported)
+            continue;
+        stats.declaredTextures++;
+        stats.declaredBytes += (size_t)resource.width * resource.height * RenderTargetPool::bytesPerPixel(resource.desc.internalFormat);
+        if (resource.physical >= 0 && physical.insert(resource.physical).second)
+        {
+            const RenderTargetDesc &desc = targets.desc(physicals[resource.physical].target);
+            stats.physicalTextures++;
+            stats.physicalBytes += (size_t)desc.width * desc.height * RenderTargetPool::bytesPerPixel(desc.internalFormat);
+        }
+    }
+}
+
+int RenderGraph::acquire(const ResourceInfo &resource)
+{
+    RenderTargetDesc desc(resource.desc.internalFormat, resource.width, resource.height);
+    for (size_t i = 0; i < physicals.size(); ++i)
+    {
+        Physical &physical = physicals[i];
+        if (!physical.inUse && physical.filter == resource.desc.filter && targets.desc(physical.target) == desc)
+        {
+            physical.inUse = true;
+            return (int)i;
+        }
+    }
+    Physical physical;
+    physical.target = targets.acquire(desc, resource.desc.filter);
+    physical.filter = resource.desc.filter;
+    physical.inUse = true;
+    physicals.push_back(physical);
+    return (int)physicals.size() - 1;
+}
+
+std::string RenderGraph::generateFragment(const Group &group) const
+{
+    std::stringstream code;
+    code << "#version 330 core\n"
+         << "out vec4 FragColor;\n"
+         << "in vec2 TexCoords;\n";
+    if (passes[group.passes[0]].pointwise)
+        code << "uniform sampler2D graphInput;\n";
+    // stages share the include set, a header included by two of them is pasted once
+    std::set<std::string> included;
+    for (size_t i = 0; i < group.passes.size(); ++i)
+    {
+        code << "#line 1 " << i + 1 << "\n";
+        try
+        {
+            code << ShaderPreprocessor::readSource(passes[group.passes[i]].stagePath, included);
+        }
+        catch (std::ifstream::failure &e)
+        {
+            std::cerr << "ERROR::RENDER_GRAPH:: cannot read " << passes[group.passes[i]].stagePath << std::endl;
+        }
+    }
+    code << "#line 1 0\n"
+         << "void main()\n{\n";
+    for (size_t i = 0; i < group.passes.size(); ++i)
+    {
+        const Pass &pass = passes[group.passes[i]];
+        if (i > 0)
+            code << "    color = " << pass.function << "(color, TexCoords);\n";
+        else if (pass.pointwise)
+            code << "    vec4 color = " << pass.function << "(texture(graphInput, TexCoords), TexCoords);\n";
+        else
+            code << "    vec4 color = " << pass.function << "(TexCoords);\n";
+    }
+    code << "    FragColor = color;\n}\n";
+    return code.str();
+}
+
+void RenderGraph::execute(GpuProfiler *profiler)
+{
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    for (const Group &group : groups)
+    {
+        if (profiler != nullptr)
+        {
+            std::string name;
+            for (int p : group.passes)
+                name += (name.empty() ? "" : " + ") + passes[p].name;
+            profiler->push(name);
+        }
+        const ResourceInfo &output = resources[group.output];
+        unsigned int FBO = output.imported ? output.framebuffer : targets.framebuffer(physicals[output.physical].target);
+        const Pass &first = passes[group.passes[0]];
+        if (first.resolve)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, first.sourceFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+            glBlitFramebuffer(0, 0, output.width, output.height, 0, 0, output.width, output.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            if (profiler != nullptr)
+                profiler->pop();
+            continue;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, output.width, output.height);
+        group.program->use();
+        for (size_t unit = 0; unit < group.samplers.size(); ++unit)
+        {
+            const std::string &name = group.samplers[unit].first;
+            const ResourceInfo &input = resources[group.samplers[unit].second];
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, input.texture);
+            group.program->setInt(name, (int)unit);
+            group.program->setVec2(name + "TexelSize", 1.0f / input.width, 1.0f / input.height);
+        }
+        for (int p : group.passes)
+            if (passes[p].setUniforms)
+                passes[p].setUniforms(*group.program);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        if (profiler != nullptr)
+            profiler->pop();
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+    if (blend)
+        glEnable(GL_BLEND);
+}
+
+std::vector<std::string> RenderGraph::schedule() const
+{
+    std::vector<std::string> names;
+    for (const Group &group : groups)
+    {
+        std::string name;
+        for (int p : group.passes)
+            name += (name.empty() ? "" : " + ") + passes[p].name;
+        names.push_back(name + " -> " + resources[group.output].name);
+    }
+    return names;
+}
+
+unsigned int RenderGraph::texture(Resource resource) const
+{
+    const ResourceInfo &info = resources[resource];
+    return info.imported || info.physical >= 0 ? info.texture : 0;
+}
+
+#endif
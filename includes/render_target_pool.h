@@ -0,0 +1,297 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+// Size and layout of a pooled render target. samples > 1 gives a GL_TEXTURE_2D_MULTISAMPLE.
+struct RenderTargetDesc {
+    GLenum internalFormat;
+    unsigned int width, height, samples;
+    RenderTargetDesc(GLenum internalFormat = GL_RGBA16F, unsigned int width = 1, unsigned int height = 1, unsigned int samples = 1)
+        : internalFormat(internalFormat), width(width), height(height), samples(samples) {}
+    bool operator==(const RenderTargetDesc &o) const
+    {
+        return internalFormat == o.internalFormat && width == o.width && height == o.height && samples == o.samples;
+    }
+};
+
+// Textures shared by everything that renders at screen (or a fraction of screen) resolution.
+// acquire() hands out an unused texture with the same (format, size, samples) or creates one,
+// release() gives it back, so targets are reused between passes of a frame and across frames.
+//
+// Released targets are not deleted right away: a target is only freed after it has been unused
+// for maxIdleFrames calls of endFrame(). On a window resize the old-size targets are released and
+// new ones acquired; deleting textures the queued frames still read from can make the driver wait
+// for them, while by the time a target is evicted the GPU is done with it. Resizing back and
+// forth (dragging a window edge) finds the previous sizes still in the pool.
+//
+//   int color = pool.acquire(RenderTargetDesc(GL_RGBA16F, width, height, 8));
+//   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, pool.textureTarget(color), pool.texture(color), 0);
+//   ... on resize: pool.release(color); color = pool.acquire(...) and re-attach
+//   pool.endFrame();   // once per frame
+class RenderTargetPool
+{
+public:
+    struct Usage {
+        unsigned int targets, inUse;
+        size_t bytes, inUseBytes;
+    };
+    // frames a released target stays allocated before it is deleted
+    unsigned int maxIdleFrames;
+    RenderTargetPool(unsigned int maxIdleFrames = 3);
+    ~RenderTargetPool();
+    // filter is (re)applied on every acquire, multisampled textures have none
+    int acquire(const RenderTargetDesc &desc, GLenum filter = GL_LINEAR);
+    void release(int target);
+    unsigned int texture(int target) const { return targets[target].texture; }
+    // GL_TEXTURE_2D or GL_TEXTURE_2D_MULTISAMPLE
+    GLenum textureTarget(int target) const { return targets[target].desc.samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D; }
+    const RenderTargetDesc &desc(int target) const { return targets[target].desc; }
+    // framebuffer with only this target attached (as color, or depth/stencil for depth formats), created on first use
+    unsigned int framebuffer(int target);
+    // evicts targets that have been idle for maxIdleFrames frames
+    void endFrame();
+    Usage usage() const;
+    // one line per allocated target, e.g. "GL_RGBA16F 1000x750 x8  45.8 MB  in use"
+    std::vector<std::string> report() const;
+    static size_t bytesPerPixel(GLenum internalFormat);
+    static bool isDepthFormat(GLenum internalFormat);
+private:
+    struct Target {
+        RenderTargetDesc desc;
+        unsigned int texture, FBO;
+        bool inUse;
+        unsigned long long lastUsedFrame;
+    };
+    // slots with texture 0 are free and reused, so handles stay valid while their target lives
+    std::vector<Target> targets;
+    unsigned long long frame;
+    static size_t bytes(const RenderTargetDesc &desc);
+    static const char *formatName(GLenum internalFormat);
+};
+
+RenderTargetPool::RenderTargetPool(unsigned int maxIdleFrames) : maxIdleFrames(maxIdleFrames), frame(0)
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    for (Target &target : targets)
+    {
+        if (target.FBO)
+            glDeleteFramebuffers(1, &target.FBO);
+        if (target.texture)
+            glDeleteTextures(1, &target.texture);
+    }
+}
+
+int RenderTargetPool::acquire(const RenderTargetDesc &desc, GLenum filter)
+{
+    int slot = -1;
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        Target &target = targets[i];
+        if (target.texture && !target.inUse && target.desc == desc)
+        {
+            slot = (int)i;
+            break;
+        }
+        if (!target.texture && slot < 0)
+            slot = (int)i;
+    }
+    if (slot < 0 || !targets[slot].texture)
+    {
+        Target target = {};
+        target.desc = desc;
+        glGenTextures(1, &target.texture);
+        if (desc.samples > 1)
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.texture);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width, desc.height, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, target.texture);
+            // the format/type pair only matters for uploads, it just has to be legal for the internal format
+            if (desc.internalFormat == GL_DEPTH24_STENCIL8)
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+            else if (desc.internalFormat == GL_DEPTH32F_STENCIL8)
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
+            else if (isDepthFormat(desc.internalFormat))
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            else
+                glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        if (slot < 0)
+        {
+            targets.push_back(target);
+            slot = (int)targets.size() - 1;
+        }
+        else
+            targets[slot] = target;
+    }
+    Target &target = targets[slot];
+    target.inUse = true;
+    target.lastUsedFrame = frame;
+    if (desc.samples <= 1)
+    {
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return slot;
+}
+
+void RenderTargetPool::release(int target)
+{
+    if (target < 0 || target >= (int)targets.size() || !targets[target].inUse)
+    {
+        std::cerr << "ERROR::RENDER_TARGET_POOL:: release of a target that is not in use" << std::endl;
+        return;
+    }
+    targets[target].inUse = false;
+    targets[target].lastUsedFrame = frame;
+}
+
+unsigned int RenderTargetPool::framebuffer(int target)
+{
+    Target &t = targets[target];
+    if (!t.FBO)
+    {
+        glGenFramebuffers(1, &t.FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, t.FBO);
+        GLenum attachment = GL_COLOR_ATTACHMENT0;
+        if (t.desc.internalFormat == GL_DEPTH24_STENCIL8 || t.desc.internalFormat == GL_DEPTH32F_STENCIL8)
+            attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+        else if (isDepthFormat(t.desc.internalFormat))
+            attachment = GL_DEPTH_ATTACHMENT;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, textureTarget(target), t.texture, 0);
+        if (attachment != GL_COLOR_ATTACHMENT0)
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::RENDER_TARGET_POOL:: Framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    return t.FBO;
+}
+
+void RenderTargetPool::endFrame()
+{
+    ++frame;
+    for (Target &target : targets)
+    {
+        if (!target.texture || target.inUse || frame - target.lastUsedFrame <= maxIdleFrames)
+            continue;
+        if (target.FBO)
+            glDeleteFramebuffers(1, &target.FBO);
+        glDeleteTextures(1, &target.texture);
+        target = Target();
+    }
+}
+
+RenderTargetPool::Usage RenderTargetPool::usage() const
+{
+    Usage usage = {};
+    for (const Target &target : targets)
+    {
+        if (!target.texture)
+            continue;
+        usage.targets++;
+        usage.bytes += bytes(target.desc);
+        if (target.inUse)
+        {
+            usage.inUse++;
+            usage.inUseBytes += bytes(target.desc);
+        }
+    }
+    return usage;
+}
+
+std::vector<std::string> RenderTargetPool::report() const
+{
+    std::vector<std::string> lines;
+    for (const Target &target : targets)
+    {
+        if (!target.texture)
+            continue;
+        std::stringstream line;
+        line << formatName(target.desc.internalFormat) << " " << target.desc.width << "x" << target.desc.height;
+        if (target.desc.samples > 1)
+            line << " x" << target.desc.samples;
+        line << "  " << std::fixed << std::setprecision(1) << bytes(target.desc) / 1048576.0 << " MB  "
+             << (target.inUse ? "in use" : "idle");
+        lines.push_back(line.str());
+    }
+    return lines;
+}
+
+size_t RenderTargetPool::bytes(const RenderTargetDesc &desc)
+{
+    return (size_t)desc.width * desc.height * std::max(1u, desc.samples) * bytesPerPixel(desc.internalFormat);
+}
+
+bool RenderTargetPool::isDepthFormat(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8: case GL_DEPTH32F_STENCIL8: return true;
+    default: return false;
+    }
+}
+
+// an estimate: drivers may pad rows, compress or keep extra metadata (msaa, depth hi-z)
+size_t RenderTargetPool::bytesPerPixel(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8: return 1;
+    case GL_R16F: case GL_RG8: case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RGB8: case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_R32F: case GL_RG16F:
+    case GL_R11F_G11F_B10F: case GL_RGB10_A2: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8: return 4;
+    case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+    }
+}
+
+const char *RenderTargetPool::formatName(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8: return "GL_R8";
+    case GL_RG8: return "GL_RG8";
+    case GL_RGBA8: return "GL_RGBA8";
+    case GL_SRGB8_ALPHA8: return "GL_SRGB8_ALPHA8";
+    case GL_RGB10_A2: return "GL_RGB10_A2";
+    case GL_R11F_G11F_B10F: return "GL_R11F_G11F_B10F";
+    case GL_R16F: return "GL_R16F";
+    case GL_RG16F: return "GL_RG16F";
+    case GL_RGBA16F: return "GL_RGBA16F";
+    case GL_R32F: return "GL_R32F";
+    case GL_RGBA32F: return "GL_RGBA32F";
+    case GL_DEPTH_COMPONENT24: return "GL_DEPTH_COMPONENT24";
+    case GL_DEPTH_COMPONENT32F: return "GL_DEPTH_COMPONENT32F";
+    case GL_DEPTH24_STENCIL8: return "GL_DEPTH24_STENCIL8";
+    case GL_DEPTH32F_STENCIL8: return "GL_DEPTH32F_STENCIL8";
+    default: return "format";
+    }
+}
+
+#endif
@@ -3,93 +3,101 @@
 
 #include <glad/glad.h>
 
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include "cpu_profiler.h"
+
 #include <string>
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <map>
+#include <vector>
+
+// binding points of the shared uniform blocks (shaders/common/uniforms.glsl),
+// every program gets them assigned right after linking
+enum UniformBlockBinding
+{
+    MATRICES_BLOCK = 0,
+    FRAME_BLOCK = 1,
+    LIGHT_BLOCK = 2,
+    MATERIAL_BLOCK = 3
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // empty program, built later by a ShaderBatch (shader_batch.h)
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char *geometryPath = nullptr)
+    Shader() : ID(0)
+    {
+    }
+    // constructor generates the shader on the fly, defines are injected into every stage
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char *geometryPath = nullptr,
+           const ShaderDefines &defines = ShaderDefines())
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            if (geometryPath != nullptr)
-                gShaderFile.open(geometryPath);
-            std::stringstream vShaderStream, fShaderStream, gShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            if (geometryPath != nullptr)
-                gShaderStream << gShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
+            // read files, resolving #include "file" relative to the including file
+            vertexCode   = ShaderPreprocessor::process(vertexPath, defines);
+            fragmentCode = ShaderPreprocessor::process(fragmentPath, defines);
             if (geometryPath != nullptr)
-                gShaderFile.close();
-            // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            if (geometryPath != nullptr)
-                geometryCode = gShaderStream.str();
+                geometryCode = ShaderPreprocessor::process(geometryPath, defines);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+        setSources(vertexPath, fragmentPath, geometryPath != nullptr ? geometryPath : "", defines);
+        compile(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+    }
+    // program from sources already in memory, e.g. code generated at run time
+    // ------------------------------------------------------------------------
+    Shader(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        compile(vertexCode, fragmentCode, nullptr);
+    }
+    // vertex-only program for transform feedback: the listed outputs are captured interleaved,
+    // in order, into the buffer bound to GL_TRANSFORM_FEEDBACK_BUFFER index 0
+    // ------------------------------------------------------------------------
+    Shader(const char *vertexPath, const std::vector<std::string> &feedbackVaryings)
+    {
+        std::string vertexCode;
+        try
+        {
+            vertexCode = ShaderPreprocessor::process(vertexPath);
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        ID = glCreateProgram();
+        // the captured outputs are part of the binary
+        std::vector<std::string> keyParts = { vertexCode };
+        keyParts.insert(keyParts.end(), feedbackVaryings.begin(), feedbackVaryings.end());
+        uint64_t key = 0;
+        if (loadCached(keyParts, key))
+            return;
         const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment, geometry;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
+        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
         checkCompileErrors(vertex, "VERTEX");
-        // geometry shader
-        if (geometryPath != nullptr)
-        {
-            const char *gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glAttachShader(ID, fragment);
+        std::vector<const char *> varyings;
+        for (const std::string &varying : feedbackVaryings)
+            varyings.push_back(varying.c_str());
+        glTransformFeedbackVaryings(ID, (GLsizei)varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
+        storeCached(key);
+        bindUniformBlocks();
         glDeleteShader(vertex);
-        if (geometryPath != nullptr)
-            glDeleteShader(geometry);
-        glDeleteShader(fragment);
     }
     ~Shader()
     {
@@ -117,6 +125,14 @@ public:
     { 
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
     }
+    void setIVec3(const std::string &name, int v1, int v2, int v3) const 
+    {
+        glUniform3i(glGetUniformLocation(ID, name.c_str()), v1, v2, v3); 
+    }
+    void setVec2(const std::string &name, float v1, float v2) const 
+    {
+        glUniform2f(glGetUniformLocation(ID, name.c_str()), v1, v2); 
+    }
     void setVec3(const std::string &name, float v1, float v2, float v3) const 
     {
         glUniform3f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3); 
@@ -135,6 +151,135 @@ public:
     }
 
 private:
+    friend class ShaderBatch;
+    friend class ShaderHotReload;
+    // files (vertex, fragment, geometry or "") and defines the program was built from, empty for
+    // programs built from memory. A ShaderHotReload rebuilds from them.
+    std::string sourcePaths[3];
+    ShaderDefines sourceDefines;
+    // stages attached to a program that is still linking, with their type for error messages
+    std::vector<std::pair<unsigned int, std::string>> linkingStages;
+    uint64_t linkingKey = 0;
+    bool linking = false;
+
+    void setSources(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath,
+                    const ShaderDefines &defines)
+    {
+        sourcePaths[0] = vertexPath;
+        sourcePaths[1] = fragmentPath;
+        sourcePaths[2] = geometryPath;
+        sourceDefines = defines;
+    }
+    // 2. compile shaders and link the program
+    // ------------------------------------------------------------------------
+    void compile(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        startBuild(vertexCode, fragmentCode, geometryCode);
+        finishBuild();
+    }
+    // submits the compiles and the link without asking for their status, which is what makes the
+    // driver wait for them. finishBuild() does that once the result is needed.
+    // ------------------------------------------------------------------------
+    void startBuild(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        CPU_PROFILE_SCOPE("Shader::startBuild");
+        ID = glCreateProgram();
+        if (loadCached({ vertexCode, geometryCode != nullptr ? *geometryCode : "", fragmentCode }, linkingKey))
+            return;
+        attachStage(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+        if (geometryCode != nullptr)
+            attachStage(GL_GEOMETRY_SHADER, *geometryCode, "GEOMETRY");
+        attachStage(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
+        glLinkProgram(ID);
+        linking = true;
+    }
+    void attachStage(GLenum type, const std::string &code, const std::string &name)
+    {
+        const char *source = code.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &source, NULL);
+        glCompileShader(stage);
+        glAttachShader(ID, stage);
+        linkingStages.push_back({ stage, name });
+    }
+    // true if finishBuild() would not wait, only known with KHR_parallel_shader_compile
+    // ------------------------------------------------------------------------
+    bool linkComplete() const
+    {
+        if (!linking)
+            return true;
+#ifdef GL_KHR_parallel_shader_compile
+        if (GLAD_GL_KHR_parallel_shader_compile)
+        {
+            int complete = 0;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+            return complete != 0;
+        }
+#endif
+        return true;
+    }
+    // waits for the link, reports errors and stores the binary in the program cache
+    // ------------------------------------------------------------------------
+    void finishBuild()
+    {
+        if (!linking)
+            return;
+        CPU_PROFILE_SCOPE("Shader::finishBuild");
+        for (const auto &stage : linkingStages)
+        {
+            checkCompileErrors(stage.first, stage.second);
+            // delete the shaders as they're linked into our program now and no longer necessary
+            glDeleteShader(stage.first);
+        }
+        linkingStages.clear();
+        checkCompileErrors(ID, "PROGRAM");
+        storeCached(linkingKey);
+        bindUniformBlocks();
+        linking = false;
+    }
+    // links ID from the current program cache, if any. Otherwise key is set for storeCached and
+    // the program prepared so its binary can be retrieved after linking.
+    // ------------------------------------------------------------------------
+    bool loadCached(const std::vector<std::string> &keyParts, uint64_t &key)
+    {
+        ProgramCache *cache = ProgramCache::current();
+        if (cache == nullptr)
+            return false;
+        key = cache->key(keyParts);
+        if (cache->load(ID, key))
+        {
+            bindUniformBlocks();
+            return true;
+        }
+        cache->prepare(ID);
+        return false;
+    }
+    void storeCached(uint64_t key)
+    {
+        if (ProgramCache::current() != nullptr)
+            ProgramCache::current()->store(ID, key);
+    }
+    // binds the shared uniform blocks this program uses to their fixed binding points
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        static const std::map<std::string, unsigned int> bindings = {
+            { "Matrices", MATRICES_BLOCK },
+            { "FrameData", FRAME_BLOCK },
+            { "LightData", LIGHT_BLOCK },
+            { "MaterialData", MATERIAL_BLOCK },
+        };
+        int blockCount = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        for (int i = 0; i < blockCount; ++i)
+        {
+            char name[128];
+            glGetActiveUniformBlockName(ID, i, sizeof(name), NULL, name);
+            auto binding = bindings.find(name);
+            if (binding != bindings.end())
+                glUniformBlockBinding(ID, i, binding->second);
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,142 @@
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+// Builds many programs without waiting for each in turn. add() only records the files; submit()
+// reads and preprocesses them on the thread pool, then issues every compile and link (or loads
+// the cached binary) and returns without asking for a status. With KHR_parallel_shader_compile
+// the driver compiles on its own threads meanwhile, so loading models and textures between
+// submit() and finish() overlaps it; without it the driver may compile inside glLinkProgram, or
+// defer the work to the first status query in finish().
+//
+//   Shader blinnShader, depthShader;
+//   batch.add(blinnShader, "vert.glsl", "frag.glsl");
+//   batch.add(depthShader, "depth_vert.glsl", "depth_frag.glsl");
+//   batch.submit();
+//   ... load models and textures ...
+//   batch.finish();                   // reports errors, the shaders are usable from here on
+class ShaderBatch
+{
+public:
+    // time the caller was blocked in submit() and finish()
+    float submitMs, finishMs;
+    // the driver compiles on its own threads
+    bool parallel;
+    ShaderBatch(ThreadPool &threads);
+    // geometryPath "" for none, defines are injected into every stage. shader stays empty until submit()
+    void add(Shader &shader, const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath = "",
+             const ShaderDefines &defines = ShaderDefines());
+    void submit();
+    // true once finish() would not wait. Without KHR_parallel_shader_compile the driver can not be
+    // asked without waiting, this is then always true and finish() does the waiting
+    bool ready() const;
+    void finish();
+    static bool parallelCompileSupported();
+private:
+    struct Entry {
+        Shader *shader;
+        // vertex, fragment, geometry
+        std::string paths[3];
+        std::string sources[3];
+        ShaderDefines defines;
+        std::string error;
+    };
+    ThreadPool &threads;
+    std::vector<Entry> added;
+    std::vector<Shader *> submitted;
+};
+
+bool ShaderBatch::parallelCompileSupported()
+{
+    bool supported = false;
+#ifdef GL_KHR_parallel_shader_compile
+    supported = supported || GLAD_GL_KHR_parallel_shader_compile;
+#endif
+    return supported;
+}
+
+ShaderBatch::ShaderBatch(ThreadPool &threads) : submitMs(0.0f), finishMs(0.0f), parallel(false), threads(threads)
+{
+#ifdef GL_KHR_parallel_shader_compile
+    if (parallelCompileSupported())
+    {
+        // let the driver pick the number of compiler threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        parallel = true;
+    }
+#endif
+}
+
+void ShaderBatch::add(Shader &shader, const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath,
+                      const ShaderDefines &defines)
+{
+    Entry entry;
+    entry.shader = &shader;
+    entry.paths[0] = vertexPath;
+    entry.paths[1] = fragmentPath;
+    entry.paths[2] = geometryPath;
+    entry.defines = defines;
+    shader.setSources(vertexPath, fragmentPath, geometryPath, defines);
+    added.push_back(entry);
+}
+
+void ShaderBatch::submit()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    // file reading and #include expansion need no context, one program per chunk
+    threads.parallelFor(added.size(), 1, [&](size_t begin, size_t end, size_t) {
+        CPU_PROFILE_SCOPE("ShaderBatch read");
+        for (size_t i = begin; i < end; ++i)
+        {
+            Entry &entry = added[i];
+            try
+            {
+                for (int stage = 0; stage < 3; ++stage)
+                {
+                    if (!entry.paths[stage].empty())
+                        entry.sources[stage] = ShaderPreprocessor::process(entry.paths[stage], entry.defines);
+                }
+            }
+            catch (std::ifstream::failure &e)
+            {
+                entry.error = e.what();
+            }
+        }
+    });
+    for (Entry &entry : added)
+    {
+        if (!entry.error.empty())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << entry.error << std::endl;
+        entry.shader->startBuild(entry.sources[0], entry.sources[1], entry.paths[2].empty() ? nullptr : &entry.sources[2]);
+        submitted.push_back(entry.shader);
+    }
+    added.clear();
+    submitMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool ShaderBatch::ready() const
+{
+    for (const Shader *shader : submitted)
+        if (!shader->linkComplete())
+            return false;
+    return true;
+}
+
+void ShaderBatch::finish()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (Shader *shader : submitted)
+        shader->finishBuild();
+    submitted.clear();
+    finishMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+#endif
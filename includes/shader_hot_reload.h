@@ -0,0 +1,381 @@
+#ifndef SHADER_HOT_RELOAD_H
+#define SHADER_HOT_RELOAD_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "shader_variants.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Rebuilds watched programs when one of their files (includes too) is saved, without restarting.
+// Changes come from inotify on Linux and from polling the files' modification times elsewhere.
+// The files are read and preprocessed on a background thread, the compile and link are submitted
+// without waiting (with KHR_parallel_shader_compile the driver compiles on its own threads) and
+// update() swaps the new program in once it has linked. A program that fails keeps the old one, so
+// a typo only prints the compile log. The new program gets the old one's plain uniform values and
+// uniform block bindings copied over through reflection, state set once at startup (sampler
+// units, ...) survives the reload.
+//
+//   ShaderHotReload reload;
+//   reload.watch(blinnShader);
+//   while (...)
+//   {
+//       reload.update();             // at frame start, before any shader is used
+//       ...
+//   }
+class ShaderHotReload
+{
+public:
+    // programs swapped in, rebuilds that failed and kept the old program
+    unsigned int reloads, failures;
+    // time from noticing the change to the swap of the last reload
+    float lastReloadMs;
+    // false when the files are polled
+    bool inotify;
+    // pollInterval in seconds, only used without inotify
+    ShaderHotReload(float pollInterval = 0.5f);
+    ~ShaderHotReload();
+    // programs without source files (built from memory) are ignored
+    void watch(Shader &shader);
+    // the variants built so far
+    void watch(ShaderVariants &variants);
+    size_t size() const { return programs.size(); }
+    // picks up changes, starts rebuilds and swaps finished ones in. Call at frame start.
+    void update();
+private:
+    // result of reading a program's stages off the render thread
+    struct Sources
+    {
+        std::string code[3];
+        std::set<std::string> files;
+        std::string error;
+    };
+    struct Program
+    {
+        Shader *shader;
+        // every file the stages include, normalized
+        std::set<std::string> files;
+        bool dirty;
+        std::chrono::steady_clock::time_point changed;
+        std::future<Sources> reading;
+        std::unique_ptr<Shader> building;
+    };
+    std::vector<std::unique_ptr<Program>> programs;
+    int inotifyFd;
+    // directory of every inotify watch
+    std::map<int, std::string> directories;
+    // modification time and size of every file when polling
+    std::map<std::string, std::pair<long long, long long>> stamps;
+    float pollInterval;
+    std::chrono::steady_clock::time_point lastPoll;
+    void watchFiles(const std::set<std::string> &files);
+    std::set<std::string> changedFiles();
+    static Sources read(const Shader &shader);
+    static std::pair<long long, long long> stamp(const std::string &path);
+    static void copyUniforms(unsigned int from, unsigned int to);
+};
+
+ShaderHotReload::ShaderHotReload(float pollInterval)
+    : reloads(0), failures(0), lastReloadMs(0.0f), inotify(false), inotifyFd(-1), pollInterval(pollInterval),
+      lastPoll(std::chrono::steady_clock::now())
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    inotify = inotifyFd >= 0;
+#endif
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+    // a build still in flight deletes its program with its Shader, a read still running is waited
+    // for by its future
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+void ShaderHotReload::watch(Shader &shader)
+{
+    if (shader.sourcePaths[0].empty())
+        return;
+    for (const auto &program : programs)
+        if (program->shader == &shader)
+            return;
+    std::unique_ptr<Program> program(new Program());
+    program->shader = &shader;
+    program->dirty = false;
+    // only the include graph is needed here, the sources themselves are read again on a change
+    Sources sources = read(shader);
+    program->files = sources.files;
+    watchFiles(program->files);
+    programs.push_back(std::move(program));
+}
+
+void ShaderHotReload::watch(ShaderVariants &variants)
+{
+    for (Shader *shader : variants.all())
+        watch(*shader);
+}
+
+ShaderHotReload::Sources ShaderHotReload::read(const Shader &shader)
+{
+    Sources sources;
+    try
+    {
+        for (int stage = 0; stage < 3; ++stage)
+        {
+            if (shader.sourcePaths[stage].empty())
+                continue;
+            std::set<std::string> included;
+            sources.code[stage] = ShaderPreprocessor::injectDefines(ShaderPreprocessor::readSource(shader.sourcePaths[stage], included),
+                                                                     shader.sourceDefines);
+            sources.files.insert(included.begin(), included.end());
+        }
+    }
+    catch (std::ifstream::failure &e)
+    {
+        sources.error = e.what();
+    }
+    return sources;
+}
+
+std::pair<long long, long long> ShaderHotReload::stamp(const std::string &path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return { -1, -1 };
+    return { (long long)info.st_mtime, (long long)info.st_size };
+}
+
+void ShaderHotReload::watchFiles(const std::set<std::string> &files)
+{
+    for (const std::string &file : files)
+    {
+#ifdef __linux__
+        if (inotify)
+        {
+            // inotify watches directories, one per directory that holds a watched file
+            std::string directory = file.substr(0, file.find_last_of('/'));
+            bool known = false;
+            for (const auto &watched : directories)
+                known = known || watched.second == directory;
+            if (known)
+                continue;
+            // editors that save through a temporary file and a rename only report IN_MOVED_TO
+            int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd >= 0)
+                directories[wd] = directory;
+            else
+                std::cerr << "ERROR::SHADER_HOT_RELOAD:: Could not watch " << directory << std::endl;
+            continue;
+        }
+#endif
+        if (stamps.find(file) == stamps.end())
+            stamps[file] = stamp(file);
+    }
+}
+
+std::set<std::string> ShaderHotReload::changedFiles()
+{
+    std::set<std::string> changed;
+#ifdef __linux__
+    if (inotify)
+    {
+        alignas(struct inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *event = buffer; event < buffer + length; )
+            {
+                const struct inotify_event *info = (const struct inotify_event *)event;
+                auto directory = directories.find(info->wd);
+                if (info->len > 0 && directory != directories.end())
+                    changed.insert(ShaderPreprocessor::normalizePath(directory->second + "/" + info->name));
+                event += sizeof(struct inotify_event) + info->len;
+            }
+        }
+        return changed;
+    }
+#endif
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<float>(now - lastPoll).count() < pollInterval)
+        return changed;
+    lastPoll = now;
+    for (auto &file : stamps)
+    {
+        std::pair<long long, long long> current = stamp(file.first);
+        if (current != file.second)
+        {
+            file.second = current;
+            changed.insert(file.first);
+        }
+    }
+    return changed;
+}
+
+void ShaderHotReload::update()
+{
+    std::set<std::string> changed = changedFiles();
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &program : programs)
+    {
+        Program &p = *program;
+        for (const std::string &file : changed)
+        {
+            if (p.files.count(file) != 0)
+            {
+                if (!p.dirty)
+                    p.changed = now;
+                p.dirty = true;
+                break;
+            }
+        }
+        // one rebuild at a time per program, a change during a rebuild starts the next one after it
+        if (p.dirty && !p.reading.valid() && !p.building)
+        {
+            p.dirty = false;
+            Shader *shader = p.shader;
+            p.reading = std::async(std::launch::async, [shader]() { return read(*shader); });
+        }
+        if (p.reading.valid() && p.reading.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            Sources sources = p.reading.get();
+            if (!sources.error.empty())
+            {
+                // e.g. a file renamed away, the next save tries again
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << sources.error << std::endl;
+                ++failures;
+                continue;
+            }
+            // an edit may have added includes
+            p.files = sources.files;
+            watchFiles(p.files);
+            p.building.reset(new Shader());
+            p.building->setSources(p.shader->sourcePaths[0], p.shader->sourcePaths[1], p.shader->sourcePaths[2], p.shader->sourceDefines);
+            p.building->startBuild(sources.code[0], sources.code[1], p.shader->sourcePaths[2].empty() ? nullptr : &sources.code[2]);
+        }
+        if (p.building && p.building->linkComplete())
+        {
+            // prints the compile and link logs of a failed build
+            p.building->finishBuild();
+            int linked = 0;
+            glGetProgramiv(p.building->ID, GL_LINK_STATUS, &linked);
+            if (linked)
+            {
+                copyUniforms(p.shader->ID, p.building->ID);
+                // the old program is deleted with the building Shader
+                std::swap(p.shader->ID, p.building->ID);
+                ++reloads;
+                lastReloadMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - p.changed).count();
+                std::cout << "SHADER_HOT_RELOAD:: " << p.shader->sourcePaths[1] << " reloaded in " << lastReloadMs << " ms" << std::endl;
+            }
+            else
+            {
+                ++failures;
+                std::cerr << "ERROR::SHADER_HOT_RELOAD:: Keeping the previous program of " << p.shader->sourcePaths[1] << std::endl;
+            }
+            p.building.reset();
+        }
+    }
+}
+
+void ShaderHotReload::copyUniforms(unsigned int from, unsigned int to)
+{
+    int previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(to);
+    // a uniform whose type changed with the edit keeps its default
+    std::map<std::string, GLenum> targetTypes;
+    int count = 0;
+    glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; ++i)
+    {
+        char name[256];
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(to, i, sizeof(name), NULL, &size, &type, name);
+        targetTypes[name] = type;
+    }
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; ++i)
+    {
+        char name[256];
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(from, i, sizeof(name), NULL, &size, &type, name);
+        // members of uniform blocks live in buffers, not in the program
+        unsigned int index = i;
+        int block = -1;
+        glGetActiveUniformsiv(from, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+        auto target = targetTypes.find(name);
+        if (block != -1 || target == targetTypes.end() || target->second != type)
+            continue;
+        // arrays are reported once as "name[0]"
+        std::string base = name;
+        if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+            base.resize(base.size() - 3);
+        for (int element = 0; element < size; ++element)
+        {
+            std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+            int source = glGetUniformLocation(from, elementName.c_str());
+            int location = glGetUniformLocation(to, elementName.c_str());
+            if (source < 0 || location < 0)
+                continue;
+            float f[16];
+            int n[4];
+            unsigned int u[4];
+            switch (type)
+            {
+            case GL_FLOAT:             glGetUniformfv(from, source, f); glUniform1fv(location, 1, f); break;
+            case GL_FLOAT_VEC2:        glGetUniformfv(from, source, f); glUniform2fv(location, 1, f); break;
+            case GL_FLOAT_VEC3:        glGetUniformfv(from, source, f); glUniform3fv(location, 1, f); break;
+            case GL_FLOAT_VEC4:        glGetUniformfv(from, source, f); glUniform4fv(location, 1, f); break;
+            case GL_FLOAT_MAT2:        glGetUniformfv(from, source, f); glUniformMatrix2fv(location, 1, GL_FALSE, f); break;
+            case GL_FLOAT_MAT3:        glGetUniformfv(from, source, f); glUniformMatrix3fv(location, 1, GL_FALSE, f); break;
+            case GL_FLOAT_MAT4:        glGetUniformfv(from, source, f); glUniformMatrix4fv(location, 1, GL_FALSE, f); break;
+            case GL_INT_VEC2:
+            case GL_BOOL_VEC2:         glGetUniformiv(from, source, n); glUniform2iv(location, 1, n); break;
+            case GL_INT_VEC3:
+            case GL_BOOL_VEC3:         glGetUniformiv(from, source, n); glUniform3iv(location, 1, n); break;
+            case GL_INT_VEC4:
+            case GL_BOOL_VEC4:         glGetUniformiv(from, source, n); glUniform4iv(location, 1, n); break;
+            case GL_UNSIGNED_INT:      glGetUniformuiv(from, source, u); glUniform1uiv(location, 1, u); break;
+            case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, u); glUniform2uiv(location, 1, u); break;
+            case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, u); glUniform3uiv(location, 1, u); break;
+            case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, u); glUniform4uiv(location, 1, u); break;
+            // int, bool and the sampler types, whose value is a texture unit
+            default:                   glGetUniformiv(from, source, n); glUniform1iv(location, 1, n); break;
+            }
+        }
+    }
+    // bindings set after Shader::bindUniformBlocks(), e.g. by hand, are carried over too
+    int blocks = 0;
+    glGetProgramiv(to, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    for (int i = 0; i < blocks; ++i)
+    {
+        char name[128];
+        glGetActiveUniformBlockName(to, i, sizeof(name), NULL, name);
+        unsigned int source = glGetUniformBlockIndex(from, name);
+        if (source == GL_INVALID_INDEX)
+            continue;
+        int binding = 0;
+        glGetActiveUniformBlockiv(from, source, GL_UNIFORM_BLOCK_BINDING, &binding);
+        glUniformBlockBinding(to, i, binding);
+    }
+    glUseProgram(previous);
+}
+#endif
@@ -0,0 +1,161 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <map>
+#include <vector>
+
+// `#define NAME VALUE` lines injected into a shader, VALUE may be empty. Ordered, so equal sets
+// give equal sources and equal permutation keys.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// Text-level GLSL preprocessing done before the source reaches the driver, no GL calls:
+// #include "file" relative to the including file and injected define sets (permutations).
+//
+//   ShaderDefines defines = { { "HAS_NORMAL_MAP", "" }, { "NR_POINT_LIGHTS", "2" } };
+//   std::string source = ShaderPreprocessor::process("shaders/frag.glsl", defines);
+class ShaderPreprocessor
+{
+public:
+    // reads a shader file and pastes in every #include "file" once, a #line directive after each
+    // include keeps the compiler's line numbers pointing into the including file. Files already in
+    // `included` are skipped, so several files can be pasted into one source without duplicates.
+    // Throws std::ifstream::failure if a file can not be read.
+    static std::string readSource(const std::string &path, std::set<std::string> &included);
+    // readSource() of path with the defines injected. Without defines, a file under the directory
+    // given to usePrepared() is read from its prepared copy if there is one.
+    static std::string process(const std::string &path, const ShaderDefines &defines = ShaderDefines());
+    // reads the shaders under sourceDirectory from preparedDirectory instead, where the
+    // validate_shaders build target writes them expanded and optimized. "" for both turns it off.
+    static void usePrepared(const std::string &sourceDirectory, const std::string &preparedDirectory);
+    // inserts the defines right after the #version line, followed by a #line directive so the
+    // compiler's line numbers stay those of the file
+    static std::string injectDefines(const std::string &source, const ShaderDefines &defines);
+    // "HAS_NORMAL_MAP;NR_POINT_LIGHTS=2", the same for equal sets
+    static std::string permutationKey(const ShaderDefines &defines);
+    // resolves "." and ".." so a file reached along different relative paths is included once
+    static std::string normalizePath(const std::string &path);
+private:
+    // source and prepared directory of usePrepared()
+    static std::pair<std::string, std::string> &prepared();
+};
+
+std::pair<std::string, std::string> &ShaderPreprocessor::prepared()
+{
+    static std::pair<std::string, std::string> directories;
+    return directories;
+}
+
+void ShaderPreprocessor::usePrepared(const std::string &sourceDirectory, const std::string &preparedDirectory)
+{
+    prepared() = { normalizePath(sourceDirectory), normalizePath(preparedDirectory) };
+}
+
+std::string ShaderPreprocessor::normalizePath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(path);
+    std::string part;
+    while (std::getline(stream, part, '/'))
+    {
+        if (part == "." || (part.empty() && !parts.empty()))
+            continue;
+        if (part == ".." && !parts.empty() && parts.back() != ".." && !parts.back().empty())
+            parts.pop_back();
+        else
+            parts.push_back(part);
+    }
+    std::string result;
+    for (size_t i = 0; i < parts.size(); ++i)
+        result += (i > 0 ? "/" : "") + parts[i];
+    return result;
+}
+
+std::string ShaderPreprocessor::readSource(const std::string &path, std::set<std::string> &included)
+{
+    if (!included.insert(normalizePath(path)).second)
+        return "";
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    file.close();
+
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    std::stringstream result;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(stream, line))
+    {
+        ++lineNumber;
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', start), close = line.find('"', open + 1);
+            if (open != std::string::npos && close != std::string::npos)
+            {
+                result << readSource(directory + line.substr(open + 1, close - open - 1), included) << "\n";
+                result << "#line " << lineNumber + 1 << "\n";
+                continue;
+            }
+        }
+        result << line << "\n";
+    }
+    return result.str();
+}
+
+std::string ShaderPreprocessor::process(const std::string &path, const ShaderDefines &defines)
+{
+    // prepared copies are built without defines, so only the plain permutation has one
+    const std::string &sourceDirectory = prepared().first;
+    std::string file = normalizePath(path);
+    if (defines.empty() && !sourceDirectory.empty() && file.compare(0, sourceDirectory.size() + 1, sourceDirectory + "/") == 0)
+    {
+        std::ifstream copy(prepared().second + file.substr(sourceDirectory.size()));
+        if (copy)
+        {
+            std::stringstream stream;
+            stream << copy.rdbuf();
+            return stream.str();
+        }
+    }
+    std::set<std::string> included;
+    return injectDefines(readSource(path, included), defines);
+}
+
+std::string ShaderPreprocessor::injectDefines(const std::string &source, const ShaderDefines &defines)
+{
+    if (defines.empty())
+        return source;
+    std::string block;
+    for (const auto &define : defines)
+        block += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+    // #version has to stay the first directive
+    size_t version = source.find("#version");
+    if (version == std::string::npos)
+        return block + "#line 1\n" + source;
+    size_t end = source.find('\n', version);
+    if (end == std::string::npos)
+        return source + "\n" + block;
+    int nextLine = 2;
+    for (size_t i = 0; i < version; ++i)
+        nextLine += source[i] == '\n';
+    return source.substr(0, end + 1) + block + "#line " + std::to_string(nextLine) + "\n" + source.substr(end + 1);
+}
+
+std::string ShaderPreprocessor::permutationKey(const ShaderDefines &defines)
+{
+    std::string key;
+    for (const auto &define : defines)
+    {
+        if (!key.empty())
+            key += ";";
+        key += define.first + (define.second.empty() ? "" : "=" + define.second);
+    }
+    return key;
+}
+#endif
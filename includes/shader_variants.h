@@ -0,0 +1,68 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "shader.h"
+#include "shader_batch.h"
+
+#include <string>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Programs built from the same files with different define sets (permutations), each built once
+// and kept by its permutation key. A draw asks for the define set of its material and gets the
+// variant that only does what that material needs.
+//
+//   ShaderVariants lit("vert.glsl", "frag.glsl");
+//   Shader &shader = lit.get({ { "HAS_NORMAL_MAP", "" }, { "SHADOWS", "" } });
+class ShaderVariants
+{
+public:
+    // base defines are part of every variant
+    ShaderVariants(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath = "",
+                   const ShaderDefines &base = ShaderDefines());
+    // the variant for base + defines, built now if it is new. Given a batch a new variant is only
+    // added to it and can be used after the batch's finish()
+    Shader &get(const ShaderDefines &defines, ShaderBatch *batch = nullptr);
+    // every variant built so far, e.g. to set uniforms they all share
+    std::vector<Shader *> all() const;
+    size_t size() const { return variants.size(); }
+private:
+    std::string vertexPath, fragmentPath, geometryPath;
+    ShaderDefines base;
+    std::map<std::string, std::unique_ptr<Shader>> variants;
+};
+
+ShaderVariants::ShaderVariants(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath,
+                               const ShaderDefines &base)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath), base(base)
+{
+}
+
+Shader &ShaderVariants::get(const ShaderDefines &defines, ShaderBatch *batch)
+{
+    ShaderDefines merged = base;
+    for (const auto &define : defines)
+        merged[define.first] = define.second;
+    std::unique_ptr<Shader> &variant = variants[ShaderPreprocessor::permutationKey(merged)];
+    if (!variant)
+    {
+        if (batch != nullptr)
+        {
+            variant.reset(new Shader());
+            batch->add(*variant, vertexPath, fragmentPath, geometryPath, merged);
+        }
+        else
+            variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), geometryPath.empty() ? nullptr : geometryPath.c_str(), merged));
+    }
+    return *variant;
+}
+
+std::vector<Shader *> ShaderVariants::all() const
+{
+    std::vector<Shader *> shaders;
+    for (const auto &variant : variants)
+        shaders.push_back(variant.second.get());
+    return shaders;
+}
+#endif
@@ -0,0 +1,141 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+// Buffer for data rewritten every frame (uniform blocks, instance attributes).
+// With GL 4.4 / ARB_buffer_storage the buffer holds `regions` copies of the data and stays
+// persistently mapped: each frame writes the next region and fences it once the draws reading it
+// are submitted, so the CPU only waits if it gets `regions` frames ahead of the GPU.
+// Without it, every map() orphans the buffer and maps it with GL_MAP_INVALIDATE_BUFFER_BIT.
+//
+//   void *ptr = stream.map(size);   // write at most regionSize bytes
+//   size_t offset = stream.unmap(); // offset of the written data inside stream.buffer
+//   ... draws that read [offset, offset + size) ...
+//   stream.fence();
+class StreamBuffer
+{
+public:
+    unsigned int buffer;
+    size_t regionSize;
+    bool persistent;
+    // CPU time spent waiting for the GPU in the last map()
+    float waitTimeMs;
+    // regionSize is rounded up to alignment (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for uniform buffers)
+    StreamBuffer(GLenum target, size_t regionSize, unsigned int regions = 3, size_t alignment = 1);
+    ~StreamBuffer();
+    void *map(size_t size);
+    size_t unmap();
+    void fence();
+    static bool persistentMappingSupported();
+private:
+    GLenum target;
+    unsigned int regions, current;
+    char *mapped;
+    std::vector<GLsync> fences;
+};
+
+bool StreamBuffer::persistentMappingSupported()
+{
+    bool supported = false;
+#ifdef GL_VERSION_4_4
+    supported = supported || GLAD_GL_VERSION_4_4;
+#endif
+#ifdef GL_ARB_buffer_storage
+    supported = supported || GLAD_GL_ARB_buffer_storage;
+#endif
+    return supported;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, size_t regionSize, unsigned int regions, size_t alignment)
+    : persistent(false), waitTimeMs(0.0f), target(target), regions(regions), current(0), mapped(nullptr)
+{
+    this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+    fences.resize(regions, nullptr);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+    if (persistentMappingSupported())
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, this->regionSize * regions, NULL, flags);
+        mapped = (char *)glMapBufferRange(target, 0, this->regionSize * regions, flags);
+        persistent = mapped != nullptr;
+        if (!persistent)
+            std::cerr << "ERROR::STREAM_BUFFER:: Persistent mapping failed, falling back to orphaning" << std::endl;
+    }
+#endif
+    if (!persistent)
+    {
+        // immutable storage can not be orphaned, start over with a mutable buffer
+        glDeleteBuffers(1, &buffer);
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        glBufferData(target, this->regionSize, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(target, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync sync : fences)
+        if (sync)
+            glDeleteSync(sync);
+    if (persistent)
+    {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        glBindBuffer(target, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void *StreamBuffer::map(size_t size)
+{
+    waitTimeMs = 0.0f;
+    if (size > regionSize)
+    {
+        std::cerr << "ERROR::STREAM_BUFFER:: Write of " << size << " bytes exceeds the region size " << regionSize << std::endl;
+        return nullptr;
+    }
+    if (persistent)
+    {
+        if (fences[current])
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            GLenum result = glClientWaitSync(fences[current], 0, 0);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(fences[current]);
+            fences[current] = nullptr;
+            waitTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        return mapped + current * regionSize;
+    }
+    glBindBuffer(target, buffer);
+    glBufferData(target, regionSize, NULL, GL_STREAM_DRAW);
+    return glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+size_t StreamBuffer::unmap()
+{
+    if (persistent)
+        return current * regionSize;
+    glUnmapBuffer(target);
+    glBindBuffer(target, 0);
+    return 0;
+}
+
+void StreamBuffer::fence()
+{
+    if (!persistent)
+        return;
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % regions;
+}
+
+#endif
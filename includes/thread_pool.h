@@ -0,0 +1,117 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+#include "cpu_profiler.h"
+
+// Fixed set of worker threads for data-parallel loops that run every frame, so the per-frame
+// cost is a wake-up instead of a thread creation. parallelFor() splits [0, count) into chunks of
+// chunkSize and blocks until every chunk is done; the calling thread works on chunks too.
+//
+//   pool.parallelFor(count, 4096, [&](size_t begin, size_t end, size_t chunk) { ... });
+//
+// Chunk boundaries depend only on count and chunkSize, never on the number of threads, so a loop
+// that seeds its state from the chunk index gives the same result on every machine.
+class ThreadPool
+{
+public:
+    // threadCount 0: one thread per hardware thread (including the caller)
+    ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+    void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t, size_t)> &job);
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t, size_t, size_t)> *job;
+    size_t count, chunkSize, chunkCount, nextChunk, finishedChunks;
+    unsigned int generation;
+    bool quit;
+    void workerLoop();
+    // takes chunks until none are left, returns after finishing the last one it took
+    void runChunks(std::unique_lock<std::mutex> &lock);
+};
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : job(nullptr), count(0), chunkSize(1), chunkCount(0), nextChunk(0), finishedChunks(0), generation(0), quit(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 1; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t, size_t)> &job)
+{
+    if (count == 0)
+        return;
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    if (workers.empty() || chunks == 1)
+    {
+        for (size_t c = 0; c < chunks; ++c)
+            job(c * chunkSize, std::min(count, (c + 1) * chunkSize), c);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    this->job = &job;
+    this->count = count;
+    this->chunkSize = chunkSize;
+    chunkCount = chunks;
+    nextChunk = 0;
+    finishedChunks = 0;
+    ++generation;
+    wake.notify_all();
+    runChunks(lock);
+    done.wait(lock, [this] { return finishedChunks == chunkCount; });
+    this->job = nullptr;
+}
+
+void ThreadPool::runChunks(std::unique_lock<std::mutex> &lock)
+{
+    while (nextChunk < chunkCount)
+    {
+        size_t c = nextChunk++;
+        lock.unlock();
+        (*job)(c * chunkSize, std::min(count, (c + 1) * chunkSize), c);
+        lock.lock();
+        if (++finishedChunks == chunkCount)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    CPU_PROFILE_THREAD("thread pool");
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&] { return quit || generation != seen; });
+        if (quit)
+            return;
+        seen = generation;
+        if (job)
+            runChunks(lock);
+    }
+}
+
+#endif
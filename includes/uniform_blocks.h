@@ -0,0 +1,122 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "stream_buffer.h"
+
+#include <cstring>
+
+// C++ mirror of the std140 blocks in shaders/common/uniforms.glsl. vec3 members take 16 bytes,
+// the padding fields keep the offsets identical to what the GLSL compiler lays out.
+struct DirLightBlock {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient;   float pad1;
+    glm::vec3 diffuse;   float pad2;
+    glm::vec3 specular;  float pad3;
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad0[2];
+    glm::vec3 ambient;  float pad1;
+    glm::vec3 diffuse;  float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+const int MAX_POINT_LIGHTS = 4;
+
+struct FrameBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 invViewProjection;
+    glm::vec3 viewPos;
+    float gamma;
+    float time;
+    float pad0[3];
+};
+
+struct LightBlock {
+    glm::mat4 lightSpaceMatrix;
+    DirLightBlock dirLight;
+    PointLightBlock pointLights[MAX_POINT_LIGHTS];
+    int numPointLights;
+    float far_plane;
+    float pad0[2];
+};
+
+struct MaterialBlock {
+    float shininess;
+    float bumpScale;
+    float heightScale;
+    float pad0;
+};
+
+static_assert(sizeof(DirLightBlock) == 64, "DirLightBlock does not match std140");
+static_assert(sizeof(PointLightBlock) == 80, "PointLightBlock does not match std140");
+static_assert(sizeof(FrameBlock) == 224, "FrameBlock does not match std140");
+static_assert(sizeof(LightBlock) == 464, "LightBlock does not match std140");
+static_assert(sizeof(MaterialBlock) == 16, "MaterialBlock does not match std140");
+
+// Owns the storage of the shared blocks. Fill frame/lights/material, then upload() copies all
+// three into one region of a StreamBuffer and binds each block's range to the binding point
+// Shader assigned to it. Call endFrame() once the frame's draws are submitted.
+class UniformBlocks
+{
+public:
+    FrameBlock frame;
+    LightBlock lights;
+    MaterialBlock material;
+    UniformBlocks();
+    void upload();
+    void endFrame();
+    float waitTimeMs() const { return stream.waitTimeMs; }
+    bool persistent() const { return stream.persistent; }
+private:
+    size_t frameOffset, lightsOffset, materialOffset;
+    StreamBuffer stream;
+    static size_t align(size_t size);
+};
+
+size_t UniformBlocks::align(size_t size)
+{
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+UniformBlocks::UniformBlocks()
+    : frameOffset(0), lightsOffset(align(sizeof(FrameBlock))), materialOffset(lightsOffset + align(sizeof(LightBlock))),
+      stream(GL_UNIFORM_BUFFER, materialOffset + sizeof(MaterialBlock), 3, align(1))
+{
+    std::memset((void *)&frame, 0, sizeof(frame));
+    std::memset((void *)&lights, 0, sizeof(lights));
+    std::memset((void *)&material, 0, sizeof(material));
+}
+
+void UniformBlocks::upload()
+{
+    char *ptr = (char *)stream.map(materialOffset + sizeof(MaterialBlock));
+    if (!ptr)
+        return;
+    std::memcpy(ptr + frameOffset, &frame, sizeof(FrameBlock));
+    std::memcpy(ptr + lightsOffset, &lights, sizeof(LightBlock));
+    std::memcpy(ptr + materialOffset, &material, sizeof(MaterialBlock));
+    size_t offset = stream.unmap();
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK, stream.buffer, offset + frameOffset, sizeof(FrameBlock));
+    glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK, stream.buffer, offset + lightsOffset, sizeof(LightBlock));
+    glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK, stream.buffer, offset + materialOffset, sizeof(MaterialBlock));
+}
+
+void UniformBlocks::endFrame()
+{
+    stream.fence();
+}
+
+#endif
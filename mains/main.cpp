@@ -2,10 +2,27 @@
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "program_cache.h"
+#include "shader_batch.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
 #include "default_textures.h"
+#include "gbuffer.h"
+#include "render_target_pool.h"
+#include "dynamic_resolution.h"
+#include "light_clusters.h"
+#include "gpu_timer.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "uniform_blocks.h"
+#include "render_graph.h"
+#include "shader_variants.h"
+#include "shader_hot_reload.h"
+#include "headless_context.h"
+#include "frame_stats.h"
+#include "png_writer.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -20,6 +37,8 @@
 #include <cmath>
 #include <map>
 #include <vector>
+#include <random>
+#include <chrono>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -27,15 +46,20 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 unsigned int loadCubemap(std::vector<std::string> faces);
+void drawCpuFlameView();
 
 // settings
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 750;
 const unsigned int msaa = 8;
+// current framebuffer size, the screen-sized targets follow it at the start of the next frame
+unsigned int scrWidth = SCR_WIDTH;
+unsigned int scrHeight = SCR_HEIGHT;
+bool framebufferResized = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 2.0f, 3.0f));
@@ -54,37 +78,87 @@ bool interactWithUI = false;
 
 std::map<DefaultTextures::TextureType, unsigned int> DefaultTextures::textures;
 
-int main()
+int main(int argc, char **argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    if (!glfwInit())
+    auto startupBegin = std::chrono::high_resolution_clock::now();
+    CPU_PROFILE_THREAD("main");
+
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
+    // --headless renders without a window or display (EGL), along a camera path (--camera-path,
+    // camera_paths/nave.path by default), and prints frame time statistics, for benchmarks on CI machines.
+    //   --frames N          renders at most N frames (the whole path)
+    //   --capture DIR       writes every --capture-every-th frame (60) to DIR/frame_NNNN.png
+    //   --frame-times FILE  writes the time of every frame as csv
+    bool headless = false;
+    unsigned int headlessFrames = 0, captureEvery = 60;
+    std::string captureDir, frameTimesPath;
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Failed to initialize GLFW!" << std::endl;
-        return -1;
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--frames" && hasValue)
+            headlessFrames = std::stoul(argv[++i]);
+        else if (arg == "--capture" && hasValue)
+            captureDir = argv[++i];
+        else if (arg == "--capture-every" && hasValue)
+            captureEvery = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg == "--frame-times" && hasValue)
+            frameTimesPath = argv[++i];
+    }
+
+    GLFWwindow *window = nullptr;
+    HeadlessContext headlessContext;
+    if (headless)
+    {
+        if (!cameraPath.playing() && !cameraPath.play("nave"))
+            return -1;
+        // the frames are timed here, GPU work included
+        cameraPath.measureFrames = false;
+        // the pbuffer stands in for the window's framebuffer
+        if (!headlessContext.create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    // glfwWindowHint(GLFW_DECORATED, GL_FALSE);
+    else
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        if (!glfwInit())
+        {
+            std::cerr << "Failed to initialize GLFW!" << std::endl;
+            return -1;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // glfwWindowHint(GLFW_DECORATED, GL_FALSE);
 #ifdef __APPLE
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-    glfwWindowHint(GLFW_SAMPLES, 8);
+        glfwWindowHint(GLFW_SAMPLES, 8);
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
-    if (window == nullptr)
-    {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        exit(-1);
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", nullptr, nullptr);
+        if (window == nullptr)
+        {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            exit(-1);
+        }
+        glfwMakeContextCurrent(window);
+        // the framebuffer can be larger than the window on high dpi screens
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        scrWidth = framebufferWidth;
+        scrHeight = framebufferHeight;
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
 
     // imgui initialization
     // --------------------
@@ -92,7 +166,7 @@ int main()
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader(headless ? (GLADloadproc)HeadlessContext::getProcAddress : (GLADloadproc)glfwGetProcAddress))
     {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
@@ -107,19 +181,46 @@ int main()
     glEnable(GL_MULTISAMPLE);
 
     /***** create viewport *****/
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    glViewport(0, 0, scrWidth, scrHeight);
 
-    // build and compile shader
+    // build and compile shader, programs linked before are loaded from their cached binaries
+    // unless --no-shader-cache is given. The batch is submitted here and finished after the
+    // models are loaded, the driver compiles meanwhile. The lit shaders have a variant per
+    // material (common/material.glsl), added once the model's materials are known.
+    // --optimized-shaders reads the copies the validate_shaders build target optimized.
     // ------------------------
-    Shader blinnShader(CMAKE_SOURCE_DIR"/shaders/vert.glsl", CMAKE_SOURCE_DIR"/shaders/frag.glsl");
-    Shader screenShader(CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl", CMAKE_SOURCE_DIR"/shaders/post_processing/screen_frag.glsl");
-    Shader dirDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_vert.glsl",
-                          CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_frag.glsl");
-    Shader pointDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_vert.glsl",
-                            CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_frag.glsl",
-                            CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_geo.glsl");
-    // Shader secondDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_vert.glsl", CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_frag.glsl");
-    blinnShader.use();
+    bool useShaderCache = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--no-shader-cache")
+            useShaderCache = false;
+        if (std::string(argv[i]) == "--optimized-shaders")
+            ShaderPreprocessor::usePrepared(CMAKE_SOURCE_DIR"/shaders", CMAKE_BINARY_DIR"/shaders");
+    }
+    ProgramCache programCache(CMAKE_BINARY_DIR"/shader_cache");
+    if (useShaderCache)
+        ProgramCache::current() = &programCache;
+    // shader compilation at startup, light cluster assignment every frame
+    ThreadPool threads;
+    ShaderBatch shaderBatch(threads);
+    ShaderVariants forwardShaders(CMAKE_SOURCE_DIR"/shaders/vert.glsl", CMAKE_SOURCE_DIR"/shaders/frag.glsl");
+    ShaderVariants gbufferShaders(CMAKE_SOURCE_DIR"/shaders/deferred/gbuffer_vert.glsl", CMAKE_SOURCE_DIR"/shaders/deferred/gbuffer_frag.glsl");
+    Shader dirDepthShader, pointDepthShader, deferredDirShader, deferredPointShader;
+    Shader stencilShader, prepassShader, depthViewShader;
+    shaderBatch.add(dirDepthShader, CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_vert.glsl",
+                    CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_frag.glsl");
+    shaderBatch.add(pointDepthShader, CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_vert.glsl",
+                    CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_frag.glsl",
+                    CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_geo.glsl");
+    shaderBatch.add(deferredDirShader, CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl", CMAKE_SOURCE_DIR"/shaders/deferred/light_dir_frag.glsl");
+    shaderBatch.add(deferredPointShader, CMAKE_SOURCE_DIR"/shaders/deferred/light_volume_vert.glsl", CMAKE_SOURCE_DIR"/shaders/deferred/light_point_frag.glsl");
+    shaderBatch.add(stencilShader, CMAKE_SOURCE_DIR"/shaders/deferred/light_volume_vert.glsl", CMAKE_SOURCE_DIR"/shaders/deferred/stencil_frag.glsl");
+    shaderBatch.add(prepassShader, CMAKE_SOURCE_DIR"/shaders/depth_prepass_vert.glsl", CMAKE_SOURCE_DIR"/shaders/depth_prepass_frag.glsl");
+    shaderBatch.add(depthViewShader, CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_vert.glsl", CMAKE_SOURCE_DIR"/shaders/depth_texture_frag.glsl");
+    shaderBatch.submit();
+
+    // per-frame, per-light and per-material data shared by every shader that includes common/uniforms.glsl
+    UniformBlocks uniforms;
 
     DefaultTextures::init();
 
@@ -135,6 +236,27 @@ int main()
     };
 
     Model sponza = Model(CMAKE_SOURCE_DIR"/resources/objects/sponza/sponza.obj");
+    // only the part of the compile that model loading did not hide is waited for here
+    bool shadersReadyAfterLoading = shaderBatch.ready();
+    // forward variants with and without shadows and a g-buffer variant for every material
+    for (const ShaderDefines &material : sponza.variantDefines())
+    {
+        ShaderDefines shadowed = material;
+        shadowed["SHADOWS"] = "";
+        forwardShaders.get(material, &shaderBatch);
+        forwardShaders.get(shadowed, &shaderBatch);
+        gbufferShaders.get(material, &shaderBatch);
+    }
+    shaderBatch.submit();
+    shaderBatch.finish();
+    float shadersMs = shaderBatch.submitMs + shaderBatch.finishMs;
+    // saving a shader (or a file it includes) rebuilds the programs using it while running
+    ShaderHotReload shaderReload;
+    shaderReload.watch(forwardShaders);
+    shaderReload.watch(gbufferShaders);
+    for (Shader *shader : { &dirDepthShader, &pointDepthShader, &deferredDirShader, &deferredPointShader,
+                            &stencilShader, &prepassShader, &depthViewShader })
+        shaderReload.watch(*shader);
 
     // setup screen VAO
     unsigned int quadVAO, quadVBO;
@@ -148,44 +270,46 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     
+    // every screen-sized target comes from the pool and is swapped for a new one when the window is resized
+    RenderTargetPool renderTargets;
+    // the scene renders at renderWidth x renderHeight, a fraction of the screen with dynamic resolution
+    unsigned int renderWidth = scrWidth, renderHeight = scrHeight;
+    int sceneColorTarget = -1, sceneDepthStencilTarget = -1, sceneDepthTarget = -1;
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    unsigned int textureColorBufferMultiSampled;
-    glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, msaa, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0);
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    // configure second post-processing framebuffer
-    unsigned int intermediateFBO;
-    glGenFramebuffers(1, &intermediateFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
-    // create a color attachment texture
-    unsigned int screenTexture;
-    glGenTextures(1, &screenTexture);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTexture, 0);	// we only need a color buffer
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "ERROR::FRAMEBUFFER:: Intermediate framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // single sample copy of the forward depth prepass, so later passes (Hi-Z, SSAO, fog) can sample it
+    unsigned int depthResolveFBO;
+    glGenFramebuffers(1, &depthResolveFBO);
+    unsigned int sceneDepth = 0;
+    auto acquireScreenTargets = [&]() {
+        if (sceneColorTarget >= 0)
+        {
+            renderTargets.release(sceneColorTarget);
+            renderTargets.release(sceneDepthStencilTarget);
+            renderTargets.release(sceneDepthTarget);
+        }
+        // linear HDR radiance, the post-processing graph tonemaps and gamma encodes it
+        sceneColorTarget = renderTargets.acquire(RenderTargetDesc(GL_RGBA16F, renderWidth, renderHeight, msaa));
+        sceneDepthStencilTarget = renderTargets.acquire(RenderTargetDesc(GL_DEPTH24_STENCIL8, renderWidth, renderHeight, msaa));
+        sceneDepthTarget = renderTargets.acquire(RenderTargetDesc(GL_DEPTH24_STENCIL8, renderWidth, renderHeight), GL_NEAREST);
+        sceneDepth = renderTargets.texture(sceneDepthTarget);
 
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, renderTargets.texture(sceneColorTarget), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D_MULTISAMPLE, renderTargets.texture(sceneDepthStencilTarget), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, depthResolveFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::FRAMEBUFFER:: Depth resolve framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
+    acquireScreenTargets();
+    
     unsigned int depthMapFBO;
     glGenFramebuffers(1, &depthMapFBO);
 
@@ -228,6 +352,35 @@ int main()
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // per-pass breakdown for the UI, the frame timer drives the dynamic resolution
+    GpuProfiler profiler;
+    GpuFrameTimer frameTimer;
+
+    // deferred shading targets, no msaa here: the lighting passes run once per pixel
+    GBuffer gbuffer(renderTargets, renderWidth, renderHeight);
+    LightVolume lightVolume;
+
+    // post-processing from the linear scene color to the screen, rebuilt when a stage is toggled
+    RenderGraph postGraph(renderTargets, scrWidth, scrHeight, CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl");
+    int postGraphKey = -1;
+
+    // clustered dynamic point lights, scattered through the sponza atrium and animated on small orbits
+    const unsigned int MAX_DYNAMIC_LIGHTS = 4096;
+    LightClusters lightClusters(threads);
+    std::vector<ClusterLight> dynamicLights;
+    std::vector<glm::vec4> dynamicLightOrbits; // center.xyz, phase
+    std::vector<glm::vec3> dynamicLightColors;
+    {
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (unsigned int i = 0; i < MAX_DYNAMIC_LIGHTS; ++i)
+        {
+            glm::vec3 center(-60.0f + 120.0f * unit(rng), 0.5f + 12.0f * unit(rng), -25.0f + 50.0f * unit(rng));
+            dynamicLightOrbits.push_back(glm::vec4(center, 6.2831853f * unit(rng)));
+            dynamicLightColors.push_back(glm::vec3(unit(rng), unit(rng), unit(rng)));
+        }
+    }
+
     // transform properties
     float imgui_background_alpha = 0.5f;
 
@@ -256,28 +409,97 @@ int main()
     float offsetScale = 0.005f;
     float offsetFreq = 20.0f;
     float gamma = 2.2f;
-
+    bool bloom = false;
+    float bloomThreshold = 1.0f;
+    float bloomStrength = 0.5f;
+    bool tonemap = false;
+    float exposure = 1.0f;
+    bool vignette = false;
+    float vignetteStrength = 0.5f;
+    bool fusePasses = true;
+    // rendering
+    const char *renderModes[] = { "Forward", "Deferred" };
+    int renderMode = 0;
+    bool showNormals = false;
+    int numDynamicLights = 0;
+    float dynamicLightRadius = 4.0f;
+    float dynamicLightIntensity = 2.0f;
+    bool animateLights = true;
+    bool depthPrepass = false;
+    const char *prepassDepthFuncs[] = { "GL_LEQUAL", "GL_EQUAL" };
+    int prepassDepthFunc = 0;
+    bool showSceneDepth = false;
+    // forward only: off skips the shadow maps and draws the variants without shadow lookups
+    bool shadows = true;
+    bool dynamicResolution = false;
+    DynamicResolution resolution;
+    // --resolution-log <file.csv>: turns dynamic resolution on and logs its per-frame GPU time and scale
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--resolution-log" && resolution.openLog(argv[i + 1]))
+            dynamicResolution = true;
+    }
+    
+    // startup: from main() to the end of the first frame, which also links the post-processing programs
+    float startupMs = 0.0f;
     
+    unsigned int headlessFrame = 0;
+    FrameStats frameStats;
+
     /***** render loop *****/
-    while(!glfwWindowShouldClose(window))
+    while(headless ? !cameraPath.finished() && (headlessFrames == 0 || headlessFrame < headlessFrames) : !glfwWindowShouldClose(window))
     {
+        CPU_PROFILE_FRAME();
+        auto frameBegin = std::chrono::high_resolution_clock::now();
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(headless ? 0.0f : glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished() && !headless)
+            glfwSetWindowShouldClose(window, true);
+        shaderReload.update();
+
+        // dynamic resolution follows the GPU time of the previous frames
+        if (!dynamicResolution)
+            resolution.reset();
+        else if (frameTimer.samples > 0)
+            resolution.update(frameTimer.elapsedMs);
+
+        // a resize only takes effect here, once per frame however many events arrived
+        if (framebufferResized || resolution.scaled(scrWidth) != renderWidth || resolution.scaled(scrHeight) != renderHeight)
+        {
+            renderWidth = resolution.scaled(scrWidth);
+            renderHeight = resolution.scaled(scrHeight);
+            acquireScreenTargets();
+            gbuffer.resize(renderWidth, renderHeight);
+            postGraph.resize(scrWidth, scrHeight);
+            postGraphKey = -1;
+            framebufferResized = false;
+        }
 
         // imgui loop start
+        CPU_PROFILE_PUSH("ImGui build");
         ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+        if (headless)
+        {
+            // what the GLFW backend sets every frame
+            ImGuiIO &io = ImGui::GetIO();
+            io.DisplaySize = ImVec2((float)scrWidth, (float)scrHeight);
+            io.DeltaTime = cameraPath.timestep;
+        }
+        else
+            ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         ImGuiStyle &style = ImGui::GetStyle();
         style.Colors[ImGuiCol_WindowBg].w = imgui_background_alpha;
 
         // imgui draw guis
         ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Appearing);
-        ImGui::SetNextWindowSize(ImVec2(250, SCR_HEIGHT), ImGuiCond_Appearing);
+        ImGui::SetNextWindowSize(ImVec2(250, scrHeight), ImGuiCond_Appearing);
         ImGui::Begin("Properties"); // Create a window and append into it.
         ImGui::Text("Material");
         ImGui::SliderFloat("ratio", &ratio, 1.0f, 2.0f);
@@ -317,8 +539,95 @@ int main()
         ImGui::DragFloat("offsetScale", &offsetScale, 0.001f);
         ImGui::DragFloat("offsetFreq", &offsetFreq, 0.1f);
         ImGui::SliderFloat("gamma", &gamma, 1.0f, 3.0f);
+        ImGui::Checkbox("bloom", &bloom);
+        ImGui::SliderFloat("bloomThreshold", &bloomThreshold, 0.0f, 4.0f);
+        ImGui::SliderFloat("bloomStrength", &bloomStrength, 0.0f, 2.0f);
+        ImGui::Checkbox("tonemap", &tonemap);
+        ImGui::SliderFloat("exposure", &exposure, 0.1f, 8.0f);
+        ImGui::Checkbox("vignette", &vignette);
+        ImGui::SliderFloat("vignetteStrength", &vignetteStrength, 0.0f, 2.0f);
+        ImGui::Checkbox("fusePasses", &fusePasses);
+        ImGui::Text("%u of %u passes, %u of %u textures", postGraph.stats.executedPasses, postGraph.stats.declaredPasses,
+                    postGraph.stats.physicalTextures, postGraph.stats.declaredTextures);
+        ImGui::Text("%.1f of %.1f MB", postGraph.stats.physicalBytes / 1048576.0f, postGraph.stats.declaredBytes / 1048576.0f);
+        for (const std::string &pass : postGraph.schedule())
+            ImGui::BulletText("%s", pass.c_str());
+        ImGui::Text("Rendering");
+        ImGui::Combo("renderMode", &renderMode, renderModes, IM_ARRAYSIZE(renderModes));
+        ImGui::Checkbox("showNormals", &showNormals);
+        ImGui::Text("Dynamic Lights (forward)");
+        ImGui::SliderInt("numLights", &numDynamicLights, 0, MAX_DYNAMIC_LIGHTS);
+        ImGui::SliderFloat("lightRadius", &dynamicLightRadius, 0.5f, 20.0f);
+        ImGui::SliderFloat("lightIntensity", &dynamicLightIntensity, 0.0f, 10.0f);
+        ImGui::Checkbox("animateLights", &animateLights);
+        ImGui::Text("culling %.2f ms, %u indices", lightClusters.updateTimeMs, lightClusters.indexCount);
+        ImGui::Text("Depth Prepass");
+        ImGui::Checkbox("depthPrepass", &depthPrepass);
+        ImGui::Combo("depthFunc", &prepassDepthFunc, prepassDepthFuncs, IM_ARRAYSIZE(prepassDepthFuncs));
+        ImGui::Checkbox("showSceneDepth", &showSceneDepth);
+        ImGui::Checkbox("shadows", &shadows);
+        ImGui::Text("variants: %zu forward, %zu g-buffer", forwardShaders.size(), gbufferShaders.size());
+        ImGui::Text("Dynamic Resolution");
+        ImGui::Checkbox("dynamicResolution", &dynamicResolution);
+        ImGui::SliderFloat("targetFrameMs", &resolution.targetMs, 4.0f, 50.0f);
+        ImGui::Text("gpu frame %.2f ms, scale %.2f", frameTimer.elapsedMs, resolution.scale);
+        ImGui::Text("Render Targets");
+        RenderTargetPool::Usage targetUsage = renderTargets.usage();
+        ImGui::Text("%u x %u -> %u x %u", renderWidth, renderHeight, scrWidth, scrHeight);
+        ImGui::Text("%u targets, %u in use", targetUsage.targets, targetUsage.inUse);
+        ImGui::Text("%.1f MB, %.1f MB in use", targetUsage.bytes / 1048576.0f, targetUsage.inUseBytes / 1048576.0f);
+        for (const std::string &target : renderTargets.report())
+            ImGui::BulletText("%s", target.c_str());
+        ImGui::Text("Shader Cache");
+        ImGui::Text("%s, %u hits, %u misses", !useShaderCache ? "off" : programCache.enabled ? "on" : "unsupported",
+                    programCache.hits, programCache.misses);
+        ImGui::Text("shaders %.1f ms blocking, startup %.1f ms", shadersMs, startupMs);
+        ImGui::Text("%s compile, %s after loading", shaderBatch.parallel ? "parallel" : "serial",
+                    shadersReadyAfterLoading ? "ready" : "not ready");
+        ImGui::Text("Hot Reload");
+        ImGui::Text("%zu programs, %s", shaderReload.size(), shaderReload.inotify ? "inotify" : "polling");
+        ImGui::Text("%u reloads, %u failed, last %.1f ms", shaderReload.reloads, shaderReload.failures, shaderReload.lastReloadMs);
+        ImGui::Text("GPU Profiler");
+        ImGui::Text("frame %.2f ms avg, %.2f ms max", profiler.frame().averageMs, profiler.frame().maxMs);
+        for (const GpuProfiler::Pass &pass : profiler.passes())
+        {
+            // passes of the other render mode or of disabled effects
+            if (!pass.active)
+                continue;
+            ImGui::Text("%*s%s %.2f ms avg, %.2f max", (int)(2 * pass.depth), "", pass.name.c_str(), pass.averageMs, pass.maxMs);
+            ImGui::PlotHistogram(("##" + pass.path).c_str(), pass.history.data(), (int)pass.history.size(), pass.historyOffset,
+                                 nullptr, 0.0f, profiler.frame().maxMs, ImVec2(0, 30));
+        }
+        ImGui::Text("%u frames, %u dropped", profiler.frames, profiler.dropped);
+        ImGui::Text("%.2f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::End();
+#ifdef CPU_PROFILER
+        ImGui::SetNextWindowPos(ImVec2(260, 0), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(600, 250), ImGuiCond_FirstUseEver);
+        ImGui::Begin("CPU Profiler");
+        CpuProfiler &cpuProfiler = CpuProfiler::instance();
+        bool cpuProfiling = cpuProfiler.enabled;
+        // off keeps the last recorded frame on screen
+        if (ImGui::Checkbox("record", &cpuProfiling))
+            cpuProfiler.enabled = cpuProfiling;
+        ImGui::SameLine();
+        if (ImGui::Button("export trace"))
+        {
+            const std::string tracePath = CMAKE_BINARY_DIR"/cpu_trace.json";
+            if (cpuProfiler.writeChromeTrace(tracePath))
+                std::cout << "CPU_PROFILER:: trace written to " << tracePath << std::endl;
+            else
+                std::cerr << "ERROR::CPU_PROFILER:: Could not write " << tracePath << std::endl;
+        }
+        ImGui::SameLine();
+        ImGui::Text("frame %.2f ms", (cpuProfiler.frameEnd() - cpuProfiler.frameStart()) / 1e6f);
+        drawCpuFlameView();
+        ImGui::End();
+#endif
+        CPU_PROFILE_POP();
 
+        frameTimer.begin();
+        profiler.beginFrame();
         glm::mat4 model = glm::mat4(1.0f), normalMatrix;
         // shadow mapping settings
         float point_near_plane = 1.0f, point_far_plane = 100.0f;
@@ -333,154 +642,453 @@ int main()
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0,  1.0), glm::vec3(0.0, -1.0,  0.0)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
 
-        pointDepthShader.use();
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        pointDepthShader.setFloat("far_plane", point_far_plane);
-        pointDepthShader.setVec3("lightPos", glm::value_ptr(lightPos));
-        pointDepthShader.setMat4("shadowMatrices[0]", glm::value_ptr(shadowTransforms[0]));
-        pointDepthShader.setMat4("shadowMatrices[1]", glm::value_ptr(shadowTransforms[1]));
-        pointDepthShader.setMat4("shadowMatrices[2]", glm::value_ptr(shadowTransforms[2]));
-        pointDepthShader.setMat4("shadowMatrices[3]", glm::value_ptr(shadowTransforms[3]));
-        pointDepthShader.setMat4("shadowMatrices[4]", glm::value_ptr(shadowTransforms[4]));
-        pointDepthShader.setMat4("shadowMatrices[5]", glm::value_ptr(shadowTransforms[5]));
+        // the deferred directional light always samples the shadow maps
+        bool renderShadowMaps = shadows || renderMode == 1;
+        if (renderShadowMaps)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            sponza.Draw(pointDepthShader);
+            GpuProfiler::Scope scope(profiler, "point shadow");
+            CPU_PROFILE_SCOPE("point shadow");
+            pointDepthShader.use();
+            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            pointDepthShader.setFloat("far_plane", point_far_plane);
+            pointDepthShader.setVec3("lightPos", glm::value_ptr(lightPos));
+            pointDepthShader.setMat4("shadowMatrices[0]", glm::value_ptr(shadowTransforms[0]));
+            pointDepthShader.setMat4("shadowMatrices[1]", glm::value_ptr(shadowTransforms[1]));
+            pointDepthShader.setMat4("shadowMatrices[2]", glm::value_ptr(shadowTransforms[2]));
+            pointDepthShader.setMat4("shadowMatrices[3]", glm::value_ptr(shadowTransforms[3]));
+            pointDepthShader.setMat4("shadowMatrices[4]", glm::value_ptr(shadowTransforms[4]));
+            pointDepthShader.setMat4("shadowMatrices[5]", glm::value_ptr(shadowTransforms[5]));
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scale));
+                pointDepthShader.setMat4("model", glm::value_ptr(model));
+                sponza.DrawDepth();
+            }
+            glViewport(0, 0, renderWidth, renderHeight);
         }
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
         float dir_near_plane = 1.0f, dir_far_plane = 100.0f;
         glm::mat4 lightProjection = glm::ortho(-20.0f, 20.0f, -20.0f, 20.0f, dir_near_plane, dir_far_plane);
         glm::mat4 lightView = glm::lookAt(-20.0f * glm::normalize(lightDir), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
         glm::mat4 lightSpaceMatrix = lightProjection * lightView;
 
-        dirDepthShader.use();
-        dirDepthShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        if (renderShadowMaps)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            sponza.Draw(dirDepthShader);
+            GpuProfiler::Scope scope(profiler, "dir shadow");
+            CPU_PROFILE_SCOPE("dir shadow");
+            dirDepthShader.use();
+            dirDepthShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
+            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scale));
+                dirDepthShader.setMat4("model", glm::value_ptr(model));
+                sponza.DrawDepth();
+            }
+            glViewport(0, 0, renderWidth, renderHeight);
         }
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
 
-        // render
-        // ------
-        // pass 1
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClearColor(clearColor.x, clearColor.y, clearColor.z, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
         // create transformations
         glm::mat4 view          = glm::mat4(1.0f);
         glm::mat4 projection    = glm::mat4(1.0f);
         view = camera.GetViewMatrix();
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / SCR_HEIGHT, near, far);
-
-        blinnShader.use();
-
-        blinnShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
-        blinnShader.setFloat("far_plane", point_far_plane);
-        blinnShader.setFloat("bumpScale", bumpScale);
-        blinnShader.setFloat("heightScale", heightScale);
-
-        blinnShader.setFloat("gamma", gamma);
-        blinnShader.setMat4("view", glm::value_ptr(view));
-        blinnShader.setMat4("projection", glm::value_ptr(projection));
-        blinnShader.setFloat("material.shininess", shininess);
-        blinnShader.setVec3("viewPos",  glm::value_ptr(camera.Position));
-
-        // directional light
-        blinnShader.setVec3("dirLight.direction", glm::value_ptr(lightDir));
-        blinnShader.setVec3("dirLight.ambient", glm::value_ptr(lightAmbient));
-        blinnShader.setVec3("dirLight.diffuse", glm::value_ptr(lightDiffuse));
-        blinnShader.setVec3("dirLight.specular", glm::value_ptr(lightSpecular));
-        // point light 1
-        blinnShader.setVec3("pointLights[0].position", glm::value_ptr(pointLightPositions[0]));
-        blinnShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        blinnShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        blinnShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        blinnShader.setFloat("pointLights[0].constant", lightAttenuation.x);
-        blinnShader.setFloat("pointLights[0].linear", lightAttenuation.y);
-        blinnShader.setFloat("pointLights[0].quadratic", lightAttenuation.z);
-
-        blinnShader.setInt("material.texture_diffuse1", 0);
-        blinnShader.setInt("material.texture_specular1", 1);
-        blinnShader.setInt("material.texture_reflect1", 2);
-        blinnShader.setInt("material.texture_normal1", 3);
-        blinnShader.setInt("material.texture_height1", 4);
-        blinnShader.setInt("dirShadowMap", 5);
-        blinnShader.setInt("pointShadowMap", 6);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        glActiveTexture(GL_TEXTURE6);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+        projection = glm::perspective(glm::radians(camera.Zoom), (float)scrWidth / scrHeight, near, far);
+
+        // shared uniform blocks, written once for all passes of this frame
+        uniforms.frame.projection = projection;
+        uniforms.frame.view = view;
+        uniforms.frame.invViewProjection = glm::inverse(projection * view);
+        uniforms.frame.viewPos = camera.Position;
+        uniforms.frame.gamma = gamma;
+        uniforms.frame.time = currentTime;
+        uniforms.lights.lightSpaceMatrix = lightSpaceMatrix;
+        uniforms.lights.dirLight.direction = lightDir;
+        uniforms.lights.dirLight.ambient = lightAmbient;
+        uniforms.lights.dirLight.diffuse = lightDiffuse;
+        uniforms.lights.dirLight.specular = lightSpecular;
+        uniforms.lights.numPointLights = 1;
+        uniforms.lights.far_plane = point_far_plane;
+        for (int i = 0; i < uniforms.lights.numPointLights; i++)
+        {
+            PointLightBlock &light = uniforms.lights.pointLights[i];
+            light.position = pointLightPositions[i];
+            light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+            light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+            light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+            light.constant = lightAttenuation.x;
+            light.linear = lightAttenuation.y;
+            light.quadratic = lightAttenuation.z;
+        }
+        uniforms.material.shininess = shininess;
+        uniforms.material.bumpScale = bumpScale;
+        uniforms.material.heightScale = heightScale;
+        uniforms.upload();
+
+        // lays down the final depth with positions only, the shading pass after it only
+        // runs for the visible fragment of every pixel and leaves the depth buffer untouched
+        auto drawDepthPrepass = [&]()
         {
+            GpuProfiler::Scope scope(profiler, "prepass");
+            CPU_PROFILE_SCOPE("prepass");
+            prepassShader.use();
             model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
             model = glm::scale(model, glm::vec3(scale));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            sponza.Draw(blinnShader);
-        }
+            prepassShader.setMat4("model", glm::value_ptr(model));
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            sponza.DrawDepth();
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        };
+        auto beginShadingPass = [&]()
+        {
+            if (depthPrepass)
+            {
+                glDepthFunc(prepassDepthFunc == 1 ? GL_EQUAL : GL_LEQUAL);
+                glDepthMask(GL_FALSE);
+            }
+            profiler.push(renderMode == 1 ? "g-buffer" : "forward");
+        };
+        auto endShadingPass = [&]()
+        {
+            profiler.pop();
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        };
 
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
-        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        // render
+        // ------
+        if (renderMode == 1)
+        {
+            // geometry pass: only material attributes are written, no lighting
+            gbuffer.bindGeometry();
+            glDisable(GL_BLEND);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            if (depthPrepass)
+                drawDepthPrepass();
+
+            beginShadingPass();
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scale));
+                normalMatrix = glm::transpose(glm::inverse(model));
+                sponza.Draw(gbufferShaders, ShaderDefines(), [&](Shader &shader) {
+                    shader.setMat4("model", glm::value_ptr(model));
+                    shader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
+                });
+            }
+            endShadingPass();
+
+            // lighting pass 1: ambient + shadowed directional light over the whole screen
+            profiler.push("dir light");
+            gbuffer.bindLighting();
+            glDisable(GL_DEPTH_TEST);
+            gbuffer.bindTextures(0);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, depthMap);
+            deferredDirShader.use();
+            deferredDirShader.setInt("gNormalShininess", 0);
+            deferredDirShader.setInt("gAlbedoSpec", 1);
+            deferredDirShader.setInt("gDepth", 2);
+            deferredDirShader.setInt("dirShadowMap", 3);
+            deferredDirShader.setVec3("clearColor", glm::value_ptr(clearColor));
+            deferredDirShader.setBool("showNormals", showNormals);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            profiler.pop();
+
+            // lighting pass 2: point lights, each one limited to the pixels inside its volume.
+            // The stencil pass counts back faces behind the scene minus front faces behind the scene,
+            // which is non-zero exactly where the g-buffer surface lies inside the sphere.
+            if (!showNormals)
+            {
+                GpuProfiler::Scope scope(profiler, "point lights");
+                glEnable(GL_STENCIL_TEST);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE);
+                glDepthMask(GL_FALSE);
+                glActiveTexture(GL_TEXTURE3);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+                deferredPointShader.use();
+                deferredPointShader.setInt("gNormalShininess", 0);
+                deferredPointShader.setInt("gAlbedoSpec", 1);
+                deferredPointShader.setInt("gDepth", 2);
+                deferredPointShader.setInt("pointShadowMap", 3);
+                deferredPointShader.setVec2("screenSize", (float)renderWidth, (float)renderHeight);
+                for (int i = 0; i < uniforms.lights.numPointLights; i++)
+                {
+                    float radius = pointLightRadius(lightAttenuation.x, lightAttenuation.y, lightAttenuation.z, 1.0f);
+                    model = glm::mat4(1.0f);
+                    model = glm::translate(model, pointLightPositions[i]);
+                    model = glm::scale(model, glm::vec3(radius));
+
+                    stencilShader.use();
+                    stencilShader.setMat4("model", glm::value_ptr(model));
+                    glEnable(GL_DEPTH_TEST);
+                    glDisable(GL_CULL_FACE);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    glClear(GL_STENCIL_BUFFER_BIT);
+                    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+                    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+                    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+                    lightVolume.Draw();
+
+                    // back faces only, so the volume still shades when the camera is inside it
+                    deferredPointShader.use();
+                    deferredPointShader.setMat4("model", glm::value_ptr(model));
+                    deferredPointShader.setInt("lightIndex", i);
+                    deferredPointShader.setBool("castShadows", i == 0);
+                    glDisable(GL_DEPTH_TEST);
+                    glEnable(GL_CULL_FACE);
+                    glCullFace(GL_FRONT);
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+                    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+                    lightVolume.Draw();
+                }
+                glCullFace(GL_BACK);
+                glDisable(GL_CULL_FACE);
+                glDisable(GL_STENCIL_TEST);
+                glDepthMask(GL_TRUE);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            glEnable(GL_BLEND);
+        }
+        else
+        {
+            // assign the dynamic lights to clusters for this frame's camera
+            float lightTime = animateLights ? currentTime : 0.0f;
+            dynamicLights.resize(numDynamicLights);
+            for (int i = 0; i < numDynamicLights; i++)
+            {
+                glm::vec4 orbit = dynamicLightOrbits[i];
+                float angle = orbit.w + lightTime * (0.5f + 0.1f * (i % 7));
+                dynamicLights[i].position = glm::vec3(orbit) + glm::vec3(2.0f * std::cos(angle), 0.5f * std::sin(2.0f * angle), 2.0f * std::sin(angle));
+                dynamicLights[i].radius = dynamicLightRadius;
+                dynamicLights[i].color = dynamicLightColors[i] * dynamicLightIntensity;
+                dynamicLights[i].padding = 0.0f;
+            }
+            lightClusters.update(dynamicLights, view, glm::radians(camera.Zoom), (float)scrWidth / scrHeight, near, far);
+
+            // pass 1
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            // the target holds linear radiance, the clear color is picked as it shows on screen
+            glm::vec3 linearClearColor = glm::pow(clearColor, glm::vec3(gamma));
+            glClearColor(linearClearColor.x, linearClearColor.y, linearClearColor.z, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            if (depthPrepass)
+            {
+                drawDepthPrepass();
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthResolveFBO);
+                glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            }
+
+            beginShadingPass();
+            // material textures take units 0-4 in Mesh::Draw
+            glActiveTexture(GL_TEXTURE5);
+            glBindTexture(GL_TEXTURE_2D, depthMap);
+            glActiveTexture(GL_TEXTURE6);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scale));
+                normalMatrix = glm::transpose(glm::inverse(model));
+                ShaderDefines frameDefines;
+                if (shadows)
+                    frameDefines["SHADOWS"] = "";
+                sponza.Draw(forwardShaders, frameDefines, [&](Shader &shader) {
+                    shader.setBool("showNormals", showNormals);
+                    shader.setInt("dirShadowMap", 5);
+                    shader.setInt("pointShadowMap", 6);
+                    lightClusters.bind(shader, 7, renderWidth, renderHeight);
+                    shader.setMat4("model", glm::value_ptr(model));
+                    shader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
+                });
+            }
+            endShadingPass();
+        }
 
+        // post-processing: both paths leave linear radiance, the forward one still multisampled
+        int graphKey = renderMode | postProcessing << 1 | bloom << 2 | tonemap << 3 | vignette << 4 | fusePasses << 5;
+        if (graphKey != postGraphKey)
+        {
+            const std::string stages = CMAKE_SOURCE_DIR"/shaders/post_processing/stages/";
+            postGraph.reset();
+            // everything up to the tonemap runs at the render resolution, the upscale brings it to the screen's
+            RenderGraphTextureDesc scene(GL_RGBA16F, resolution.scale);
+            RenderGraph::Resource color;
+            if (renderMode == 1)
+                color = postGraph.importTexture("light accumulation", gbuffer.lightAccumulation, renderWidth, renderHeight);
+            else
+            {
+                color = postGraph.createTexture("scene", scene);
+                postGraph.addResolvePass("msaa resolve", framebuffer, color);
+            }
+            if (postProcessing)
+            {
+                RenderGraph::Resource waved = postGraph.createTexture("wave", scene);
+                postGraph.addPass("wave", stages + "wave.glsl", "wave", { { "waveSource", color } }, waved, [&](Shader &shader) {
+                    shader.setFloat("waveScale", offsetScale);
+                    shader.setFloat("waveFrequency", offsetFreq);
+                });
+                color = waved;
+            }
+            if (bloom)
+            {
+                RenderGraphTextureDesc half(GL_RGBA16F, 0.5f * resolution.scale);
+                RenderGraph::Resource bright = postGraph.createTexture("bright", half);
+                RenderGraph::Resource blurX = postGraph.createTexture("blur x", half);
+                RenderGraph::Resource blurY = postGraph.createTexture("blur y", half);
+                RenderGraph::Resource bloomed = postGraph.createTexture("bloom", scene);
+                postGraph.addPass("bright", stages + "bright.glsl", "bright", { { "brightSource", color } }, bright,
+                                  [&](Shader &shader) { shader.setFloat("bloomThreshold", bloomThreshold); });
+                postGraph.addPass("blur x", stages + "blur.glsl", "blur", { { "blurSource", bright } }, blurX,
+                                  [](Shader &shader) { shader.setVec2("blurDirection", 1.0f, 0.0f); });
+                postGraph.addPass("blur y", stages + "blur.glsl", "blur", { { "blurSource", blurX } }, blurY,
+                                  [](Shader &shader) { shader.setVec2("blurDirection", 0.0f, 1.0f); });
+                postGraph.addPointwisePass("bloom", stages + "bloom.glsl", "bloom", color, { { "bloomTexture", blurY } }, bloomed,
+                                           [&](Shader &shader) { shader.setFloat("bloomStrength", bloomStrength); });
+                color = bloomed;
+            }
+            if (tonemap)
+            {
+                RenderGraph::Resource mapped = postGraph.createTexture("tonemap", scene);
+                postGraph.addPointwisePass("tonemap", stages + "tonemap.glsl", "tonemap", color, {}, mapped,
+                                           [&](Shader &shader) { shader.setFloat("exposure", exposure); });
+                color = mapped;
+            }
+            if (renderWidth != scrWidth || renderHeight != scrHeight)
+            {
+                RenderGraph::Resource upscaled = postGraph.createTexture("upscale", RenderGraphTextureDesc(GL_RGBA16F));
+                postGraph.addPass("upscale", stages + "upscale.glsl", "upscale", { { "upscaleSource", color } }, upscaled);
+                color = upscaled;
+            }
+            if (vignette)
+            {
+                RenderGraph::Resource darkened = postGraph.createTexture("vignette", RenderGraphTextureDesc(GL_RGBA16F));
+                postGraph.addPointwisePass("vignette", stages + "vignette.glsl", "vignette", color, {}, darkened,
+                                           [&](Shader &shader) { shader.setFloat("vignetteStrength", vignetteStrength); });
+                color = darkened;
+            }
+            postGraph.addPointwisePass("gamma", stages + "gamma.glsl", "gammaEncode", color, {}, RenderGraph::BACKBUFFER);
+            postGraph.compile(fusePasses);
+            postGraphKey = graphKey;
+        }
+        {
+            GpuProfiler::Scope scope(profiler, "post");
+            CPU_PROFILE_SCOPE("post");
+            postGraph.execute(&profiler);
+        }
         glDisable(GL_DEPTH_TEST);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, screenTexture);
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // secondDepthShader.use();
-        // model = glm::mat4(1.0f);
-        // model = glm::translate(model, glm::vec3(0.7f, 0.7f, 0.0f));
-        // model = glm::scale(model, glm::vec3(0.3f));
-        // secondDepthShader.setMat4("model", glm::value_ptr(model));
-        // glActiveTexture(GL_TEXTURE0);
-        // glBindTexture(GL_TEXTURE_2D, depthMap);
-        // glBindVertexArray(quadVAO);
-        // glDrawArrays(GL_TRIANGLES, 0, 6);
+        // the deferred path always has its depth in a texture, the forward path only with the prepass
+        if (showSceneDepth && (renderMode == 1 || depthPrepass))
+        {
+            depthViewShader.use();
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(0.7f, 0.7f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.3f));
+            depthViewShader.setMat4("model", glm::value_ptr(model));
+            depthViewShader.setInt("depthTexture", 0);
+            depthViewShader.setFloat("near", near);
+            depthViewShader.setFloat("far", far);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, renderMode == 1 ? gbuffer.gDepth : sceneDepth);
+            glBindVertexArray(quadVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        frameTimer.end();
 
         glEnable(GL_DEPTH_TEST);
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            GpuProfiler::Scope scope(profiler, "ui");
+            CPU_PROFILE_SCOPE("ImGui render");
+            ImGui::Render();
+            // headless captures show the scene alone
+            if (!headless)
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        profiler.endFrame();
+        uniforms.endFrame();
+        renderTargets.endFrame();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents(); // poll IO events
+        if (headless)
+        {
+            // no swap to wait for, the frame lasts until the GPU finished it
+            glFinish();
+            frameStats.add(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - frameBegin).count());
+            if (!captureDir.empty() && headlessFrame % captureEvery == 0)
+            {
+                char name[32];
+                std::snprintf(name, sizeof(name), "/frame_%04u.png", headlessFrame);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                PngWriter::captureFramebuffer(captureDir + name, scrWidth, scrHeight);
+            }
+            headlessFrame++;
+        }
+        else
+        {
+            {
+                CPU_PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            glfwPollEvents(); // poll IO events
+        }
+
+        if (startupMs == 0.0f)
+        {
+            glFinish();
+            startupMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startupBegin).count();
+            // a cache that only hit is warm, one that had to compile anything cold
+            const char *state = !useShaderCache || !programCache.enabled ? "off" : programCache.misses == 0 ? "warm" : "cold";
+            std::cout << "SHADER_CACHE:: " << state << " cache, " << programCache.hits << " hits, " << programCache.misses
+                      << " misses, main shaders " << shadersMs << " ms blocking (" << shaderBatch.submitMs << " submit, "
+                      << shaderBatch.finishMs << " finish, " << (shaderBatch.parallel ? "parallel" : "serial") << " compile), startup "
+                      << startupMs << " ms" << std::endl;
+        }
+    }
+
+    if (resolution.frames > 0)
+        resolution.printSummary(std::cout);
+    if (headless)
+    {
+        frameStats.printSummary(std::cout);
+        if (!frameTimesPath.empty())
+            frameStats.writeCsv(frameTimesPath);
     }
 
     /***** clean *****/
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (!headless)
+        ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
-    glfwTerminate();
+    if (!headless)
+        glfwTerminate();
 
     return 0;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    // minimized: keep rendering into the old targets, nothing reaches the screen anyway
+    if (width <= 0 || height <= 0)
+        return;
     glViewport(0, 0, width, height);
+    scrWidth = width;
+    scrHeight = height;
+    framebufferResized = true;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -518,7 +1126,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -526,6 +1134,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -549,8 +1160,9 @@ void init_imgui(GLFWwindow *window)
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);          // Second param install_callback=true will install GLFW callbacks and chain to existing ones.
+    // Setup Platform/Renderer backends, headless (no window) has no platform backend
+    if (window != nullptr)
+        ImGui_ImplGlfw_InitForOpenGL(window, true);          // Second param install_callback=true will install GLFW callbacks and chain to existing ones.
     ImGui_ImplOpenGL3_Init();
 }
 
@@ -625,4 +1237,50 @@ unsigned int loadCubemap(std::vector<std::string> faces)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
     return textureID;
-}
\ No newline at end of file
+}
+
+// the CPU scopes of the last frame, a row of bars per nesting depth for every thread, time along x
+void drawCpuFlameView()
+{
+    CpuProfiler &cpuProfiler = CpuProfiler::instance();
+    uint64_t start = cpuProfiler.frameStart(), end = cpuProfiler.frameEnd();
+    if (end <= start)
+        return;
+    std::vector<CpuProfileEvent> events = cpuProfiler.events(start, end);
+    std::vector<std::string> threads = cpuProfiler.threadNames();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+    float pixelsPerNs = width / (end - start);
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    for (uint32_t thread = 0; thread < threads.size(); ++thread)
+    {
+        uint32_t depth = 0;
+        for (const CpuProfileEvent &event : events)
+            if (event.thread == thread)
+                depth = std::max(depth, event.depth + 1);
+        // threads idle in this frame
+        if (depth == 0)
+            continue;
+        ImGui::Text("%s", threads[thread].c_str());
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::InvisibleButton(("##flame" + std::to_string(thread)).c_str(), ImVec2(width, depth * rowHeight));
+        bool hovered = ImGui::IsItemHovered();
+        for (const CpuProfileEvent &event : events)
+        {
+            if (event.thread != thread)
+                continue;
+            // scopes that began in the frame before are cut at its start
+            float x0 = origin.x + (event.start > start ? event.start - start : 0) * pixelsPerNs;
+            float x1 = std::max(origin.x + (event.end - start) * pixelsPerNs, x0 + 1.0f);
+            float y0 = origin.y + event.depth * rowHeight, y1 = y0 + rowHeight - 1.0f;
+            // a scope keeps its color from frame to frame
+            float hue = (std::hash<std::string>()(event.name) % 360) / 360.0f;
+            drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), ImColor::HSV(hue, 0.5f, 0.8f));
+            if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f)
+                drawList->AddText(ImVec2(x0 + 2.0f, y0 + 1.0f), IM_COL32(0, 0, 0, 255), event.name);
+            if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1e6);
+        }
+    }
+}
@@ -4,7 +4,11 @@
 #include "shader.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
+#include "render_target_pool.h"
+#include "render_graph.h"
+#include "gpu_timer.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,6 +23,8 @@
 #include <cmath>
 #include <map>
 #include <vector>
+#include <string>
+#include <iomanip>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -26,7 +32,7 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 unsigned int loadCubemap(std::vector<std::string> faces);
@@ -35,6 +41,9 @@ unsigned int loadCubemap(std::vector<std::string> faces);
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 750;
 const unsigned int msaa = 8;
+unsigned int scrWidth = SCR_WIDTH;
+unsigned int scrHeight = SCR_HEIGHT;
+bool framebufferResized = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -51,8 +60,11 @@ float lastFrame = 0.0f;
 // mouse control
 bool interactWithUI = false;
 
-int main()
+int main(int argc, char **argv)
 {
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
     // glfw: initialize and configure
     // ------------------------------
     if (!glfwInit())
@@ -67,7 +79,8 @@ int main()
 #ifdef __APPLE
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-    glfwWindowHint(GLFW_SAMPLES, 8);
+    // single sampled default framebuffer: anti-aliasing happens in the offscreen targets and the
+    // resolve and post passes write the window directly
 
     // glfw window creation
     // --------------------
@@ -79,6 +92,10 @@ int main()
         exit(-1);
     }
     glfwMakeContextCurrent(window);
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    scrWidth = framebufferWidth;
+    scrHeight = framebufferHeight;
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -104,13 +121,12 @@ int main()
     glEnable(GL_MULTISAMPLE);
 
     /***** create viewport *****/
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    glViewport(0, 0, scrWidth, scrHeight);
 
     // build and compile shader
     // ------------------------
     Shader redShader(CMAKE_SOURCE_DIR"/shaders/color_shaders/color_vert.glsl", CMAKE_SOURCE_DIR"/shaders/color_shaders/red_frag.glsl");
     Shader greenShader(CMAKE_SOURCE_DIR"/shaders/color_shaders/color_vert.glsl", CMAKE_SOURCE_DIR"/shaders/color_shaders/green_frag.glsl");
-    Shader screenShader(CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl", CMAKE_SOURCE_DIR"/shaders/post_processing/screen_frag.glsl");
 
     unsigned int uniformBlockIndexRed = glGetUniformBlockIndex(redShader.ID, "Matrices");
     unsigned int uniformBlockIndexGreen = glGetUniformBlockIndex(greenShader.ID, "Matrices");
@@ -163,17 +179,6 @@ int main()
         -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
     };
     
-    float quadVertices[] = {   // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
-        // positions   // texCoords
-        -1.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-
-        -1.0f,  1.0f,  0.0f, 1.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f, 1.0f
-    };
-    
     // cube VAO
     unsigned int cubeVAO, cubeVBO;
     glGenVertexArrays(1, &cubeVAO);
@@ -183,18 +188,6 @@ int main()
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // setup screen VAO
-    unsigned int quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    
     // uniform buffer object
     unsigned int uboMatrices;
     glGenBuffers(1, &uboMatrices);
@@ -204,43 +197,50 @@ int main()
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
 
+    // anti-aliasing modes. Each is compared by the memory of the targets it holds (scene, history and
+    // the transient textures of its passes) and by the GPU time of the scene plus its resolve passes.
+    const char *aaModes[] = { "MSAA 8x", "None", "FXAA", "SMAA", "TAA" };
+    enum { AA_MSAA, AA_NONE, AA_FXAA, AA_SMAA, AA_TAA };
+    const int AA_MODE_COUNT = IM_ARRAYSIZE(aaModes);
+    int aaMode = AA_MSAA;
+    struct ModeStats {
+        float gpuMs;
+        size_t bytes;
+        bool measured;
+    };
+    ModeStats modeStats[AA_MODE_COUNT] = {};
+    GpuTimer modeTimers[AA_MODE_COUNT];
+
+    RenderTargetPool renderTargets;
+    RenderGraph aaGraph(renderTargets, scrWidth, scrHeight, CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl");
+    int graphMode = -1;
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    unsigned int textureColorBufferMultiSampled;
-    glGenTextures(1, &textureColorBufferMultiSampled);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, msaa, GL_RGB, SCR_WIDTH, SCR_HEIGHT, GL_TRUE);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled, 0);
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaa, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    // configure second post-processing framebuffer
-    unsigned int intermediateFBO;
-    glGenFramebuffers(1, &intermediateFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
-    // create a color attachment texture
-    unsigned int screenTexture;
-    glGenTextures(1, &screenTexture);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTexture, 0);	// we only need a color buffer
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cerr << "ERROR::FRAMEBUFFER:: Intermediate framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    int sceneColorTarget = -1, sceneDepthTarget = -1;
+    // taa: the previous frame's result is read, the new one written, then they swap
+    int historyTargets[2] = { -1, -1 };
+    auto acquireTargets = [&]() {
+        for (int *target : { &sceneColorTarget, &sceneDepthTarget, &historyTargets[0], &historyTargets[1] })
+        {
+            if (*target >= 0)
+                renderTargets.release(*target);
+            *target = -1;
+        }
+        unsigned int samples = aaMode == AA_MSAA ? msaa : 1;
+        sceneColorTarget = renderTargets.acquire(RenderTargetDesc(GL_RGBA8, scrWidth, scrHeight, samples));
+        sceneDepthTarget = renderTargets.acquire(RenderTargetDesc(GL_DEPTH24_STENCIL8, scrWidth, scrHeight, samples), GL_NEAREST);
+        if (aaMode == AA_TAA)
+        {
+            historyTargets[0] = renderTargets.acquire(RenderTargetDesc(GL_RGBA16F, scrWidth, scrHeight));
+            historyTargets[1] = renderTargets.acquire(RenderTargetDesc(GL_RGBA16F, scrWidth, scrHeight));
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, renderTargets.textureTarget(sceneColorTarget), renderTargets.texture(sceneColorTarget), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, renderTargets.textureTarget(sceneDepthTarget), renderTargets.texture(sceneDepthTarget), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
 
     // transform properties
     float imgui_background_alpha = 0.5f;
@@ -266,16 +266,75 @@ int main()
     bool postProcessing = false;
     float offsetScale = 0.005f;
     float offsetFreq = 20.0f;
+    // anti-aliasing
+    float smaaThreshold = 0.1f;
+    float taaBlend = 0.1f;
+    bool cycleModes = false;
+    bool orbitCamera = false;
+    unsigned int frameIndex = 0, framesInMode = 0;
+    glm::mat4 previousViewProjection(1.0f), taaReprojection(1.0f);
+    bool taaReset = true;
+    RenderGraph::Resource historyIn = -1, historyOut = -1;
     
     /***** render loop *****/
     while(!glfwWindowShouldClose(window))
     {
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished())
+            glfwSetWindowShouldClose(window, true);
+
+        // cycleModes visits every mode for 120 frames so the table below fills up
+        if (cycleModes && ++framesInMode >= 120)
+        {
+            aaMode = (aaMode + 1) % AA_MODE_COUNT;
+            framesInMode = 0;
+        }
+        if (framebufferResized || aaMode != graphMode)
+        {
+            acquireTargets();
+            const std::string stages = CMAKE_SOURCE_DIR"/shaders/post_processing/stages/";
+            aaGraph.resize(scrWidth, scrHeight);
+            RenderGraph::Resource scene = aaGraph.importTexture("scene", renderTargets.texture(sceneColorTarget), scrWidth, scrHeight);
+            if (aaMode == AA_MSAA || aaMode == AA_NONE)
+                aaGraph.addResolvePass("resolve", framebuffer, RenderGraph::BACKBUFFER);
+            else if (aaMode == AA_FXAA)
+                aaGraph.addPass("fxaa", stages + "fxaa.glsl", "fxaa", { { "fxaaSource", scene } }, RenderGraph::BACKBUFFER);
+            else if (aaMode == AA_SMAA)
+            {
+                RenderGraph::Resource edges = aaGraph.createTexture("smaa edges", RenderGraphTextureDesc(GL_RG8, 1.0f, GL_NEAREST));
+                RenderGraph::Resource weights = aaGraph.createTexture("smaa weights", RenderGraphTextureDesc(GL_RGBA8, 1.0f, GL_NEAREST));
+                aaGraph.addPass("smaa edges", stages + "smaa_edges.glsl", "smaaEdges", { { "smaaEdgeSource", scene } }, edges,
+                                [&](Shader &shader) { shader.setFloat("smaaThreshold", smaaThreshold); });
+                aaGraph.addPass("smaa weights", stages + "smaa_weights.glsl", "smaaWeights", { { "smaaEdgeTexture", edges } }, weights);
+                aaGraph.addPass("smaa blend", stages + "smaa_blend.glsl", "smaaBlend",
+                                { { "smaaColor", scene }, { "smaaWeightTexture", weights } }, RenderGraph::BACKBUFFER);
+            }
+            else
+            {
+                RenderGraph::Resource depth = aaGraph.importTexture("scene depth", renderTargets.texture(sceneDepthTarget), scrWidth, scrHeight);
+                historyIn = aaGraph.importTexture("history", renderTargets.texture(historyTargets[0]), scrWidth, scrHeight);
+                historyOut = aaGraph.importTexture("new history", renderTargets.texture(historyTargets[1]), scrWidth, scrHeight,
+                                                   renderTargets.framebuffer(historyTargets[1]));
+                aaGraph.addPass("taa", stages + "taa.glsl", "taa", { { "taaCurrent", scene }, { "taaHistory", historyIn }, { "taaDepth", depth } },
+                                historyOut, [&](Shader &shader) {
+                                    shader.setMat4("taaReprojection", glm::value_ptr(taaReprojection));
+                                    shader.setFloat("taaBlend", taaBlend);
+                                    shader.setBool("taaReset", taaReset);
+                                });
+                aaGraph.addPointwisePass("present", stages + "copy.glsl", "copy", historyOut, {}, RenderGraph::BACKBUFFER);
+            }
+            aaGraph.compile();
+            graphMode = aaMode;
+            taaReset = true;
+            framebufferResized = false;
+        }
 
         // imgui loop start
         ImGui_ImplOpenGL3_NewFrame();
@@ -286,7 +345,7 @@ int main()
 
         // imgui draw guis
         ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Appearing);
-        ImGui::SetNextWindowSize(ImVec2(250, SCR_HEIGHT), ImGuiCond_Appearing);
+        ImGui::SetNextWindowSize(ImVec2(250, scrHeight), ImGuiCond_Appearing);
         ImGui::Begin("Properties"); // Create a window and append into it.
         ImGui::Text("Material");
         ImGui::SliderFloat("ratio", &ratio, 1.0f, 2.0f);
@@ -322,67 +381,106 @@ int main()
         ImGui::Checkbox("postProcessing", &postProcessing);
         ImGui::DragFloat("offsetScale", &offsetScale, 0.001f);
         ImGui::DragFloat("offsetFreq", &offsetFreq, 0.1f);
+        ImGui::Text("Anti-aliasing");
+        ImGui::Combo("mode", &aaMode, aaModes, AA_MODE_COUNT);
+        ImGui::SliderFloat("smaaThreshold", &smaaThreshold, 0.02f, 0.3f);
+        ImGui::SliderFloat("taaBlend", &taaBlend, 0.02f, 1.0f);
+        ImGui::Checkbox("orbitCamera", &orbitCamera);
+        ImGui::Checkbox("cycleModes", &cycleModes);
+        for (int i = 0; i < AA_MODE_COUNT; i++)
+        {
+            if (modeStats[i].measured)
+                ImGui::BulletText("%-8s %6.2f ms %6.1f MB", aaModes[i], modeStats[i].gpuMs, modeStats[i].bytes / 1048576.0f);
+            else
+                ImGui::BulletText("%-8s -", aaModes[i]);
+        }
         ImGui::End();
 
+        if (orbitCamera)
+        {
+            float angle = 0.3f * currentTime;
+            camera.Position = glm::vec3(4.0f * std::sin(angle), 1.5f, 4.0f * std::cos(angle));
+            glm::vec3 front = glm::normalize(-camera.Position);
+            camera.Yaw = glm::degrees(std::atan2(front.z, front.x));
+            camera.Pitch = glm::degrees(std::asin(front.y));
+            camera.updateCameraVectors();
+        }
+
         // render
         // ------
+        ModeStats &stats = modeStats[aaMode];
+        modeTimers[aaMode].begin();
         // pass 1
         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, scrWidth, scrHeight);
         glClearColor(clearColor.x, clearColor.y, clearColor.z, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        // create transformations
+        // create transformations, taa renders every frame with a different sub-pixel offset
+        frameIndex++;
+        float aspect = (float)scrWidth / scrHeight;
+        glm::vec2 jitter = aaMode == AA_TAA ? Camera::TemporalJitter(frameIndex) : glm::vec2(0.0f);
         glm::mat4 model = glm::mat4(1.0f), normalMatrix;
         glm::mat4 view          = glm::mat4(1.0f);
         glm::mat4 projection    = glm::mat4(1.0f);
         view = camera.GetViewMatrix();
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / SCR_HEIGHT, near, far);
+        projection = camera.GetProjectionMatrix(aspect, near, far, jitter, glm::vec2(scrWidth, scrHeight));
+        glm::mat4 viewProjection = camera.GetProjectionMatrix(aspect, near, far) * view;
+        taaReprojection = previousViewProjection * glm::inverse(viewProjection);
 
         glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
         glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
         glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-        // FIXME
-        // red cube
-        redShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(scale));
-        redShader.setMat4("model", glm::value_ptr(model));
+        // a grid of tilted cubes, plenty of long near-horizontal and near-vertical edges
         glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        // green cube
-        greenShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(scale));
-        greenShader.setMat4("model", glm::value_ptr(model));
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
-        glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        for (int x = -3; x <= 3; x++)
+        {
+            for (int y = -3; y <= 3; y++)
+            {
+                Shader &shader = (x + y) % 2 ? redShader : greenShader;
+                shader.use();
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(x * 1.2f, y * 1.2f, -2.0f - 0.3f * (x + 3)));
+                model = glm::rotate(model, glm::radians(15.0f * x + 5.0f * y), glm::vec3(0.3f, 1.0f, 0.2f));
+                model = glm::scale(model, glm::vec3(scale));
+                shader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, screenTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // resolve to the window
+        if (aaMode == AA_TAA)
+        {
+            int read = frameIndex & 1;
+            aaGraph.rebindImport(historyIn, renderTargets.texture(historyTargets[read]));
+            aaGraph.rebindImport(historyOut, renderTargets.texture(historyTargets[1 - read]), renderTargets.framebuffer(historyTargets[1 - read]));
+        }
+        aaGraph.execute();
+        modeTimers[aaMode].end();
+        previousViewProjection = viewProjection;
+        taaReset = false;
+        stats.gpuMs = modeTimers[aaMode].elapsedMs;
+        stats.bytes = renderTargets.usage().inUseBytes;
+        stats.measured = true;
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        renderTargets.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents(); // poll IO events
     }
 
+    std::cout << "mode      gpu ms   targets MB" << std::endl;
+    for (int i = 0; i < AA_MODE_COUNT; i++)
+    {
+        if (modeStats[i].measured)
+            std::cout << std::left << std::setw(8) << aaModes[i] << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                      << modeStats[i].gpuMs << std::setprecision(1) << std::setw(13) << modeStats[i].bytes / 1048576.0f << std::endl;
+    }
+
     /***** clean *****/
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -394,7 +492,12 @@ int main()
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    if (width <= 0 || height <= 0)
+        return;
     glViewport(0, 0, width, height);
+    scrWidth = width;
+    scrHeight = height;
+    framebufferResized = true;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -432,7 +535,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -440,6 +543,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
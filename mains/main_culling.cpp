@@ -4,6 +4,7 @@
 #include "shader.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
 
 #include <glm/glm.hpp>
@@ -26,7 +27,7 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 
@@ -49,8 +50,11 @@ float lastFrame = 0.0f;
 // mouse control
 bool interactWithUI = false;
 
-int main()
+int main(int argc, char **argv)
 {
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
     // glfw: initialize and configure
     // ------------------------------
     if (!glfwInit())
@@ -208,10 +212,14 @@ int main()
     {
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished())
+            glfwSetWindowShouldClose(window, true);
 
         // imgui loop start
         ImGui_ImplOpenGL3_NewFrame();
@@ -333,7 +341,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -341,6 +349,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -4,7 +4,11 @@
 #include "shader.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
+#include "oit.h"
+#include "gpu_timer.h"
+#include "depth_sorter.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,6 +23,9 @@
 #include <cmath>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -26,7 +33,7 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 
@@ -49,8 +56,18 @@ float lastFrame = 0.0f;
 // mouse control
 bool interactWithUI = false;
 
-int main()
+// transparent quads
+const unsigned int MAX_QUADS = 20000;
+struct TransparentVertex {
+    glm::vec3 position;
+    glm::vec4 color;
+};
+
+int main(int argc, char **argv)
 {
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
     // glfw: initialize and configure
     // ------------------------------
     if (!glfwInit())
@@ -106,7 +123,9 @@ int main()
     // ------------------------
     Shader lightingShader(CMAKE_SOURCE_DIR"/shaders/framebuffer_vert.glsl", CMAKE_SOURCE_DIR"/shaders/framebuffer_frag.glsl");
     Shader postShader(CMAKE_SOURCE_DIR"/shaders/post_processing_vert.glsl", CMAKE_SOURCE_DIR"/shaders/post_processing_frag.glsl");
-    Shader alphaShader(CMAKE_SOURCE_DIR"/shaders/alpha_blend_vert.glsl", CMAKE_SOURCE_DIR"/shaders/alpha_blend_frag.glsl");
+    Shader transparentShader(CMAKE_SOURCE_DIR"/shaders/oit/transparent_vert.glsl", CMAKE_SOURCE_DIR"/shaders/oit/transparent_frag.glsl");
+    Shader wboitShader(CMAKE_SOURCE_DIR"/shaders/oit/transparent_vert.glsl", CMAKE_SOURCE_DIR"/shaders/oit/wboit_frag.glsl");
+    Shader compositeShader(CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl", CMAKE_SOURCE_DIR"/shaders/oit/wboit_composite_frag.glsl");
 
     stbi_set_flip_vertically_on_load(true);
 
@@ -195,17 +214,58 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    // plane VAO
-    unsigned int glassVAO, glassVBO;
-    glGenVertexArrays(1, &glassVAO);
-    glGenBuffers(1, &glassVBO);
-    glBindVertexArray(glassVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, glassVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
+    // transparent quads, all drawn with a single glDrawElements
+    // the first one is the glass pane above the scene, the rest are scattered randomly with random colors
+    std::vector<TransparentVertex> quadVerticesWorld;
+    std::vector<glm::vec3> quadCenters;
+    std::vector<unsigned int> transparentIndices(6 * MAX_QUADS);
+    quadVerticesWorld.reserve(4 * MAX_QUADS);
+    quadCenters.reserve(MAX_QUADS);
+    auto random = [](float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); };
+    srand(36);
+    for (unsigned int i = 0; i < MAX_QUADS; i++)
+    {
+        glm::vec3 center, right, up;
+        glm::vec4 color;
+        if (i == 0)
+        {
+            center = glm::vec3(0.0f, 2.0f, 0.0f);
+            right = glm::vec3(5.0f, 0.0f, 0.0f);
+            up = glm::vec3(0.0f, 0.0f, 5.0f);
+            color = glm::vec4(0.3f, 0.57f, 1.0f, 0.5f);
+        }
+        else
+        {
+            center = glm::vec3(random(-5.0f, 5.0f), random(-0.3f, 4.0f), random(-5.0f, 5.0f));
+            glm::quat orientation = glm::angleAxis(random(0.0f, 6.2831853f), glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)) + glm::vec3(0.0f, 0.0f, 1e-3f)));
+            float size = random(0.1f, 0.4f);
+            right = orientation * glm::vec3(size, 0.0f, 0.0f);
+            up = orientation * glm::vec3(0.0f, size, 0.0f);
+            color = glm::vec4(random(0.0f, 1.0f), random(0.0f, 1.0f), random(0.0f, 1.0f), random(0.2f, 0.6f));
+        }
+        quadVerticesWorld.push_back({ center - right - up, color });
+        quadVerticesWorld.push_back({ center + right - up, color });
+        quadVerticesWorld.push_back({ center + right + up, color });
+        quadVerticesWorld.push_back({ center - right + up, color });
+        quadCenters.push_back(center);
+        unsigned int base = 4 * i;
+        unsigned int quad[6] = { base, base + 1, base + 2, base + 2, base + 3, base };
+        std::copy(quad, quad + 6, &transparentIndices[6 * i]);
+    }
+    unsigned int transparentVAO, transparentVBO, transparentEBO;
+    glGenVertexArrays(1, &transparentVAO);
+    glGenBuffers(1, &transparentVBO);
+    glGenBuffers(1, &transparentEBO);
+    glBindVertexArray(transparentVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
+    glBufferData(GL_ARRAY_BUFFER, quadVerticesWorld.size() * sizeof(TransparentVertex), quadVerticesWorld.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, transparentEBO);
+    // rewritten every frame in the sorted mode
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, transparentIndices.size() * sizeof(unsigned int), transparentIndices.data(), GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TransparentVertex), (void*)offsetof(TransparentVertex, position));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TransparentVertex), (void*)offsetof(TransparentVertex, color));
     // quad VAO VBO EBO
     unsigned int quadVAO, quadVBO, quadEBO;
     glGenVertexArrays(1, &quadVAO);
@@ -253,6 +313,11 @@ int main()
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cerr << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // order-independent transparency targets, depth tested against rbo
+    WeightedBlendedOIT oit(SCR_WIDTH, SCR_HEIGHT, rbo);
+    compositeShader.use();
+    compositeShader.setInt("accumTexture", 0);
+    compositeShader.setInt("weightTexture", 1);
 
     // transform properties
     float imgui_background_alpha = 0.5f;
@@ -275,16 +340,30 @@ int main()
     // post processing
     float offsetScale = 0.005f;
     float offsetFreq = 20.0f;
+    // transparency
+    // 0: blended in submission order, 1: blended after a CPU back-to-front sort, 2: weighted blended OIT
+    const char *transparencyModes[] = { "blend, unsorted", "blend, CPU sorted", "weighted blended OIT" };
+    int transparencyMode = 2;
+    int quadCount = 5000;
+    float sortMs = 0.0f;
+    DepthSorter quadSorter;
+    std::vector<unsigned int> sortedIndices(6 * MAX_QUADS);
+    bool indicesSorted = false;
+    GpuTimer transparencyTimer;
     
     /***** render loop *****/
     while(!glfwWindowShouldClose(window))
     {
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished())
+            glfwSetWindowShouldClose(window, true);
 
         // imgui loop start
         ImGui_ImplOpenGL3_NewFrame();
@@ -328,6 +407,15 @@ int main()
         ImGui::Text("Misc");
         ImGui::DragFloat("offsetScale", &offsetScale, 0.001f);
         ImGui::DragFloat("offsetFreq", &offsetFreq, 0.1f);
+        ImGui::Text("Transparency");
+        ImGui::Combo("transparency", &transparencyMode, transparencyModes, IM_ARRAYSIZE(transparencyModes));
+        ImGui::SliderInt("quads", &quadCount, 1, MAX_QUADS);
+        ImGui::Text("transparent pass: %.3f ms GPU", transparencyTimer.elapsedMs);
+        if (transparencyMode == 1)
+        {
+            ImGui::Text("sort + upload: %.3f ms CPU", sortMs);
+            ImGui::Text("order: %s", quadSorter.lastMethod == DepthSorter::COHERENT ? "previous frame, repaired" : "radix sort");
+        }
         ImGui::End();
 
         // render
@@ -391,17 +479,61 @@ int main()
         lightingShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        // glass
-        alphaShader.use();
-        glBindVertexArray(glassVAO);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 2.0f, 0.0f));
-        normalMatrix = glm::transpose(glm::inverse(model));
-        alphaShader.setMat4("view", glm::value_ptr(view));
-        alphaShader.setMat4("projection", glm::value_ptr(projection));
-        alphaShader.setMat4("model", glm::value_ptr(model));
-        alphaShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // transparent quads
+        if (transparencyMode == 1)
+        {
+            // back to front by the view depth of the quad centers, then one index buffer upload
+            auto sortStart = std::chrono::high_resolution_clock::now();
+            quadSorter.sort(quadCenters.data(), quadCount, view);
+            for (int i = 0; i < quadCount; i++)
+            {
+                unsigned int quad = quadSorter.order[i];
+                std::copy(&transparentIndices[6 * quad], &transparentIndices[6 * quad] + 6, &sortedIndices[6 * i]);
+            }
+            // the element buffer binding is VAO state
+            glBindVertexArray(transparentVAO);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, 6 * quadCount * sizeof(unsigned int), sortedIndices.data());
+            sortMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+            indicesSorted = true;
+        }
+        else if (indicesSorted)
+        {
+            // back to submission order
+            glBindVertexArray(transparentVAO);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, transparentIndices.size() * sizeof(unsigned int), transparentIndices.data());
+            indicesSorted = false;
+        }
+        transparencyTimer.begin();
+        if (transparencyMode == 2)
+        {
+            // one unsorted pass into the accumulation targets, then composite over the opaque image
+            oit.begin();
+            wboitShader.use();
+            wboitShader.setMat4("view", glm::value_ptr(view));
+            wboitShader.setMat4("projection", glm::value_ptr(projection));
+            glBindVertexArray(transparentVAO);
+            glDrawElements(GL_TRIANGLES, 6 * quadCount, GL_UNSIGNED_INT, 0);
+            oit.end();
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            compositeShader.use();
+            oit.bindTextures(0);
+            glDisable(GL_DEPTH_TEST);
+            glBindVertexArray(quadVAO);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            glEnable(GL_DEPTH_TEST);
+        }
+        else
+        {
+            transparentShader.use();
+            transparentShader.setMat4("view", glm::value_ptr(view));
+            transparentShader.setMat4("projection", glm::value_ptr(projection));
+            glDepthMask(GL_FALSE);
+            glBindVertexArray(transparentVAO);
+            glDrawElements(GL_TRIANGLES, 6 * quadCount, GL_UNSIGNED_INT, 0);
+            glDepthMask(GL_TRUE);
+        }
+        transparencyTimer.end();
 
         // post-processing pass
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -429,6 +561,9 @@ int main()
     glDeleteTextures(1, &texColorBuffer);
     glDeleteFramebuffers(1, &fbo);
     glDeleteRenderbuffers(1, &rbo);
+    glDeleteVertexArrays(1, &transparentVAO);
+    glDeleteBuffers(1, &transparentVBO);
+    glDeleteBuffers(1, &transparentEBO);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -477,7 +612,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -485,6 +620,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
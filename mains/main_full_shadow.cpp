@@ -4,7 +4,12 @@
 #include "shader.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
+#include "moment_shadow.h"
+#include "uniform_blocks.h"
+#include "instance_batcher.h"
+#include "shader_hot_reload.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -26,7 +31,7 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 unsigned int loadCubemap(std::vector<std::string> faces);
@@ -51,8 +56,11 @@ float lastFrame = 0.0f;
 // mouse control
 bool interactWithUI = false;
 
-int main()
+int main(int argc, char **argv)
 {
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
     // glfw: initialize and configure
     // ------------------------------
     if (!glfwInit())
@@ -110,16 +118,36 @@ int main()
     // ------------------------
     Shader blinnShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/full_shadow_vert.glsl", CMAKE_SOURCE_DIR"/shaders/shadow_mapping/full_shadow_frag.glsl");
     Shader screenShader(CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl", CMAKE_SOURCE_DIR"/shaders/post_processing/screen_frag.glsl");
-    Shader dirDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_vert.glsl",
+    Shader dirDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_instanced_vert.glsl",
                           CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_frag.glsl");
-    Shader pointDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_vert.glsl",
+    Shader pointDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_instanced_vert.glsl",
                             CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_frag.glsl",
                             CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_geo.glsl");
     // Shader secondDepthShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_vert.glsl", CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_frag.glsl");
+    Shader dirMomentShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/light_depth_instanced_vert.glsl",
+                           CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_frag.glsl");
+    Shader pointMomentShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_instanced_vert.glsl",
+                             CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_cubemap_frag.glsl",
+                             CMAKE_SOURCE_DIR"/shaders/shadow_mapping/depth_cubemap_geo.glsl");
+    Shader momentBlurShader(CMAKE_SOURCE_DIR"/shaders/post_processing/screen_vert.glsl",
+                            CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_blur_frag.glsl");
+    Shader momentCubeBlurShader(CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_blur_cube_vert.glsl",
+                                CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_blur_cube_frag.glsl",
+                                CMAKE_SOURCE_DIR"/shaders/shadow_mapping/moments_blur_cube_geo.glsl");
     blinnShader.use();
     blinnShader.setInt("material.texture_diffuse1", 0);
     blinnShader.setInt("dirShadowMap", 1);
     blinnShader.setInt("pointShadowMap", 2);
+    blinnShader.setInt("dirMomentMap", 3);
+    blinnShader.setInt("pointMomentMap", 4);
+    // saving a shader rebuilds it while running, the sampler units above are carried over
+    ShaderHotReload shaderReload;
+    for (Shader *shader : { &blinnShader, &screenShader, &dirDepthShader, &pointDepthShader, &dirMomentShader,
+                            &pointMomentShader, &momentBlurShader, &momentCubeBlurShader })
+        shaderReload.watch(*shader);
+
+    // per-frame, per-light and per-material data shared by every shader that includes common/uniforms.glsl
+    UniformBlocks uniforms;
 
     auto wood_tex = loadTexture(CMAKE_SOURCE_DIR"/resources/textures/wood.png");
     auto block_tex = loadTexture(CMAKE_SOURCE_DIR"/resources/textures/block_solid.png");
@@ -307,6 +335,13 @@ int main()
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // prefiltered moment maps, an alternative to the many-tap PCF above
+    // the blur and mipmaps do the filtering, so they can be smaller than the depth maps
+    const unsigned int MOMENT_SIZE = 1024, MOMENT_CUBE_SIZE = 512;
+    MomentShadowMap dirMomentMap(MOMENT_SIZE, MOMENT_SIZE);
+    MomentShadowCubeMap pointMomentMap(MOMENT_CUBE_SIZE);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
     // transform properties
     float imgui_background_alpha = 0.5f;
 
@@ -333,17 +368,77 @@ int main()
     float offsetScale = 0.005f;
     float offsetFreq = 20.0f;
     float gamma = 2.2f;
+    // shadow filtering
+    const char *shadowModes[] = { "PCF", "VSM", "EVSM" };
+    int shadowMode = 0;
+    int momentBlurRadius = 2;
+    float lightBleedReduction = 0.3f;
+    float minVariance = 0.00002f;
+    glm::vec2 evsmExponents(40.0f, 5.0f);
+
+    // submits the planes and cubes once per frame, the batcher draws them in the shadow passes and the lighting pass
+    InstanceBatcher batcher;
+    int extraCubes = 64;
+    auto submitScene = [&]()
+    {
+        batcher.begin();
+        glm::mat4 model;
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        batcher.submit(planeVAO, GL_TRIANGLES, 0, 6, wood_tex, model);
+        // plane 2
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, scale, -scale));
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        batcher.submit(planeVAO, GL_TRIANGLES, 0, 6, wood_tex, model);
+        // plane 3
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(scale, scale, 0.0f));
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        batcher.submit(planeVAO, GL_TRIANGLES, 0, 6, wood_tex, model);
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(-2.0f, 0.5f, 0.5f));
+        model = glm::scale(model, glm::vec3(1.0f));
+        batcher.submit(cubeVAO, GL_TRIANGLES, 0, 36, block_tex, model);
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(1.0f, 1.2f, -1.0f));
+        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+        model = glm::scale(model, glm::vec3(1.0f));
+        batcher.submit(cubeVAO, GL_TRIANGLES, 0, 36, block_tex, model);
+
+        // small cubes scattered over the floor, each one a separate draw before batching
+        for (int i = 0; i < extraCubes; i++)
+        {
+            float angle = i * 2.39996323f; // golden angle spiral
+            float r = 0.9f * scale * std::sqrt((i + 0.5f) / std::max(extraCubes, 1));
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(r * std::cos(angle), 0.15f, r * std::sin(angle)));
+            model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, glm::vec3(0.3f));
+            batcher.submit(cubeVAO, GL_TRIANGLES, 0, 36, block_tex, model);
+        }
+        batcher.upload();
+    };
 
-    
     /***** render loop *****/
     while(!glfwWindowShouldClose(window))
     {
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished())
+            glfwSetWindowShouldClose(window, true);
+        shaderReload.update();
 
         // imgui loop start
         ImGui_ImplOpenGL3_NewFrame();
@@ -379,6 +474,12 @@ int main()
         ImGui::DragFloat3("lightAttenuation", glm::value_ptr(lightAttenuation), 0.01f, 0.0f, 1.0f);
         ImGui::SliderFloat("innerTheta", &innerTheta, 0.1f, 90.0f);
         ImGui::SliderFloat("thetaTransition", &thetaTransition, 0.0f, 30.0f);
+        ImGui::Text("Shadow");
+        ImGui::Combo("shadowMode", &shadowMode, shadowModes, IM_ARRAYSIZE(shadowModes));
+        ImGui::SliderInt("blurRadius", &momentBlurRadius, 0, 8);
+        ImGui::SliderFloat("lightBleedReduction", &lightBleedReduction, 0.0f, 0.95f);
+        ImGui::DragFloat("minVariance", &minVariance, 0.000001f, 0.0f, 0.01f, "%.6f");
+        ImGui::SliderFloat2("evsmExponents", glm::value_ptr(evsmExponents), 1.0f, 42.0f);
         for (int i = 0; i < 1; i++)
         {
             ImGui::Text("Point Light %d", i);
@@ -392,9 +493,15 @@ int main()
         ImGui::DragFloat("offsetScale", &offsetScale, 0.001f);
         ImGui::DragFloat("offsetFreq", &offsetFreq, 0.1f);
         ImGui::SliderFloat("gamma", &gamma, 1.0f, 3.0f);
+        ImGui::Text("Instancing");
+        ImGui::SliderInt("extraCubes", &extraCubes, 0, 4000);
+        ImGui::Text("%u draws -> %u instanced draws per pass", batcher.submittedDraws, batcher.batchCount);
+        ImGui::Text("Hot Reload");
+        ImGui::Text("%u reloads, %u failed, last %.1f ms", shaderReload.reloads, shaderReload.failures, shaderReload.lastReloadMs);
         ImGui::End();
 
-        glm::mat4 model = glm::mat4(1.0f), normalMatrix;
+        submitScene();
+
         // shadow mapping settings
         float point_near_plane = 1.0f, point_far_plane = 25.0f;
         float aspect = (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT;
@@ -408,115 +515,66 @@ int main()
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0,  1.0), glm::vec3(0.0, -1.0,  0.0)));
         shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3( 0.0,  0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
 
-        pointDepthShader.use();
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        pointDepthShader.setFloat("far_plane", point_far_plane);
-        pointDepthShader.setVec3("lightPos", glm::value_ptr(lightPos));
-        pointDepthShader.setMat4("shadowMatrices[0]", glm::value_ptr(shadowTransforms[0]));
-        pointDepthShader.setMat4("shadowMatrices[1]", glm::value_ptr(shadowTransforms[1]));
-        pointDepthShader.setMat4("shadowMatrices[2]", glm::value_ptr(shadowTransforms[2]));
-        pointDepthShader.setMat4("shadowMatrices[3]", glm::value_ptr(shadowTransforms[3]));
-        pointDepthShader.setMat4("shadowMatrices[4]", glm::value_ptr(shadowTransforms[4]));
-        pointDepthShader.setMat4("shadowMatrices[5]", glm::value_ptr(shadowTransforms[5]));
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(planeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, wood_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 2
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, scale, -scale));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 3
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(scale, scale, 0.0f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-2.0f, 0.5f, 0.5f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(1.0f, 1.2f, -1.0f));
-            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            pointDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-
         float dir_near_plane = 1.0f, dir_far_plane = 30.0f;
         glm::mat4 lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, dir_near_plane, dir_far_plane);
         glm::mat4 lightView = glm::lookAt(-10.0f * glm::normalize(lightDir), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
         glm::mat4 lightSpaceMatrix = lightProjection * lightView;
 
-        dirDepthShader.use();
-        dirDepthShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
+        if (shadowMode == 0)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(planeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, wood_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 2
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, scale, -scale));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 3
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(scale, scale, 0.0f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-2.0f, 0.5f, 0.5f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(1.0f, 1.2f, -1.0f));
-            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            dirDepthShader.setMat4("model", glm::value_ptr(model));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            pointDepthShader.use();
+            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            pointDepthShader.setFloat("far_plane", point_far_plane);
+            pointDepthShader.setVec3("lightPos", glm::value_ptr(lightPos));
+            for (unsigned int i = 0; i < 6; ++i)
+                pointDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", glm::value_ptr(shadowTransforms[i]));
+            batcher.draw(pointDepthShader, false);
+
+            dirDepthShader.use();
+            dirDepthShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
+            glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            batcher.draw(dirDepthShader, false);
+        }
+        else
+        {
+            // clear to the moments of the far plane so empty texels never occlude
+            float momentClear[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+            if (shadowMode == 2)
+            {
+                momentClear[0] = std::exp(evsmExponents.x);
+                momentClear[1] = momentClear[0] * momentClear[0];
+                momentClear[2] = -std::exp(-evsmExponents.y);
+                momentClear[3] = momentClear[2] * momentClear[2];
+            }
+            glDisable(GL_BLEND);
+
+            pointMomentShader.use();
+            pointMomentMap.bind();
+            glClearBufferfv(GL_COLOR, 0, momentClear);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            pointMomentShader.setInt("shadowMode", shadowMode);
+            pointMomentShader.setVec2("evsmExponents", evsmExponents.x, evsmExponents.y);
+            pointMomentShader.setFloat("far_plane", point_far_plane);
+            pointMomentShader.setVec3("lightPos", glm::value_ptr(lightPos));
+            for (unsigned int i = 0; i < 6; ++i)
+                pointMomentShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", glm::value_ptr(shadowTransforms[i]));
+            batcher.draw(pointMomentShader, false);
+
+            dirMomentShader.use();
+            dirMomentMap.bind();
+            glClearBufferfv(GL_COLOR, 0, momentClear);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            dirMomentShader.setInt("shadowMode", shadowMode);
+            dirMomentShader.setVec2("evsmExponents", evsmExponents.x, evsmExponents.y);
+            dirMomentShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
+            batcher.draw(dirMomentShader, false);
+
+            // separable blur + mip chain, replaces the per-fragment PCF loops
+            pointMomentMap.blur(momentCubeBlurShader, quadVAO, momentBlurRadius);
+            dirMomentMap.blur(momentBlurShader, quadVAO, momentBlurRadius);
         }
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
@@ -534,88 +592,49 @@ int main()
         view = camera.GetViewMatrix();
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / SCR_HEIGHT, near, far);
 
-        blinnShader.use();
+        // shared uniform blocks, one write replaces the per-field uploads
+        uniforms.frame.projection = projection;
+        uniforms.frame.view = view;
+        uniforms.frame.invViewProjection = glm::inverse(projection * view);
+        uniforms.frame.viewPos = camera.Position;
+        uniforms.frame.gamma = gamma;
+        uniforms.frame.time = currentTime;
+        uniforms.lights.lightSpaceMatrix = lightSpaceMatrix;
+        uniforms.lights.dirLight.direction = lightDir;
+        uniforms.lights.dirLight.ambient = lightAmbient;
+        uniforms.lights.dirLight.diffuse = lightDiffuse;
+        uniforms.lights.dirLight.specular = lightSpecular;
+        uniforms.lights.numPointLights = 1;
+        uniforms.lights.far_plane = point_far_plane;
+        for (int i = 0; i < uniforms.lights.numPointLights; i++)
+        {
+            PointLightBlock &light = uniforms.lights.pointLights[i];
+            light.position = pointLightPositions[i];
+            light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+            light.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+            light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+            light.constant = lightAttenuation.x;
+            light.linear = lightAttenuation.y;
+            light.quadratic = lightAttenuation.z;
+        }
+        uniforms.material.shininess = shininess;
+        uniforms.upload();
 
-        blinnShader.setMat4("lightSpaceMatrix", glm::value_ptr(lightSpaceMatrix));
-        blinnShader.setFloat("far_plane", point_far_plane);
-
-        blinnShader.setFloat("gamma", gamma);
-        blinnShader.setMat4("view", glm::value_ptr(view));
-        blinnShader.setMat4("projection", glm::value_ptr(projection));
-        blinnShader.setFloat("material.shininess", shininess);
-        blinnShader.setVec3("viewPos",  glm::value_ptr(camera.Position));
-
-        // directional light
-        blinnShader.setVec3("dirLight.direction", glm::value_ptr(lightDir));
-        blinnShader.setVec3("dirLight.ambient", glm::value_ptr(lightAmbient));
-        blinnShader.setVec3("dirLight.diffuse", glm::value_ptr(lightDiffuse));
-        blinnShader.setVec3("dirLight.specular", glm::value_ptr(lightSpecular));
-        // point light 1
-        blinnShader.setVec3("pointLights[0].position", glm::value_ptr(pointLightPositions[0]));
-        blinnShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        blinnShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        blinnShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        blinnShader.setFloat("pointLights[0].constant", lightAttenuation.x);
-        blinnShader.setFloat("pointLights[0].linear", lightAttenuation.y);
-        blinnShader.setFloat("pointLights[0].quadratic", lightAttenuation.z);
+        blinnShader.use();
+        blinnShader.setInt("shadowMode", shadowMode);
+        blinnShader.setFloat("lightBleedReduction", lightBleedReduction);
+        blinnShader.setFloat("minVariance", minVariance);
+        blinnShader.setVec2("evsmExponents", evsmExponents.x, evsmExponents.y);
 
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, depthMap);
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            glBindVertexArray(planeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, wood_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 2
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, scale, -scale));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // plane 3
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(scale, scale, 0.0f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(scale));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-2.0f, 0.5f, 0.5f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(1.0f, 1.2f, -1.0f));
-            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(1.0f));
-            normalMatrix = glm::transpose(glm::inverse(model));
-            blinnShader.setMat4("model", glm::value_ptr(model));
-            blinnShader.setMat4("normalMatrix", glm::value_ptr(normalMatrix));
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, block_tex);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, dirMomentMap.moments);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, pointMomentMap.moments);
+        batcher.draw(blinnShader, true);
 
         glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
@@ -646,6 +665,8 @@ int main()
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        uniforms.endFrame();
+        batcher.endFrame();
 
         glfwSwapBuffers(window);
         glfwPollEvents(); // poll IO events
@@ -700,7 +721,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -708,6 +729,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
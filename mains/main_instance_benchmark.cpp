@@ -0,0 +1,111 @@
+#include <glad/glad.h>
+
+#include "instance_builder.h"
+#include "thread_pool.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+
+// Console benchmark for the instance transform path of main_instancing, no window or GL context
+// needed. Usage: main_instance_benchmark [instanceCount] [threadCount]
+
+// best of `runs` wall-clock times in milliseconds
+template <typename F>
+float bestOf(int runs, F &&f)
+{
+    float best = 1e30f;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+void report(const char *name, float ms, size_t count)
+{
+    std::cout << std::left << std::setw(44) << name << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ms
+              << " ms  " << std::setw(8) << std::setprecision(1) << count / (ms * 1000.0f) << " M/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    unsigned int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+    const int RUNS = 5;
+
+    ThreadPool single(1), pool(threads);
+    std::cout << count << " instances, " << pool.size() << " threads"
+#ifdef INSTANCE_TRANSFORM_SSE2
+              << ", SSE2"
+#endif
+              << std::endl;
+
+    // 1. the original setup loop: rand(), glm::translate/scale/rotate and a general inverse per instance
+    std::vector<glm::mat4> models(count), normals(count);
+    float ms = bestOf(RUNS, [&] {
+        srand(1);
+        float radius = 20.0f, offset = 2.5f;
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::mat4 model(1.0f);
+            float angle = (float)i / (float)count * 360.0f;
+            float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+            float x = sin(angle) * radius + displacement;
+            displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+            float y = displacement * 0.4f;
+            displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+            float z = cos(angle) * radius + displacement;
+            model = glm::translate(model, glm::vec3(x, y, z));
+            model = glm::scale(model, glm::vec3((rand() % 20) / 100.0f + 0.05f));
+            model = glm::rotate(model, (float)(rand() % 360), glm::vec3(0.4f, 0.6f, 0.8f));
+            models[i] = model;
+            normals[i] = glm::transpose(glm::inverse(model));
+        }
+    });
+    report("matrices + glm::inverse, 1 thread", ms, count);
+
+    // 2. normal matrices alone: general inverse vs affine cofactor
+    std::vector<glm::mat3> normals3(count);
+    ms = bestOf(RUNS, [&] {
+        for (size_t i = 0; i < count; i++)
+            normals3[i] = glm::mat3(glm::transpose(glm::inverse(models[i])));
+    });
+    report("normal matrix, glm::inverse", ms, count);
+    ms = bestOf(RUNS, [&] { affineNormalMatrices(models.data(), normals3.data(), count); });
+    report("normal matrix, affine cofactor", ms, count);
+
+    // 3. structure of arrays field generation with per-chunk RNG
+    AsteroidField field;
+    ms = bestOf(RUNS, [&] { field.generate(count, BeltParams(), 1, single); });
+    report("AsteroidField::generate, 1 thread", ms, count);
+    ms = bestOf(RUNS, [&] { field.generate(count, BeltParams(), 1, pool); });
+    report("AsteroidField::generate, pool", ms, count);
+
+    // 4. per-frame transform build, full and quantized
+    std::vector<InstanceTransform> transforms(count);
+    std::vector<QuantizedInstanceTransform> quantized(count);
+    InstanceBounds bounds = field.bounds();
+    ms = bestOf(RUNS, [&] { field.buildParallel(transforms.data(), count, false, bounds, 10.0f, 0.05f, 1.0f, single); });
+    report("AsteroidField::build 32B, 1 thread", ms, count);
+    ms = bestOf(RUNS, [&] { field.buildParallel(transforms.data(), count, false, bounds, 10.0f, 0.05f, 1.0f, pool); });
+    report("AsteroidField::build 32B, pool", ms, count);
+    ms = bestOf(RUNS, [&] { field.buildParallel(quantized.data(), count, true, bounds, 10.0f, 0.05f, 1.0f, pool); });
+    report("AsteroidField::build 16B quantized, pool", ms, count);
+
+    // same seed, different thread count: the field must be bit-identical
+    AsteroidField check;
+    check.generate(count, BeltParams(), 1, single);
+    bool reproducible = check.orbitRadius == field.orbitRadius && check.orbitAngle == field.orbitAngle &&
+                        check.scale == field.scale && check.spinAngle == field.spinAngle;
+    std::cout << "reproducible across thread counts: " << (reproducible ? "yes" : "NO") << std::endl;
+    return reproducible ? 0 : 1;
+}
@@ -4,7 +4,13 @@
 #include "shader.h"
 #include "config.h"
 #include "camera.h"
+#include "camera_path.h"
 #include "model.h"
+#include "instance_stream.h"
+#include "instance_transform.h"
+#include "instance_builder.h"
+#include "thread_pool.h"
+#include "orbit_animator.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,6 +25,8 @@
 #include <cmath>
 #include <map>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -26,7 +34,7 @@
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(GLFWwindow *window, bool moveCamera);
 void init_imgui(GLFWwindow *window);
 unsigned int loadTexture(char const * path);
 unsigned int loadCubemap(std::vector<std::string> faces);
@@ -50,8 +58,11 @@ float lastFrame = 0.0f;
 // mouse control
 bool interactWithUI = false;
 
-int main()
+int main(int argc, char **argv)
 {
+    // --camera-path NAME replaces the input with a recorded camera path, --record-camera-path NAME records one
+    CameraPathRunner cameraPath(argc, argv, CMAKE_SOURCE_DIR"/camera_paths");
+
     // glfw: initialize and configure
     // ------------------------------
     if (!glfwInit())
@@ -168,81 +179,27 @@ int main()
     Model planet(CMAKE_SOURCE_DIR"/resources/objects/planet/planet.obj");
     Model rock(CMAKE_SOURCE_DIR"/resources/objects/rock/rock.obj");
 
-    constexpr unsigned int amount = 1000;
-    glm::mat4 *modelMatrices, *normalMatrices;
-    modelMatrices = new glm::mat4[amount];
-    normalMatrices = new glm::mat4[amount];
-    srand(glfwGetTime()); // 初始化随机种子    
-    float radius = 20.0;
-    float offset = 2.5f;
-    for(unsigned int i = 0; i < amount; i++)
-    {
-        glm::mat4 model;
-        // 1. 位移：分布在半径为 'radius' 的圆形上，偏移的范围是 [-offset, offset]
-        float angle = (float)i / (float)amount * 360.0f;
-        float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float x = sin(angle) * radius + displacement;
-        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float y = displacement * 0.4f; // 让行星带的高度比x和z的宽度要小
-        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-        float z = cos(angle) * radius + displacement;
-        model = glm::translate(model, glm::vec3(x, y, z));
-
-        // 2. 缩放：在 0.05 和 0.25f 之间缩放
-        float scale = (rand() % 20) / 100.0f + 0.05;
-        model = glm::scale(model, glm::vec3(scale));
-
-        // 3. 旋转：绕着一个（半）随机选择的旋转轴向量进行随机的旋转
-        float rotAngle = (rand() % 360);
-        model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
-
-        // 4. 添加到矩阵的数组中
-        modelMatrices[i] = model;
-        normalMatrices[i] = glm::transpose(glm::inverse(model));
-    }
-
-    unsigned int modelBuffer, normalBuffer;
-    glGenBuffers(1, &modelBuffer);
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &normalMatrices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // asteroid belt: every rock orbits the planet, the per-rock parameters stay on the CPU and the
+    // instance transforms are rebuilt straight into the streamed buffer each frame
+    constexpr unsigned int MAX_ROCKS = 1000000;
+    ThreadPool pool;
+    AsteroidField asteroids;
+    int rockSeed = 1;
+    auto generateStart = std::chrono::high_resolution_clock::now();
+    asteroids.generate(MAX_ROCKS, BeltParams(), rockSeed, pool);
+    float generateTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - generateStart).count();
+
+    // one stream per instance format: 32 byte position/scale/quaternion or its 16 byte quantized form
+    InstanceStream rockInstances(sizeof(InstanceTransform), MAX_ROCKS);
+    InstanceStream quantizedRockInstances(sizeof(QuantizedInstanceTransform), MAX_ROCKS);
+    addInstanceTransformAttributes(rockInstances, false);
+    addInstanceTransformAttributes(quantizedRockInstances, true);
+    InstanceBounds rockBounds = asteroids.bounds();
+    std::cout << "Instance streaming: " << (rockInstances.persistent() ? "persistent mapping" : "buffer orphaning") << std::endl;
+    // GPU animation: transform feedback writes the transforms straight into a buffer the rock VAOs read
+    Shader orbitAnimateShader(CMAKE_SOURCE_DIR"/shaders/instancing/orbit_animate_vert.glsl", { "positionScale", "rotation" });
+    OrbitAnimator orbitAnimator(orbitAnimateShader, asteroids);
 
-    for (const auto &mesh : rock.meshes)
-    {
-        unsigned int VAO = mesh.getVAO();
-        glBindVertexArray(VAO);
-        // set attribute pointers for matrix (4 times vec4)
-        glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-        // set attribute pointers for normal matrix (3 times vec4)
-        glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-        glEnableVertexAttribArray(7);
-        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-        glEnableVertexAttribArray(8);
-        glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(9);
-        glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glVertexAttribDivisor(3, 1);
-        glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
-        glVertexAttribDivisor(7, 1);
-        glVertexAttribDivisor(8, 1);
-        glVertexAttribDivisor(9, 1);
-        glBindVertexArray(0);
-    }
-    
     // transform properties
     float imgui_background_alpha = 0.5f;
 
@@ -268,16 +225,31 @@ int main()
     bool postProcessing = false;
     float offsetScale = 0.005f;
     float offsetFreq = 20.0f;
+    // asteroids
+    int amount = 1000;
+    bool animateRocks = true;
+    float orbitSpeed = 0.05f;
+    float spinSpeed = 1.0f;
+    float rockTime = 0.0f;
+    float simulateTimeMs = 0.0f;
+    const char *instanceFormats[] = { "quaternion 32B", "quantized 16B" };
+    int instanceFormat = 1;
+    const char *animationModes[] = { "CPU threads", "GPU transform feedback" };
+    int animationMode = 1;
     
     /***** render loop *****/
     while(!glfwWindowShouldClose(window))
     {
         // inputs
         // ------
-        float currentTime = glfwGetTime();
+        float currentTime = cameraPath.time(glfwGetTime());
         deltaTime = currentTime - lastFrame;
         lastFrame = currentTime;
-        processInput(window); // read input
+        // a playing camera path drives the camera, the rest of the input is still read
+        processInput(window, !cameraPath.apply(camera, currentTime)); // read input
+        cameraPath.record(camera, currentTime);
+        if (cameraPath.finished())
+            glfwSetWindowShouldClose(window, true);
 
         // imgui loop start
         ImGui_ImplOpenGL3_NewFrame();
@@ -325,8 +297,73 @@ int main()
         ImGui::Checkbox("postProcessing", &postProcessing);
         ImGui::DragFloat("offsetScale", &offsetScale, 0.001f);
         ImGui::DragFloat("offsetFreq", &offsetFreq, 0.1f);
+        ImGui::Text("Asteroids");
+        ImGui::SliderInt("amount", &amount, 1, MAX_ROCKS);
+        ImGui::Checkbox("animate", &animateRocks);
+        ImGui::SliderFloat("orbitSpeed", &orbitSpeed, 0.0f, 0.5f);
+        ImGui::SliderFloat("spinSpeed", &spinSpeed, 0.0f, 5.0f);
+        ImGui::Combo("animation", &animationMode, animationModes, IM_ARRAYSIZE(animationModes));
+        bool gpuAnimation = animationMode == 1;
+        if (!gpuAnimation)
+            ImGui::Combo("instanceFormat", &instanceFormat, instanceFormats, IM_ARRAYSIZE(instanceFormats));
+        // the GPU path always writes the 32 byte format
+        bool quantized = !gpuAnimation && instanceFormat == 1;
+        InstanceStream &instances = quantized ? quantizedRockInstances : rockInstances;
+        if (ImGui::InputInt("seed", &rockSeed))
+        {
+            generateStart = std::chrono::high_resolution_clock::now();
+            asteroids.generate(MAX_ROCKS, BeltParams(), rockSeed, pool);
+            generateTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - generateStart).count();
+            orbitAnimator.upload(asteroids);
+        }
+        ImGui::Text("generate %.2f ms, %u threads", generateTimeMs, pool.size());
+        if (gpuAnimation)
+        {
+            ImGui::Text("%zu bytes/instance, %.2f MB", sizeof(InstanceTransform), sizeof(InstanceTransform) * orbitAnimator.count / (1024.0f * 1024.0f));
+            ImGui::Text("simulate cpu %.2f ms, gpu %.2f ms", simulateTimeMs, orbitAnimator.timer.elapsedMs);
+        }
+        else
+        {
+            ImGui::Text("%s", instances.persistent() ? "persistent mapping" : "buffer orphaning");
+            ImGui::Text("%zu bytes/instance, %.2f MB", instances.stride, instances.stride * instances.count / (1024.0f * 1024.0f));
+            ImGui::Text("simulate %.2f ms", simulateTimeMs);
+            ImGui::Text("upload %.1f MB/s", instances.uploadMBps);
+            ImGui::Text("cpu wait %.3f ms", instances.waitTimeMs);
+        }
+        ImGui::Text("%.2f ms/frame", 1000.0f / ImGui::GetIO().Framerate);
         ImGui::End();
 
+        // simulate the asteroids: on the GPU with transform feedback, or on the CPU writing the
+        // instance data into this frame's region of the stream
+        // ------------------------------------------------------------------------------------------
+        if (animateRocks)
+            rockTime += deltaTime;
+        auto simulateStart = std::chrono::high_resolution_clock::now();
+        unsigned int rockCount = 0;
+        // a failed map leaves nothing to unmap or fence, and this frame draws no rocks
+        bool rocksMapped = false;
+        if (gpuAnimation)
+        {
+            orbitAnimator.animate(amount, rockTime, orbitSpeed, spinSpeed);
+            for (const auto &mesh : rock.meshes)
+                orbitAnimator.bind(mesh.getVAO());
+            rockCount = orbitAnimator.count;
+        }
+        else
+        {
+            void *rocks = instances.map(amount);
+            rocksMapped = rocks != nullptr;
+            if (rocksMapped)
+            {
+                asteroids.buildParallel(rocks, instances.count, quantized, rockBounds, rockTime, orbitSpeed, spinSpeed, pool);
+                instances.unmap();
+                for (const auto &mesh : rock.meshes)
+                    instances.bind(mesh.getVAO());
+                rockCount = instances.count;
+            }
+        }
+        simulateTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - simulateStart).count();
+
         // render
         // ------
         // planet
@@ -391,10 +428,13 @@ int main()
 
         // planet.Draw(instancingShader);
 
-        rock.DrawInstanced(instancingShader, amount);
+        setInstanceBounds(instancingShader, quantized, rockBounds);
+        rock.DrawInstanced(instancingShader, rockCount);
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (rocksMapped)
+            instances.fence();
 
         glfwSwapBuffers(window);
         glfwPollEvents(); // poll IO events
@@ -449,7 +489,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+void processInput(GLFWwindow *window, bool moveCamera)
 {
     ImGuiIO &io = ImGui::GetIO();
     interactWithUI = io.WantCaptureMouse;
@@ -457,6 +497,9 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (!moveCamera)
+        return;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(Camera_Movement::FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
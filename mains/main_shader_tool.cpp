@@ -0,0 +1,222 @@
+#include "shader_preprocessor.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <ctime>
+
+// Build-time helper of the validate_shaders target (cmake/validate_shader.cmake), no window or
+// GL context needed.
+// Usage: main_shader_tool expand <input> <output> [NAME[=VALUE]...]
+//        main_shader_tool count <module.spv>
+//        main_shader_tool report <history.csv> <stats list>
+//
+// The history csv keeps the instruction counts over time: every report appends a row, tagged with
+// the UTC time of the build, for each shader whose counts changed, and the newest row of a shader
+// is what the next report compares against.
+
+// writes input with its #includes pasted in and the defines injected, as Shader would compile it
+int expand(int argc, char **argv)
+{
+    ShaderDefines defines;
+    for (int i = 4; i < argc; ++i)
+    {
+        std::string define = argv[i];
+        size_t equals = define.find('=');
+        defines[define.substr(0, equals)] = equals == std::string::npos ? "" : define.substr(equals + 1);
+    }
+    std::string source;
+    try
+    {
+        source = ShaderPreprocessor::process(argv[2], defines);
+    }
+    catch (std::ifstream::failure &e)
+    {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << argv[2] << std::endl;
+        return 1;
+    }
+    std::ofstream output(argv[3]);
+    if (!(output << source))
+    {
+        std::cerr << "ERROR::SHADER_TOOL:: Could not write " << argv[3] << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// prints the number of instructions inside function bodies of a SPIR-V module, names and
+// decorations excluded, so the count follows the code the driver gets
+int count(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint32_t> words;
+    uint32_t word;
+    while (file.read((char *)&word, sizeof(word)))
+        words.push_back(word);
+    if (words.size() < 5 || words[0] != 0x07230203)
+    {
+        std::cerr << "ERROR::SHADER_TOOL:: " << path << " is not a SPIR-V module" << std::endl;
+        return 1;
+    }
+    const uint32_t OP_FUNCTION = 54, OP_FUNCTION_END = 56;
+    unsigned int instructions = 0;
+    bool inFunction = false;
+    for (size_t i = 5; i < words.size(); )
+    {
+        uint32_t wordCount = words[i] >> 16, opcode = words[i] & 0xFFFF;
+        if (wordCount == 0)
+        {
+            std::cerr << "ERROR::SHADER_TOOL:: " << path << " is truncated" << std::endl;
+            return 1;
+        }
+        if (opcode == OP_FUNCTION)
+            inFunction = true;
+        else if (opcode == OP_FUNCTION_END)
+            inFunction = false;
+        else if (inFunction)
+            ++instructions;
+        i += wordCount;
+    }
+    std::cout << instructions;
+    return 0;
+}
+
+struct ShaderStats
+{
+    std::string stage, before, after;
+};
+
+// "shader,stage,unoptimized,optimized" lines, "-" where no SPIR-V could be generated
+void readStats(std::istream &input, std::map<std::string, ShaderStats> &stats)
+{
+    std::string line;
+    while (std::getline(input, line))
+    {
+        std::stringstream fields(line);
+        std::string name;
+        ShaderStats shader;
+        if (std::getline(fields, name, ',') && std::getline(fields, shader.stage, ',') &&
+            std::getline(fields, shader.before, ',') && std::getline(fields, shader.after) && name != "shader")
+            stats[name] = shader;
+    }
+}
+
+const char *HISTORY_HEADER = "time,shader,stage,unoptimized,optimized";
+
+// "time,shader,stage,unoptimized,optimized" lines, oldest first, the newest row of each shader
+// ends up in latest. false if the file is missing or is not a history (the single snapshot
+// written before the history was kept)
+bool readHistory(std::istream &input, std::map<std::string, ShaderStats> &latest)
+{
+    std::string line;
+    if (!std::getline(input, line) || line != HISTORY_HEADER)
+        return false;
+    std::stringstream rows;
+    while (std::getline(input, line))
+    {
+        // drop the time, the rest is a stats line
+        size_t comma = line.find(',');
+        if (comma != std::string::npos)
+            rows << line.substr(comma + 1) << "\n";
+    }
+    readStats(rows, latest);
+    return true;
+}
+
+// collects the per-shader stats files listed in the stats list, prints the shaders whose optimized
+// count changed since the last build, with the totals, and appends the changes to the history csv
+int report(const char *historyPath, const char *listPath)
+{
+    std::map<std::string, ShaderStats> previous, current;
+    std::ifstream history(historyPath);
+    bool isHistory = readHistory(history, previous);
+    if (!isHistory && history)
+    {
+        // a snapshot from an older build is still what this build changed from
+        history.clear();
+        history.seekg(0);
+        readStats(history, previous);
+        std::cout << "SHADER_TOOL:: " << historyPath << " is not a history, starting a new one" << std::endl;
+    }
+    history.close();
+    std::ifstream list(listPath);
+    std::string statsPath;
+    while (std::getline(list, statsPath))
+    {
+        std::ifstream stats(statsPath);
+        if (!statsPath.empty() && !stats)
+        {
+            std::cerr << "ERROR::SHADER_TOOL:: Could not read " << statsPath << std::endl;
+            return 1;
+        }
+        readStats(stats, current);
+    }
+
+    long long totalBefore = 0, totalAfter = 0;
+    unsigned int changed = 0;
+    std::cout << std::left << std::setw(56) << "shader" << std::right << std::setw(12) << "unoptimized" << std::setw(12)
+              << "optimized" << std::setw(10) << "change" << std::endl;
+    for (const auto &shader : current)
+    {
+        if (shader.second.after != "-")
+        {
+            totalBefore += std::stoll(shader.second.before);
+            totalAfter += std::stoll(shader.second.after);
+        }
+        auto last = previous.find(shader.first);
+        if (last != previous.end() && last->second.after == shader.second.after)
+            continue;
+        ++changed;
+        std::string change = "new";
+        if (last != previous.end() && last->second.after != "-" && shader.second.after != "-")
+        {
+            long long delta = std::stoll(shader.second.after) - std::stoll(last->second.after);
+            change = (delta > 0 ? "+" : "") + std::to_string(delta);
+        }
+        std::cout << std::left << std::setw(56) << shader.first << std::right << std::setw(12) << shader.second.before
+                  << std::setw(12) << shader.second.after << std::setw(10) << change << std::endl;
+    }
+    std::cout << std::left << std::setw(56) << "total (" + std::to_string(current.size()) + " shaders, " + std::to_string(changed) + " changed)"
+              << std::right << std::setw(12) << totalBefore << std::setw(12) << totalAfter << std::endl;
+
+    char time[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    std::ofstream output(historyPath, isHistory ? std::ios::app : std::ios::trunc);
+    if (!isHistory)
+        output << HISTORY_HEADER << "\n";
+    for (const auto &shader : current)
+    {
+        auto last = previous.find(shader.first);
+        if (isHistory && last != previous.end() && last->second.stage == shader.second.stage &&
+            last->second.before == shader.second.before && last->second.after == shader.second.after)
+            continue;
+        output << time << "," << shader.first << "," << shader.second.stage << "," << shader.second.before << "," << shader.second.after << "\n";
+    }
+    if (!output)
+    {
+        std::cerr << "ERROR::SHADER_TOOL:: Could not write " << historyPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "expand" && argc >= 4)
+        return expand(argc, argv);
+    if (command == "count" && argc == 3)
+        return count(argv[2]);
+    if (command == "report" && argc == 4)
+        return report(argv[2], argv[3]);
+    std::cerr << "Usage: main_shader_tool expand <input> <output> [NAME[=VALUE]...]\n"
+                 "       main_shader_tool count <module.spv>\n"
+                 "       main_shader_tool report <history.csv> <stats list>" << std::endl;
+    return 1;
+}
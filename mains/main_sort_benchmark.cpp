@@ -0,0 +1,136 @@
+#include "depth_sorter.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <cmath>
+
+// Console benchmark for sorting blended draws back to front, no window or GL context needed.
+// Usage: main_sort_benchmark [maxItemCount]
+
+// best of `runs` wall-clock times in milliseconds
+template <typename F>
+float bestOf(int runs, F &&f)
+{
+    float best = 1e30f;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+void report(const char *name, float ms, size_t count)
+{
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms
+              << " ms  " << std::setw(8) << std::setprecision(1) << count / (ms * 1000.0f) << " M/s" << std::endl;
+}
+
+glm::mat4 orbitView(float angle)
+{
+    glm::vec3 eye(std::sin(angle) * 15.0f, 3.0f, std::cos(angle) * 15.0f);
+    return glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// farthest first?
+bool isBackToFront(const std::vector<unsigned int> &order, const std::vector<glm::vec3> &centers, const glm::mat4 &view)
+{
+    for (size_t i = 1; i < order.size(); i++)
+        if ((view * glm::vec4(centers[order[i - 1]], 1.0f)).z > (view * glm::vec4(centers[order[i]], 1.0f)).z + 1e-4f)
+            return false;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t maxCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const int RUNS = 5;
+    bool correct = true, reused = true;
+
+    for (size_t count = 10000; count <= maxCount; count *= 10)
+    {
+        std::cout << count << " items" << std::endl;
+        std::vector<glm::vec3> centers(count);
+        auto random = [](float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); };
+        srand(37);
+        for (auto &c : centers)
+            c = glm::vec3(random(-10.0f, 10.0f), random(-2.0f, 6.0f), random(-10.0f, 10.0f));
+        glm::mat4 view = orbitView(0.3f);
+        glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+
+        // 1. the blending chapter's approach: a map from distance to position, iterated in reverse.
+        //    Items at exactly the same distance collapse into one entry.
+        size_t mapped = 0;
+        float ms = bestOf(RUNS, [&] {
+            std::map<float, glm::vec3> sorted;
+            for (size_t i = 0; i < count; i++)
+                sorted[glm::length(cameraPos - centers[i])] = centers[i];
+            mapped = 0;
+            for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+                mapped++;
+        });
+        report("std::map<float, glm::vec3>", ms, count);
+
+        // 2. comparison sort of indices by precomputed distance
+        std::vector<float> distances(count);
+        std::vector<unsigned int> indices(count);
+        ms = bestOf(RUNS, [&] {
+            for (size_t i = 0; i < count; i++)
+                distances[i] = glm::dot(cameraPos - centers[i], cameraPos - centers[i]);
+            std::iota(indices.begin(), indices.end(), 0u);
+            std::sort(indices.begin(), indices.end(), [&](unsigned int a, unsigned int b) { return distances[a] > distances[b]; });
+        });
+        report("std::sort, indices", ms, count);
+
+        // 3. radix sort from scratch every frame
+        DepthSorter sorter(0);
+        ms = bestOf(RUNS, [&] { sorter.sort(centers.data(), count, view); });
+        report("DepthSorter, radix", ms, count);
+        correct = correct && isBackToFront(sorter.order, centers, view);
+
+        // 4. static camera: the previous order is still valid
+        DepthSorter coherent;
+        coherent.sort(centers.data(), count, view);
+        ms = bestOf(RUNS, [&] { coherent.sort(centers.data(), count, view); });
+        report("DepthSorter, static camera", ms, count);
+        correct = correct && coherent.lastMethod == DepthSorter::COHERENT && isBackToFront(coherent.order, centers, view);
+
+        // 5. camera orbiting slowly: each frame starts from the previous order. Slowly is relative to
+        //    how densely the items fill the depth range, the step moves an item past a third of a
+        //    neighbour on average, so denser scenes get smaller steps
+        float angle = 0.3f, step = 2.0f / count;
+        int coherentFrames = 0;
+        ms = bestOf(RUNS, [&] {
+            angle += step;
+            coherent.sort(centers.data(), count, orbitView(angle));
+            coherentFrames += coherent.lastMethod == DepthSorter::COHERENT;
+        });
+        report("DepthSorter, small camera motion", ms, count);
+        correct = correct && isBackToFront(coherent.order, centers, orbitView(angle));
+        reused = reused && coherentFrames == RUNS;
+
+        // 6. camera cut: the repair gives up and falls back to the radix sort
+        ms = bestOf(RUNS, [&] {
+            angle += 2.0f;
+            coherent.sort(centers.data(), count, orbitView(angle));
+        });
+        report("DepthSorter, camera cut", ms, count);
+        correct = correct && isBackToFront(coherent.order, centers, orbitView(angle));
+
+        std::cout << "  std::map kept " << mapped << " of " << count << " items, "
+                  << coherentFrames << "/" << RUNS << " small-motion frames reused the previous order" << std::endl;
+    }
+    std::cout << "orders back to front: " << (correct ? "yes" : "NO") << std::endl;
+    std::cout << "small camera motion repaired in place: " << (reused ? "yes" : "NO") << std::endl;
+    return correct && reused ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+// Light structs of the lit shaders. common/uniforms.glsl keeps them in its LightData block, the
+// older shaders declare plain uniform arrays of NR_POINT_LIGHTS, which can be injected as a define.
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
@@ -0,0 +1,76 @@
+// Textures of a model's mesh (bound by Mesh::Draw) and their lookups. A texture is only sampled
+// if the variant defines HAS_<TYPE>_MAP (Mesh::variantDefines); without it the lookup returns
+// the constant the default texture bound in its place would give, without the fetch.
+// Needs common/uniforms.glsl for bumpScale and heightScale.
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    sampler2D texture_reflect1;
+    sampler2D texture_normal1;
+    sampler2D texture_height1;
+};
+
+uniform Material material;
+
+// steep parallax mapping with a linear interpolation between the last two layers
+vec2 MaterialTexCoords(vec2 texCoords, vec3 viewDirTangentSpace)
+{
+#ifdef HAS_HEIGHT_MAP
+    const float numLayers = 50;
+    float layerDepth = 1.0 / numLayers;
+    float currentLayerDepth = 0.0;
+    vec2 P = viewDirTangentSpace.xy / clamp(viewDirTangentSpace.z, 0.1, 1.0) * heightScale;
+    vec2 deltaTexCoords = P / numLayers;
+    vec2 currentTexCoords = texCoords;
+    float currentDepthMapValue = texture(material.texture_height1, currentTexCoords).r;
+    while (currentLayerDepth < currentDepthMapValue)
+    {
+        currentTexCoords -= deltaTexCoords;
+        currentDepthMapValue = texture(material.texture_height1, currentTexCoords).r;
+        currentLayerDepth += layerDepth;
+    }
+    vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
+
+    float afterDepth = currentDepthMapValue - currentLayerDepth;
+    float beforeDepth = texture(material.texture_height1, prevTexCoords).r - currentLayerDepth + layerDepth;
+
+    float weight = afterDepth / (afterDepth - beforeDepth);
+    return currentTexCoords * (1.0 - weight) + prevTexCoords * weight;
+#else
+    return texCoords;
+#endif
+}
+
+// world space normal, the geometric one without a normal map
+vec3 MaterialNormal(mat3 TBN, vec2 texCoords)
+{
+#ifdef HAS_NORMAL_MAP
+    vec3 tNormal = texture(material.texture_normal1, texCoords).rgb;
+    tNormal = normalize(tNormal * 2.0 - 1.0);
+    tNormal = normalize(vec3(tNormal.xy * bumpScale, tNormal.z));
+    return normalize(TBN * tNormal);
+#else
+    return normalize(TBN[2]);
+#endif
+}
+
+// texture values as stored (gamma encoded), white without a diffuse map
+vec3 MaterialDiffuse(vec2 texCoords)
+{
+#ifdef HAS_DIFFUSE_MAP
+    return texture(material.texture_diffuse1, texCoords).rgb;
+#else
+    return vec3(1.0);
+#endif
+}
+
+// black without a specular map
+vec3 MaterialSpecular(vec2 texCoords)
+{
+#ifdef HAS_SPECULAR_MAP
+    return texture(material.texture_specular1, texCoords).rgb;
+#else
+    return vec3(0.0);
+#endif
+}
@@ -0,0 +1,60 @@
+// Shadow map lookups shared by the lit shaders. viewPos and far_plane (far plane of the point
+// light's shadow cubemap) have to be declared before including, by common/uniforms.glsl or as
+// plain uniforms. Both return the shadowed fraction, 0 is fully lit.
+
+uniform sampler2D dirShadowMap;
+uniform samplerCube pointShadowMap;
+
+vec3 sampleOffsetDirections[20] = vec3[]
+(
+   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
+   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+);
+
+// 20 taps around the light-to-fragment direction, the disk grows with the view distance
+float PointShadowCalculation(vec3 fragPos, vec3 lightPos, float bias)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    float shadow = 0.0;
+    int samples = 20;
+    float viewDistance = length(viewPos - fragPos);
+    float diskRadius = (0.1 + (viewDistance / far_plane)) / 25.0;
+    float currentDepth = length(fragToLight);
+    for (int i = 0; i < samples; ++i)
+    {
+        float closestDepth = texture(pointShadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
+        closestDepth *= far_plane;
+        shadow += currentDepth - bias > closestDepth ? 1.0 : 0.0;
+    }
+    shadow /= float(samples);
+    return shadow;
+}
+
+// PCF over (2 * pcf_radius + 1)^2 texels
+float DirShadowCalculation(vec4 fragPosLightSpace, float bias, int pcf_radius)
+{
+    // perform perspective divide
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    // transform to [0,1] range
+    projCoords = projCoords * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
+    // get depth of current fragment from light's perspective
+    float currentDepth = projCoords.z;
+    // check whether current frag pos is in shadow
+    float shadow = 0.0;
+    vec2 texelSize = 1.0 / textureSize(dirShadowMap, 0);
+    for (int x = -pcf_radius; x <= pcf_radius; ++x)
+    {
+        for (int y = -pcf_radius; y <= pcf_radius; ++y)
+        {
+            float pcf_depth = texture(dirShadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
+            shadow += currentDepth - bias > pcf_depth ? 1.0 : 0.0;
+        }
+    }
+    shadow /= pow(2.0 * pcf_radius + 1.0, 2.0);
+    return shadow;
+}
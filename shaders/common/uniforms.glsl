@@ -0,0 +1,34 @@
+// Shared std140 uniform blocks. The C++ mirror is in includes/uniform_blocks.h and the binding
+// points are assigned by Shader on link, so including this file is all a shader has to do.
+// Block members are global names: a shader that includes this file must not redeclare them.
+
+#include "lights.glsl"
+
+#define MAX_POINT_LIGHTS 4
+
+// written once per frame
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 invViewProjection;
+    vec3 viewPos;
+    float gamma;
+    float time;
+};
+
+// written once per frame, shared by every lit shader
+layout (std140) uniform LightData {
+    mat4 lightSpaceMatrix;
+    DirLight dirLight;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    int numPointLights;
+    // far plane of the point light shadow cubemap
+    float far_plane;
+};
+
+// scalar material parameters, textures stay in the Material struct of each shader
+layout (std140) uniform MaterialData {
+    float shininess;
+    float bumpScale;
+    float heightScale;
+};
@@ -0,0 +1,39 @@
+#version 330 core
+// rgb10a2: octahedral normal (rg), shininess / 256 (b)
+layout (location = 0) out vec4 gNormalShininess;
+// rgba8: albedo (rgb), specular intensity (a)
+layout (location = 1) out vec4 gAlbedoSpec;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    mat3 TBN;
+} fs_in;
+
+// permutations: HAS_DIFFUSE_MAP, HAS_SPECULAR_MAP, HAS_NORMAL_MAP, HAS_HEIGHT_MAP (common/material.glsl)
+#include "../common/uniforms.glsl"
+#include "../common/material.glsl"
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    mat3 worldToTangent = transpose(fs_in.TBN);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDirTangentSpace = normalize(worldToTangent * viewDir);
+    vec2 texCoords = MaterialTexCoords(fs_in.TexCoords, viewDirTangentSpace);
+    vec3 normal = MaterialNormal(fs_in.TBN, texCoords);
+
+    gNormalShininess = vec4(EncodeNormal(normal), clamp(shininess / 256.0, 0.0, 1.0), 0.0);
+    gAlbedoSpec = vec4(MaterialDiffuse(texCoords), MaterialSpecular(texCoords).r);
+}
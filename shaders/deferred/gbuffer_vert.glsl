@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec2 TexCoords;
+    mat3 TBN;
+} vs_out;
+
+#include "../common/uniforms.glsl"
+
+uniform mat4 model;
+uniform mat4 normalMatrix;
+
+invariant gl_Position;
+
+void main()
+{
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+    vs_out.TexCoords = aTexCoords;
+    vec3 T = normalize(mat3(model) * aTangent);
+    vec3 B = normalize(mat3(model) * aBitangent);
+    vec3 N = normalize(mat3(normalMatrix) * aNormal);
+    vs_out.TBN = mat3(T, B, N);
+}
@@ -0,0 +1,68 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gNormalShininess;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+
+#include "../common/uniforms.glsl"
+
+uniform vec3 clearColor;
+uniform bool showNormals;
+
+vec3 DecodeNormal(vec2 f)
+{
+    f = f * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ReconstructPosition(vec2 uv, float depth)
+{
+    vec4 world = invViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
+
+#include "../common/shadows.glsl"
+
+void main()
+{
+    float depth = texture(gDepth, TexCoords).r;
+    if (depth == 1.0)
+    {
+        // nothing was rasterized here, keep the clear color (already gamma encoded)
+        FragColor = vec4(pow(clearColor, vec3(gamma)), 1.0);
+        return;
+    }
+    vec4 normalShininess = texture(gNormalShininess, TexCoords);
+    vec3 normal = DecodeNormal(normalShininess.rg);
+    if (showNormals)
+    {
+        FragColor = vec4(pow(normal * 0.5 + 0.5, vec3(gamma)), 1.0);
+        return;
+    }
+    float shininess = normalShininess.b * 256.0;
+    vec4 albedoSpec = texture(gAlbedoSpec, TexCoords);
+    vec3 albedo = pow(albedoSpec.rgb, vec3(gamma));
+    vec3 smoothness = vec3(pow(albedoSpec.a, gamma));
+    vec3 fragPos = ReconstructPosition(TexCoords, depth);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayVector = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(halfwayVector, normal), 0.0), shininess);
+
+    vec3 ambient = dirLight.ambient * albedo;
+    vec3 diffuse = dirLight.diffuse * diff * albedo;
+    vec3 specular = dirLight.specular * spec * smoothness;
+    float bias = max(0.02 * (1.0 - dot(normal, lightDir)), 0.01);
+    float shadow = DirShadowCalculation(lightSpaceMatrix * vec4(fragPos, 1.0), bias, 3);
+    // linear radiance, point light volumes are added on top and the post-processing graph applies gamma
+    FragColor = vec4(ambient + (diffuse + specular) * (1.0 - shadow), 1.0);
+}
@@ -0,0 +1,64 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D gNormalShininess;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+
+#include "../common/uniforms.glsl"
+
+uniform vec2 screenSize;
+// index into pointLights of the light whose volume is drawn
+uniform int lightIndex;
+uniform bool castShadows;
+
+#include "../common/shadows.glsl"
+
+vec3 DecodeNormal(vec2 f)
+{
+    f = f * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ReconstructPosition(vec2 uv, float depth)
+{
+    vec4 world = invViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
+
+void main()
+{
+    PointLight light = pointLights[lightIndex];
+    vec2 uv = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, uv).r;
+    vec4 normalShininess = texture(gNormalShininess, uv);
+    vec3 normal = DecodeNormal(normalShininess.rg);
+    float shininess = normalShininess.b * 256.0;
+    vec4 albedoSpec = texture(gAlbedoSpec, uv);
+    vec3 albedo = pow(albedoSpec.rgb, vec3(gamma));
+    vec3 smoothness = vec3(pow(albedoSpec.a, gamma));
+    vec3 fragPos = ReconstructPosition(uv, depth);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayVector = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(halfwayVector, normal), 0.0), shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    vec3 ambient = light.ambient * albedo * attenuation;
+    vec3 diffuse = light.diffuse * diff * albedo * attenuation;
+    vec3 specular = light.specular * spec * smoothness * attenuation;
+    float shadow = 0.0;
+    if (castShadows)
+    {
+        float bias = max(0.02 * (1.0 - dot(normal, lightDir)), 0.01);
+        shadow = PointShadowCalculation(fragPos, light.position, bias);
+    }
+    FragColor = vec4(ambient + (diffuse + specular) * (1.0 - shadow), 1.0);
+}
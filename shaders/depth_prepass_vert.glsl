@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+#include "common/uniforms.glsl"
+
+uniform mat4 model;
+
+// must match the depth the shading pass produces bit for bit, otherwise GL_EQUAL rejects it
+invariant gl_Position;
+
+void main()
+{
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
@@ -2,8 +2,9 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 instanceMatrix;
-layout (location = 7) in mat3 instanceNormalMatrix;
+// compact instance transform (includes/instance_transform.h): position + uniform scale, quaternion
+layout (location = 3) in vec4 instancePositionScale;
+layout (location = 4) in vec4 instanceRotation;
 
 
 out vec3 Normal;
@@ -12,11 +13,28 @@ out vec2 TexCoords;
 
 uniform mat4 view;
 uniform mat4 projection;
+// quantized instances arrive as snorm16 relative to the field bounds
+uniform bool quantizedInstances;
+uniform vec3 instanceCenter;
+uniform vec4 instanceExtent; // xyz half size, w max scale
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 void main()
 {
-    FragPos = vec3(instanceMatrix * vec4(aPos, 1.0));
+    vec4 positionScale = instancePositionScale;
+    vec4 rotation = instanceRotation;
+    if (quantizedInstances)
+    {
+        positionScale = vec4(instanceCenter, 0.0) + positionScale * instanceExtent;
+        rotation = normalize(rotation);
+    }
+    FragPos = positionScale.xyz + positionScale.w * rotate(rotation, aPos);
     gl_Position = projection * view * vec4(FragPos, 1.0);
-    Normal = mat3(instanceNormalMatrix) * aNormal;
+    // uniform scale: the normal transform is the rotation alone
+    Normal = rotate(rotation, aNormal);
     TexCoords = aTexCoords;
-}
\ No newline at end of file
+}
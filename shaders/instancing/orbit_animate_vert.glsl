@@ -0,0 +1,23 @@
+#version 330 core
+// Transform feedback pass of includes/orbit_animator.h: one point per rock, nothing is rasterized.
+// The captured outputs have the layout of InstanceTransform (includes/instance_transform.h).
+layout (location = 0) in vec4 aOrbit; // phase, radius, rate, height
+layout (location = 1) in vec2 aSpin;  // scale, spin phase
+
+out vec4 positionScale;
+out vec4 rotation;
+
+uniform float orbitTime; // time * orbitSpeed
+uniform float spinTime;  // time * spinSpeed, wrapped to [0, 4pi)
+uniform vec3 spinAxis;
+
+const float TWO_PI = 6.28318530718;
+
+void main()
+{
+    // wrap before sin/cos, GPU transcendentals lose precision on large arguments
+    float angle = mod(aOrbit.x + orbitTime * aOrbit.z, TWO_PI);
+    positionScale = vec4(sin(angle) * aOrbit.y, aOrbit.w, cos(angle) * aOrbit.y, aSpin.x);
+    float halfAngle = 0.5 * (aSpin.y + spinTime);
+    rotation = vec4(spinAxis * sin(halfAngle), cos(halfAngle));
+}
@@ -7,25 +7,7 @@ struct Material {
     float shininess;
 }; 
 
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "common/lights.glsl"
 
 struct SpotLight {
     vec3 position;
@@ -42,7 +24,9 @@ struct SpotLight {
     vec3 specular;       
 };
 
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 2
+#endif
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -9,27 +9,11 @@ struct Material {
     float shininess;
 }; 
 
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "common/lights.glsl"
 
+#ifndef NR_POINT_LIGHTS
 #define NR_POINT_LIGHTS 1
+#endif
 
 in VS_OUT {
     vec3 FragPos;
@@ -42,8 +26,6 @@ uniform vec3 viewPos;
 uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform Material material;
-uniform sampler2D dirShadowMap;
-uniform samplerCube pointShadowMap;
 
 uniform float far_plane;
 uniform float bumpiness;
@@ -54,57 +36,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 uniform float gamma;
 
-vec3 sampleOffsetDirections[20] = vec3[]
-(
-   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
-   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-);
-
-float PointShadowCalculation(vec3 fragPos, float bias, int pcf_radius = 0)
-{
-    vec3 fragToLight = fragPos - pointLights[0].position;
-    float shadow = 0.0;
-    int samples = 20;
-    float viewDistance = length(viewPos - fragPos);
-    float diskRadius = (0.1 + (viewDistance / far_plane)) / 25.0;
-    float currentDepth = length(fragToLight);
-    for (int i = 0; i < samples; ++i)
-    {
-        float closestDepth = texture(pointShadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
-        closestDepth *= far_plane;
-        shadow += currentDepth - bias > closestDepth ? 1.0 : 0.0;
-    }
-    shadow /= float(samples);
-    return shadow;
-}
-
-float DirShadowCalculation(vec4 fragPosLightSpace, float bias, int pcf_radius = 0)
-{
-    // perform perspective divide
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    // transform to [0,1] range
-    projCoords = projCoords * 0.5 + 0.5;
-    if (projCoords.z > 1.0)
-        return 0.0;
-    // get depth of current fragment from light's perspective
-    float currentDepth = projCoords.z;
-    // check whether current frag pos is in shadow
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(dirShadowMap, 0);
-    for (int x = -pcf_radius; x <= pcf_radius; ++x)
-    {
-        for (int y = -pcf_radius; y <= pcf_radius; ++y)
-        {
-            float pcf_depth = texture(dirShadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += currentDepth - bias > pcf_depth ? 1.0 : 0.0;
-        }
-    }
-    shadow /= pow(2.0 * pcf_radius + 1.0, 2.0);
-    return shadow;
-}
+#include "common/shadows.glsl"
 
 void main()
 {    
@@ -178,6 +110,6 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation;
     // return ambient + (diffuse + specular);
     float bias = max(0.02 * (1.0 - dot(normal, lightDir)), 0.01);
-    float shadow = PointShadowCalculation(fs_in.FragPos, bias);
+    float shadow = PointShadowCalculation(fs_in.FragPos, pointLights[0].position, bias);
     return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 Color;
+in float ViewDepth;
+
+void main()
+{
+    // blended over the target with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, correct only when sorted
+    FragColor = Color;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+out vec4 Color;
+out float ViewDepth;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // the quads are generated in world space
+    vec4 viewPos = view * vec4(aPos, 1.0);
+    Color = aColor;
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
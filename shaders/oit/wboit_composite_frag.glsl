@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+void main()
+{
+    vec4 accum = texture(accumTexture, TexCoords);
+    float revealage = accum.a;
+    // no transparent surface covered this pixel
+    if (revealage >= 1.0)
+        discard;
+    float weight = texture(weightTexture, TexCoords).r;
+    // weighted average of the layers, blended over the opaque target with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    vec3 average = accum.rgb / max(weight, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) out vec4 Accum;
+layout (location = 1) out vec4 Weight;
+
+in vec4 Color;
+in float ViewDepth;
+
+// McGuire and Bavoil 2013, eq. 10: nearer surfaces get a larger weight, the clamp keeps the sums
+// inside half float range
+float DepthWeight(float z, float alpha)
+{
+    return alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+}
+
+void main()
+{
+    float w = DepthWeight(ViewDepth, Color.a);
+    // rgb is summed, a multiplies the revealage (see includes/oit.h)
+    Accum = vec4(Color.rgb * w, Color.a);
+    Weight = vec4(w, 0.0, 0.0, 0.0);
+}
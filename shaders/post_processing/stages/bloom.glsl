@@ -0,0 +1,8 @@
+// pointwise stage: adds the blurred bright pass
+uniform sampler2D bloomTexture;
+uniform float bloomStrength;
+
+vec4 bloom(vec4 color, vec2 uv)
+{
+    return vec4(color.rgb + texture(bloomTexture, uv).rgb * bloomStrength, color.a);
+}
@@ -0,0 +1,18 @@
+// sampling stage: one direction of a separable 9-tap gaussian, 5 bilinear fetches
+uniform sampler2D blurSource;
+uniform vec2 blurSourceTexelSize;
+uniform vec2 blurDirection;
+
+vec4 blur(vec2 uv)
+{
+    const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+    const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+    vec2 stride = blurDirection * blurSourceTexelSize;
+    vec3 color = texture(blurSource, uv).rgb * weights[0];
+    for (int i = 1; i < 3; i++)
+    {
+        color += texture(blurSource, uv + stride * offsets[i]).rgb * weights[i];
+        color += texture(blurSource, uv - stride * offsets[i]).rgb * weights[i];
+    }
+    return vec4(color, 1.0);
+}
@@ -0,0 +1,16 @@
+// sampling stage: half resolution bright pass, the input of the bloom blur
+uniform sampler2D brightSource;
+uniform vec2 brightSourceTexelSize;
+uniform float bloomThreshold;
+
+vec4 bright(vec2 uv)
+{
+    // 4 bilinear taps average a 4x4 block of the full resolution source
+    vec2 d = brightSourceTexelSize;
+    vec3 color = 0.25 * (texture(brightSource, uv + vec2(-d.x, -d.y)).rgb + texture(brightSource, uv + vec2(d.x, -d.y)).rgb +
+                         texture(brightSource, uv + vec2(-d.x, d.y)).rgb + texture(brightSource, uv + vec2(d.x, d.y)).rgb);
+    // soft knee: keep the part of the brightness above the threshold
+    float brightness = max(color.r, max(color.g, color.b));
+    float contribution = max(brightness - bloomThreshold, 0.0) / max(brightness, 1e-4);
+    return vec4(color * contribution, 1.0);
+}
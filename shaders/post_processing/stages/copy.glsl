@@ -0,0 +1,5 @@
+// pointwise stage: passes its input through, e.g. to present a texture the graph does not own
+vec4 copy(vec4 color, vec2 uv)
+{
+    return color;
+}
@@ -0,0 +1,115 @@
+// sampling stage: FXAA (Lottes, 3.11 quality preset 12). Finds the local edge direction from luma,
+// walks along the edge to both ends and samples across it by how far the pixel is from the nearer
+// end; a subpixel term additionally smooths single-pixel features. The source must be linearly
+// filtered and hold display (gamma encoded) values, luma contrast is judged perceptually.
+uniform sampler2D fxaaSource;
+uniform vec2 fxaaSourceTexelSize;
+
+float fxaaLuma(vec2 uv)
+{
+    return dot(texture(fxaaSource, uv).rgb, vec3(0.299, 0.587, 0.114));
+}
+
+vec4 fxaa(vec2 uv)
+{
+    const float EDGE_THRESHOLD_MIN = 0.0312;
+    const float EDGE_THRESHOLD_MAX = 0.125;
+    const float SUBPIXEL_QUALITY = 0.75;
+    const int ITERATIONS = 12;
+    const float QUALITY[12] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+    vec2 texel = fxaaSourceTexelSize;
+
+    vec3 colorCenter = texture(fxaaSource, uv).rgb;
+    float lumaCenter = dot(colorCenter, vec3(0.299, 0.587, 0.114));
+    float lumaDown  = fxaaLuma(uv + vec2( 0.0, -1.0) * texel);
+    float lumaUp    = fxaaLuma(uv + vec2( 0.0,  1.0) * texel);
+    float lumaLeft  = fxaaLuma(uv + vec2(-1.0,  0.0) * texel);
+    float lumaRight = fxaaLuma(uv + vec2( 1.0,  0.0) * texel);
+    float lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float lumaRange = lumaMax - lumaMin;
+    // flat area, nothing to do
+    if (lumaRange < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD_MAX))
+        return vec4(colorCenter, 1.0);
+
+    float lumaDownLeft  = fxaaLuma(uv + vec2(-1.0, -1.0) * texel);
+    float lumaUpRight   = fxaaLuma(uv + vec2( 1.0,  1.0) * texel);
+    float lumaUpLeft    = fxaaLuma(uv + vec2(-1.0,  1.0) * texel);
+    float lumaDownRight = fxaaLuma(uv + vec2( 1.0, -1.0) * texel);
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+    // 1. edge orientation from the second derivatives, then the side with the steeper gradient
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0 + abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0 + abs(-2.0 * lumaDown + lumaDownCorners);
+    bool isHorizontal = edgeHorizontal >= edgeVertical;
+    float luma1 = isHorizontal ? lumaDown : lumaLeft;
+    float luma2 = isHorizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCenter;
+    float gradient2 = luma2 - lumaCenter;
+    bool is1Steepest = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = isHorizontal ? texel.y : texel.x;
+    float lumaLocalAverage;
+    if (is1Steepest)
+    {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaCenter);
+    }
+    else
+        lumaLocalAverage = 0.5 * (luma2 + lumaCenter);
+
+    // 2. walk along the edge, half a pixel towards the steeper side, until the luma leaves the edge
+    vec2 edgeUv = uv;
+    if (isHorizontal)
+        edgeUv.y += stepLength * 0.5;
+    else
+        edgeUv.x += stepLength * 0.5;
+    vec2 offset = isHorizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+    vec2 uv1 = edgeUv - offset * QUALITY[0];
+    vec2 uv2 = edgeUv + offset * QUALITY[0];
+    float lumaEnd1 = 0.0, lumaEnd2 = 0.0;
+    bool reached1 = false, reached2 = false;
+    for (int i = 1; i < ITERATIONS; i++)
+    {
+        if (!reached1)
+            lumaEnd1 = fxaaLuma(uv1) - lumaLocalAverage;
+        if (!reached2)
+            lumaEnd2 = fxaaLuma(uv2) - lumaLocalAverage;
+        reached1 = abs(lumaEnd1) >= gradientScaled;
+        reached2 = abs(lumaEnd2) >= gradientScaled;
+        if (reached1 && reached2)
+            break;
+        if (!reached1)
+            uv1 -= offset * QUALITY[i];
+        if (!reached2)
+            uv2 += offset * QUALITY[i];
+    }
+
+    // 3. the nearer end decides how far to sample across the edge
+    float distance1 = isHorizontal ? uv.x - uv1.x : uv.y - uv1.y;
+    float distance2 = isHorizontal ? uv2.x - uv.x : uv2.y - uv.y;
+    bool isDirection1 = distance1 < distance2;
+    float pixelOffset = -min(distance1, distance2) / (distance1 + distance2) + 0.5;
+    // only if the luma at that end varies the same way as at the center, otherwise the pixel is outside the step
+    bool isLumaCenterSmaller = lumaCenter < lumaLocalAverage;
+    bool correctVariation = ((isDirection1 ? lumaEnd1 : lumaEnd2) < 0.0) != isLumaCenterSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    // 4. subpixel aliasing: the 3x3 low-pass against the center
+    float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+    float subPixelOffset1 = clamp(abs(lumaAverage - lumaCenter) / lumaRange, 0.0, 1.0);
+    float subPixelOffset2 = (-2.0 * subPixelOffset1 + 3.0) * subPixelOffset1 * subPixelOffset1;
+    finalOffset = max(finalOffset, subPixelOffset2 * subPixelOffset2 * SUBPIXEL_QUALITY);
+
+    vec2 finalUv = uv;
+    if (isHorizontal)
+        finalUv.y += finalOffset * stepLength;
+    else
+        finalUv.x += finalOffset * stepLength;
+    return vec4(texture(fxaaSource, finalUv).rgb, 1.0);
+}
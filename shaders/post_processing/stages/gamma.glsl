@@ -0,0 +1,7 @@
+// pointwise stage: linear to display encoding, the last stage before the screen
+#include "../../common/uniforms.glsl"
+
+vec4 gammaEncode(vec4 color, vec2 uv)
+{
+    return vec4(pow(color.rgb, vec3(1.0 / gamma)), 1.0);
+}
@@ -0,0 +1,26 @@
+// sampling stage, SMAA pass 3: neighbourhood blending. Every pixel mixes in its neighbours by the
+// coverage smaa_weights.glsl found on its four edges, along one axis only so corners are not
+// blended twice.
+uniform sampler2D smaaColor;
+uniform sampler2D smaaWeightTexture;
+
+vec4 smaaFetch(sampler2D source, ivec2 p)
+{
+    return texelFetch(source, clamp(p, ivec2(0), textureSize(source, 0) - 1), 0);
+}
+
+vec4 smaaBlend(vec2 uv)
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec4 weights = smaaFetch(smaaWeightTexture, p);
+    float up = weights.r;
+    float down = smaaFetch(smaaWeightTexture, p + ivec2(0, -1)).g;
+    float left = weights.b;
+    float right = smaaFetch(smaaWeightTexture, p + ivec2(1, 0)).a;
+    vec3 color = smaaFetch(smaaColor, p).rgb;
+    if (up + down >= left + right)
+        color = color * (1.0 - up - down) + smaaFetch(smaaColor, p + ivec2(0, 1)).rgb * up + smaaFetch(smaaColor, p + ivec2(0, -1)).rgb * down;
+    else
+        color = color * (1.0 - left - right) + smaaFetch(smaaColor, p + ivec2(-1, 0)).rgb * left + smaaFetch(smaaColor, p + ivec2(1, 0)).rgb * right;
+    return vec4(color, 1.0);
+}
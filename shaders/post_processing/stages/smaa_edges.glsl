@@ -0,0 +1,22 @@
+// sampling stage, SMAA pass 1: luma edge detection.
+// r: edge between this pixel and its left neighbour, g: between this pixel and the one above
+uniform sampler2D smaaEdgeSource;
+uniform float smaaThreshold;
+
+float smaaEdgeLuma(ivec2 p)
+{
+    p = clamp(p, ivec2(0), textureSize(smaaEdgeSource, 0) - 1);
+    return dot(texelFetch(smaaEdgeSource, p, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec4 smaaEdges(vec2 uv)
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    float luma = smaaEdgeLuma(p);
+    vec2 delta = abs(luma - vec2(smaaEdgeLuma(p + ivec2(-1, 0)), smaaEdgeLuma(p + ivec2(0, 1))));
+    vec2 edges = step(vec2(smaaThreshold), delta);
+    // local contrast adaptation: a weak edge next to a much stronger one is a side effect of it
+    float strongest = max(max(delta.x, delta.y), max(abs(luma - smaaEdgeLuma(p + ivec2(1, 0))), abs(luma - smaaEdgeLuma(p + ivec2(0, -1)))));
+    edges *= step(0.5 * strongest, delta);
+    return vec4(edges, 0.0, 1.0);
+}
@@ -0,0 +1,97 @@
+// sampling stage, SMAA pass 2: blending weights. For the edges above and left of the pixel the run
+// of edges is followed to both ends, the crossing edges at the ends give the shape (L, Z or U) and
+// the line through the middle of the steps is intersected with the pixel. SMAA reads that area from
+// a precomputed texture and also handles diagonals; here it is integrated directly and only for
+// orthogonal patterns, which keeps the pass self-contained.
+// r: part of this pixel covered by the colour above, g: part of the pixel above covered by this one
+// b: part of this pixel covered by the colour on the left, a: part of the left pixel covered by this one
+uniform sampler2D smaaEdgeTexture;
+
+const int SMAA_MAX_SEARCH = 16;
+
+vec2 smaaEdge(ivec2 p)
+{
+    ivec2 size = textureSize(smaaEdgeTexture, 0);
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, size)))
+        return vec2(0.0);
+    return texelFetch(smaaEdgeTexture, p, 0).rg;
+}
+
+// number of further pixels in direction dir that continue the run of edges in channel
+int smaaSearch(ivec2 p, ivec2 dir, int channel)
+{
+    int distance = 0;
+    for (int i = 1; i <= SMAA_MAX_SEARCH; i++)
+    {
+        if (smaaEdge(p + dir * i)[channel] < 0.5)
+            break;
+        distance++;
+    }
+    return distance;
+}
+
+// height of the reconstructed line at an end of the run: a crossing edge on this pixel's side of
+// the edge steps towards it (-0.5), one on the other side away from it (+0.5)
+float smaaEndHeight(float nearCrossing, float farCrossing, int distance)
+{
+    // the end was not found, treat it as open
+    if (distance >= SMAA_MAX_SEARCH)
+        return 0.0;
+    return 0.5 * (farCrossing - nearCrossing);
+}
+
+// line height at x for a run from a to b with end heights ha and hb. Both ends on the same side
+// (U shape) gives two lines meeting on the edge in the middle of the run.
+float smaaLine(float x, float a, float b, float ha, float hb)
+{
+    if (ha * hb > 0.0)
+    {
+        float m = 0.5 * (a + b);
+        return x < m ? mix(ha, 0.0, (x - a) / (m - a)) : mix(0.0, hb, (x - m) / (b - m));
+    }
+    return mix(ha, hb, (x - a) / (b - a));
+}
+
+// area between the line and the edge over one pixel, x: on this pixel's side, y: on the other
+vec2 smaaArea(float h0, float h1)
+{
+    if (h0 <= 0.0 && h1 <= 0.0)
+        return vec2(-(h0 + h1) * 0.5, 0.0);
+    if (h0 >= 0.0 && h1 >= 0.0)
+        return vec2(0.0, (h0 + h1) * 0.5);
+    // the line crosses the edge inside the pixel: one triangle on each side
+    float t = h0 / (h0 - h1);
+    return h0 < 0.0 ? vec2(-h0 * t, h1 * (1.0 - t)) * 0.5 : vec2(-h1 * (1.0 - t), h0 * t) * 0.5;
+}
+
+vec2 smaaRunArea(int before, int after, float hBefore, float hAfter)
+{
+    float a = float(-before), b = float(after + 1);
+    return smaaArea(smaaLine(0.0, a, b, hBefore, hAfter), smaaLine(1.0, a, b, hBefore, hAfter));
+}
+
+vec4 smaaWeights(vec2 uv)
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec2 edges = smaaEdge(p);
+    vec4 weights = vec4(0.0);
+    if (edges.g > 0.5)
+    {
+        // horizontal run along x, the crossing edges at its ends are vertical (r)
+        int left = smaaSearch(p, ivec2(-1, 0), 1);
+        int right = smaaSearch(p, ivec2(1, 0), 1);
+        float hLeft = smaaEndHeight(smaaEdge(p + ivec2(-left, 0)).r, smaaEdge(p + ivec2(-left, 1)).r, left);
+        float hRight = smaaEndHeight(smaaEdge(p + ivec2(right + 1, 0)).r, smaaEdge(p + ivec2(right + 1, 1)).r, right);
+        weights.rg = smaaRunArea(left, right, hLeft, hRight);
+    }
+    if (edges.r > 0.5)
+    {
+        // vertical run along y, the crossing edges at its ends are horizontal (g)
+        int down = smaaSearch(p, ivec2(0, -1), 0);
+        int up = smaaSearch(p, ivec2(0, 1), 0);
+        float hDown = smaaEndHeight(smaaEdge(p + ivec2(0, -down - 1)).g, smaaEdge(p + ivec2(-1, -down - 1)).g, down);
+        float hUp = smaaEndHeight(smaaEdge(p + ivec2(0, up)).g, smaaEdge(p + ivec2(-1, up)).g, up);
+        weights.ba = smaaRunArea(down, up, hDown, hUp);
+    }
+    return weights;
+}
@@ -0,0 +1,57 @@
+// sampling stage: temporal anti-aliasing. The current frame was rendered with a sub-pixel jitter
+// (Camera::TemporalJitter); it is blended into the history of the previous frames, reprojected
+// through the depth buffer. Before blending the history is clipped to the YCoCg box of the current
+// 3x3 neighbourhood, which rejects what was disoccluded or changed instead of leaving ghosts.
+// Reprojection only follows camera motion, moving objects would need a velocity buffer.
+uniform sampler2D taaCurrent;
+uniform vec2 taaCurrentTexelSize;
+uniform sampler2D taaHistory;
+uniform sampler2D taaDepth;
+// previous view-projection * inverse(current view-projection), both without jitter
+uniform mat4 taaReprojection;
+// weight of the current frame
+uniform float taaBlend;
+// history is invalid (first frame, resize)
+uniform bool taaReset;
+
+vec3 taaToYCoCg(vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 taaFromYCoCg(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+vec4 taa(vec2 uv)
+{
+    vec3 current = taaToYCoCg(texture(taaCurrent, uv).rgb);
+    vec3 low = current, high = current;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec3 neighbour = taaToYCoCg(texture(taaCurrent, uv + vec2(x, y) * taaCurrentTexelSize).rgb);
+            low = min(low, neighbour);
+            high = max(high, neighbour);
+        }
+    }
+
+    float depth = texture(taaDepth, uv).r;
+    vec4 previous = taaReprojection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+    if (taaReset || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0))))
+        return vec4(taaFromYCoCg(current), 1.0);
+
+    // clip the history towards the box centre, unlike a per channel clamp this keeps its hue
+    vec3 history = taaToYCoCg(texture(taaHistory, previousUv).rgb);
+    vec3 center = 0.5 * (high + low);
+    vec3 extents = 0.5 * (high - low) + 1e-4;
+    vec3 offset = history - center;
+    vec3 units = abs(offset / extents);
+    float outside = max(units.x, max(units.y, units.z));
+    if (outside > 1.0)
+        history = center + offset / outside;
+    return vec4(taaFromYCoCg(mix(history, current, taaBlend)), 1.0);
+}
@@ -0,0 +1,9 @@
+// pointwise stage: exposure and the ACES filmic curve (Narkowicz fit), linear HDR in, linear LDR out
+uniform float exposure;
+
+vec4 tonemap(vec4 color, vec2 uv)
+{
+    vec3 x = color.rgb * exposure;
+    vec3 mapped = clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+    return vec4(mapped, color.a);
+}
@@ -0,0 +1,35 @@
+// sampling stage: Catmull-Rom bicubic upscale from the dynamic render resolution. The 4x4 taps are
+// folded into 9 bilinear fetches by merging the two middle taps of each row and column, so the
+// source must be linearly filtered.
+uniform sampler2D upscaleSource;
+uniform vec2 upscaleSourceTexelSize;
+
+vec4 upscale(vec2 uv)
+{
+    vec2 samplePos = uv / upscaleSourceTexelSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+
+    vec2 texPos0 = (texPos1 - 1.0) * upscaleSourceTexelSize;
+    vec2 texPos3 = (texPos1 + 2.0) * upscaleSourceTexelSize;
+    vec2 texPos12 = (texPos1 + w2 / w12) * upscaleSourceTexelSize;
+
+    vec3 color = vec3(0.0);
+    color += texture(upscaleSource, vec2(texPos0.x,  texPos0.y)).rgb  * w0.x  * w0.y;
+    color += texture(upscaleSource, vec2(texPos12.x, texPos0.y)).rgb  * w12.x * w0.y;
+    color += texture(upscaleSource, vec2(texPos3.x,  texPos0.y)).rgb  * w3.x  * w0.y;
+    color += texture(upscaleSource, vec2(texPos0.x,  texPos12.y)).rgb * w0.x  * w12.y;
+    color += texture(upscaleSource, vec2(texPos12.x, texPos12.y)).rgb * w12.x * w12.y;
+    color += texture(upscaleSource, vec2(texPos3.x,  texPos12.y)).rgb * w3.x  * w12.y;
+    color += texture(upscaleSource, vec2(texPos0.x,  texPos3.y)).rgb  * w0.x  * w3.y;
+    color += texture(upscaleSource, vec2(texPos12.x, texPos3.y)).rgb  * w12.x * w3.y;
+    color += texture(upscaleSource, vec2(texPos3.x,  texPos3.y)).rgb  * w3.x  * w3.y;
+    // the negative lobes overshoot below zero next to bright edges
+    return vec4(max(color, vec3(0.0)), 1.0);
+}
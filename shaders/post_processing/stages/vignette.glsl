@@ -0,0 +1,9 @@
+// pointwise stage: darkens the corners
+uniform float vignetteStrength;
+
+vec4 vignette(vec4 color, vec2 uv)
+{
+    vec2 centered = uv - 0.5;
+    float falloff = 1.0 - vignetteStrength * dot(centered, centered) * 2.0;
+    return vec4(color.rgb * clamp(falloff, 0.0, 1.0), color.a);
+}
@@ -0,0 +1,20 @@
+// sampling stage: animated wave distortion, the effect of post_processing_frag.glsl
+#include "../../common/uniforms.glsl"
+
+uniform sampler2D waveSource;
+uniform float waveScale;
+uniform float waveFrequency;
+
+vec4 wave(vec2 uv)
+{
+    float freq = waveFrequency;
+    float amp = 1.0;
+    vec2 offset = vec2(0.0);
+    for (int i = 0; i < 6; i++)
+    {
+        offset += sin(uv * freq + time * 2.0) * waveScale * amp;
+        amp *= 0.5;
+        freq *= 2.0;
+    }
+    return texture(waveSource, uv + offset);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// per-instance transform written by includes/instance_batcher.h
+layout (location = 5) in mat4 instanceModel;
+
+void main()
+{
+    gl_Position = instanceModel * vec4(aPos, 1.0);
+}
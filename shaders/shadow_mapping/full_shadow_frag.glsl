@@ -3,30 +3,9 @@ out vec4 FragColor;
 
 struct Material {
     sampler2D texture_diffuse1;
-    float shininess;
 }; 
 
-struct DirLight {
-    vec3 direction;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 1
+#include "../common/uniforms.glsl"
 
 in VS_OUT {
     vec3 FragPos;
@@ -35,71 +14,74 @@ in VS_OUT {
     vec4 FragSpaceLightPos;
 } fs_in;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform Material material;
-uniform sampler2D dirShadowMap;
-uniform samplerCube pointShadowMap;
+uniform sampler2D dirMomentMap;
+uniform samplerCube pointMomentMap;
 
-uniform float far_plane;
+// 0: PCF, 1: VSM, 2: EVSM
+uniform int shadowMode;
+uniform float lightBleedReduction;
+uniform float minVariance;
+uniform vec2 evsmExponents;
 
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
-uniform float gamma;
+#include "../common/shadows.glsl"
 
-vec3 sampleOffsetDirections[20] = vec3[]
-(
-   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
-   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-);
+float ReduceLightBleeding(float pMax, float amount)
+{
+    // cut off the tail of the Chebyshev bound, which is where light bleeding comes from
+    return clamp((pMax - amount) / (1.0 - amount), 0.0, 1.0);
+}
 
-float PointShadowCalculation(vec3 fragPos, float bias, int pcf_radius = 0)
+float ChebyshevUpperBound(vec2 moments, float t, float varianceFloor)
 {
-    vec3 fragToLight = fragPos - pointLights[0].position;
-    float shadow = 0.0;
-    int samples = 20;
-    float viewDistance = length(viewPos - fragPos);
-    float diskRadius = (0.1 + (viewDistance / far_plane)) / 25.0;
-    float currentDepth = length(fragToLight);
-    for (int i = 0; i < samples; ++i)
+    if (t <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, varianceFloor);
+    float d = t - moments.x;
+    float pMax = variance / (variance + d * d);
+    return ReduceLightBleeding(pMax, lightBleedReduction);
+}
+
+vec2 WarpDepth(float depth)
+{
+    depth = 2.0 * depth - 1.0;
+    return vec2(exp(evsmExponents.x * depth), -exp(-evsmExponents.y * depth));
+}
+
+// single filtered fetch from a prefiltered moment map, returns the shadow factor
+float MomentShadow(vec4 moments, float depth)
+{
+    if (shadowMode == 2)
     {
-        float closestDepth = texture(pointShadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
-        closestDepth *= far_plane;
-        shadow += currentDepth - bias > closestDepth ? 1.0 : 0.0;
+        vec2 warped = WarpDepth(depth);
+        // scale the variance floor into warped space
+        vec2 depthScale = minVariance * evsmExponents * warped;
+        vec2 varianceFloor = depthScale * depthScale;
+        float positive = ChebyshevUpperBound(moments.xy, warped.x, varianceFloor.x);
+        float negative = ChebyshevUpperBound(moments.zw, warped.y, varianceFloor.y);
+        return 1.0 - min(positive, negative);
     }
-    shadow /= float(samples);
-    return shadow;
+    return 1.0 - ChebyshevUpperBound(moments.xy, depth, minVariance);
 }
 
-float DirShadowCalculation(vec4 fragPosLightSpace, float bias, int pcf_radius = 0)
+float DirMomentShadowCalculation(vec4 fragPosLightSpace)
 {
-    // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
-    if (projCoords.z > 1.0)
+    if (projCoords.z > 1.0 || any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
         return 0.0;
-    // get depth of current fragment from light's perspective
-    float currentDepth = projCoords.z;
-    // check whether current frag pos is in shadow
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(dirShadowMap, 0);
-    for (int x = -pcf_radius; x <= pcf_radius; ++x)
-    {
-        for (int y = -pcf_radius; y <= pcf_radius; ++y)
-        {
-            float pcf_depth = texture(dirShadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
-            shadow += currentDepth - bias > pcf_depth ? 1.0 : 0.0;
-        }
-    }
-    shadow /= pow(2.0 * pcf_radius + 1.0, 2.0);
-    return shadow;
+    return MomentShadow(texture(dirMomentMap, projCoords.xy), projCoords.z);
+}
+
+float PointMomentShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - pointLights[0].position;
+    float depth = length(fragToLight) / far_plane;
+    return MomentShadow(texture(pointMomentMap, fragToLight), depth);
 }
 
 void main()
@@ -118,7 +100,7 @@ void main()
     vec3 result = vec3(0.0);
     result += CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+    for(int i = 0; i < numPointLights; i++)
         result += CalcPointLight(pointLights[i], norm, fs_in.FragPos, viewDir);    
     
     FragColor = vec4(pow(result, vec3(1 / gamma)), 1.0);
@@ -132,7 +114,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayVector = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(halfwayVector, normal), 0.0), material.shininess);
+    float spec = pow(max(dot(halfwayVector, normal), 0.0), shininess);
     // combine results
 
     vec3 albedo = pow(vec3(texture(material.texture_diffuse1, fs_in.TexCoords)), vec3(gamma));
@@ -141,7 +123,8 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 diffuse = light.diffuse * diff * albedo;
     vec3 specular = light.specular * spec;
     float bias = max(0.02 * (1.0 - dot(normal, lightDir)), 0.01);
-    float shadow = DirShadowCalculation(fs_in.FragSpaceLightPos, bias, 3);
+    float shadow = shadowMode == 0 ? DirShadowCalculation(fs_in.FragSpaceLightPos, bias, 3)
+                                   : DirMomentShadowCalculation(fs_in.FragSpaceLightPos);
     return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
 
@@ -153,7 +136,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayVector = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(halfwayVector, normal), 0.0), material.shininess);
+    float spec = pow(max(dot(halfwayVector, normal), 0.0), shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -169,6 +152,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation;
     // return ambient + (diffuse + specular);
     float bias = max(0.02 * (1.0 - dot(normal, lightDir)), 0.01);
-    float shadow = PointShadowCalculation(fs_in.FragPos, bias);
+    float shadow = shadowMode == 0 ? PointShadowCalculation(fs_in.FragPos, pointLights[0].position, bias)
+                                   : PointMomentShadowCalculation(fs_in.FragPos);
     return (ambient + (diffuse + specular) * (1.0 - shadow));
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance transform written by includes/instance_batcher.h
+layout (location = 5) in mat4 instanceModel;
+layout (location = 9) in mat3 instanceNormalMatrix;
 
 out VS_OUT {
     vec3 FragPos;
@@ -14,17 +17,13 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 normalMatrix;
-uniform mat4 lightSpaceMatrix;
+#include "../common/uniforms.glsl"
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.FragPos = vec3(instanceModel * vec4(aPos, 1.0));
     gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
-    vs_out.Normal = mat3(normalMatrix) * aNormal;
+    vs_out.Normal = instanceNormalMatrix * aNormal;
     vs_out.TexCoords = aTexCoords;
     vs_out.FragSpaceLightPos = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
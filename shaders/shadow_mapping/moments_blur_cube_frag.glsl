@@ -0,0 +1,40 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in int Face;
+
+uniform samplerCube moments;
+// 0: blur along the face s axis, 1: along the face t axis
+uniform int axis;
+// 2.0 / face size, one texel in [-1, 1] face coordinates
+uniform float texelSize;
+uniform int radius;
+
+// direction through face texel (sc, tc), see the cube map face selection table in the GL spec
+vec3 FaceDirection(int face, float sc, float tc)
+{
+    if (face == 0) return vec3( 1.0, -tc, -sc);
+    if (face == 1) return vec3(-1.0, -tc,  sc);
+    if (face == 2) return vec3(  sc, 1.0,  tc);
+    if (face == 3) return vec3(  sc,-1.0, -tc);
+    if (face == 4) return vec3(  sc, -tc, 1.0);
+    return vec3(-sc, -tc, -1.0);
+}
+
+void main()
+{
+    vec2 st = gl_FragCoord.xy * texelSize - 1.0;
+    vec3 center = FaceDirection(Face, st.x, st.y);
+    vec3 step = FaceDirection(Face, st.x + (axis == 0 ? texelSize : 0.0), st.y + (axis == 1 ? texelSize : 0.0)) - center;
+
+    float sigma = max(float(radius) * 0.5, 0.5);
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        float weight = exp(-0.5 * float(i * i) / (sigma * sigma));
+        sum += weight * textureLod(moments, center + step * float(i), 0.0);
+        weightSum += weight;
+    }
+    FragColor = sum / weightSum;
+}
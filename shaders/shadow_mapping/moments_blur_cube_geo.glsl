@@ -0,0 +1,20 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+flat out int Face;
+
+void main()
+{
+    for (int face = 0; face < 6; ++face)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            gl_Layer = face;
+            Face = face;
+            gl_Position = gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D moments;
+// one texel along the blur axis
+uniform vec2 direction;
+uniform int radius;
+
+void main()
+{
+    float sigma = max(float(radius) * 0.5, 0.5);
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        float weight = exp(-0.5 * float(i * i) / (sigma * sigma));
+        sum += weight * textureLod(moments, TexCoords + direction * float(i), 0.0);
+        weightSum += weight;
+    }
+    FragColor = sum / weightSum;
+}
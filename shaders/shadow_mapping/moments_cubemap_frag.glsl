@@ -0,0 +1,32 @@
+#version 330 core
+in vec4 FragPos;
+out vec4 FragMoments;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+// 1: VSM, 2: EVSM
+uniform int shadowMode;
+uniform vec2 evsmExponents;
+
+vec2 WarpDepth(float depth)
+{
+    depth = 2.0 * depth - 1.0;
+    return vec2(exp(evsmExponents.x * depth), -exp(-evsmExponents.y * depth));
+}
+
+void main()
+{
+    float depth = length(FragPos.xyz - lightPos) / far_plane;
+    gl_FragDepth = depth;
+    if (shadowMode == 2)
+    {
+        vec2 warped = WarpDepth(depth);
+        FragMoments = vec4(warped.x, warped.x * warped.x, warped.y, warped.y * warped.y);
+    }
+    else
+    {
+        float dx = dFdx(depth);
+        float dy = dFdy(depth);
+        FragMoments = vec4(depth, depth * depth + 0.25 * (dx * dx + dy * dy), 0.0, 0.0);
+    }
+}
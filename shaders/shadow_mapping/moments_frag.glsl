@@ -0,0 +1,30 @@
+#version 330 core
+out vec4 FragMoments;
+
+// 1: VSM, 2: EVSM
+uniform int shadowMode;
+uniform vec2 evsmExponents;
+
+vec2 WarpDepth(float depth)
+{
+    // rescale to [-1, 1] so both exponentials stay inside fp32 range
+    depth = 2.0 * depth - 1.0;
+    return vec2(exp(evsmExponents.x * depth), -exp(-evsmExponents.y * depth));
+}
+
+void main()
+{
+    float depth = gl_FragCoord.z;
+    if (shadowMode == 2)
+    {
+        vec2 warped = WarpDepth(depth);
+        FragMoments = vec4(warped.x, warped.x * warped.x, warped.y, warped.y * warped.y);
+    }
+    else
+    {
+        // bias the second moment by the depth slope across the pixel
+        float dx = dFdx(depth);
+        float dy = dFdy(depth);
+        FragMoments = vec4(depth, depth * depth + 0.25 * (dx * dx + dy * dy), 0.0, 0.0);
+    }
+}
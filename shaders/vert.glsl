@@ -12,11 +12,12 @@ out VS_OUT {
     mat3 TBN;
 } vs_out;
 
+#include "common/uniforms.glsl"
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 normalMatrix;
-uniform mat4 lightSpaceMatrix;
+
+invariant gl_Position;
 
 void main()
 {